@@ -2,8 +2,14 @@
 
 #include <string>
 #include <algorithm>
-#ifdef DPLATFORM_MACOS
+#include <cstring>
+#if defined(DPLATFORM_WINDOWS)
+#include <windows.h>
+#else
 #include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
 #endif
 
 File::File(const std::string& fn) {
@@ -22,7 +28,7 @@ File::File(const std::string& fn) {
 		FileName = FullPath.substr(PrePathIndex + 1, SufPathIndex - PrePathIndex - 1);
 	}
 
-	FileType = FullPath.substr(SufPathIndex);
+	FileType = SufPathIndex == std::string::npos ? "" : FullPath.substr(SufPathIndex);
 }
 
 std::string File::ReadBytes() {
@@ -43,6 +49,45 @@ std::string File::ReadBytes() {
 	return std::string(buffer.str());
 }
 
+bool File::ReadLines(const std::function<bool(char*)>& callback, size_t chunk_size) {
+	std::ifstream inFile(FullPath, std::ios::binary);
+	if (!inFile) {
+		return false;
+	}
+
+	// 缓冲区末尾保留 1 字节放 '\0'; 不完整的最后一行移到缓冲区开头
+	std::vector<char> buffer(chunk_size + 1);
+	size_t carry = 0;
+	while (true) {
+		if (carry == buffer.size() - 1) {
+			buffer.resize(buffer.size() * 2);
+		}
+
+		inFile.read(buffer.data() + carry, buffer.size() - 1 - carry);
+		size_t count = static_cast<size_t>(inFile.gcount());
+		char* begin = buffer.data();
+		char* end = begin + carry + count;
+
+		while (char* newline = (char*)memchr(begin, '\n', end - begin)) {
+			*newline = '\0';
+			if (!callback(begin)) {
+				return false;
+			}
+			begin = newline + 1;
+		}
+
+		carry = end - begin;
+		if (count == 0) {
+			if (carry > 0) {
+				begin[carry] = '\0';
+				return callback(begin);
+			}
+			return true;
+		}
+		memmove(buffer.data(), begin, carry);
+	}
+}
+
 bool File::WriteBytes(const char* source, size_t size, std::ios::openmode mode) {
 	std::ofstream outFile(FullPath, mode);
 
@@ -66,3 +111,89 @@ bool File::IsExist() {
 	return stat(FullPath.c_str(), &buffer) == 0;
 #endif
 }
+
+MappedFile::MappedFile(const std::string& filename)
+	: File(filename), Data(nullptr), Size(0), FileHandle(nullptr), MappingHandle(nullptr) {}
+
+bool MappedFile::Map() {
+	if (IsMapped()) {
+		return true;
+	}
+
+#if defined(DPLATFORM_WINDOWS)
+	HANDLE hFile = CreateFileA(FullPath.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (hFile == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+
+	LARGE_INTEGER FileSize;
+	if (!GetFileSizeEx(hFile, &FileSize) || FileSize.QuadPart == 0) {
+		CloseHandle(hFile);
+		return false;
+	}
+
+	HANDLE hMapping = CreateFileMappingA(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (hMapping == NULL) {
+		CloseHandle(hFile);
+		return false;
+	}
+
+	void* View = MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0);
+	if (View == NULL) {
+		CloseHandle(hMapping);
+		CloseHandle(hFile);
+		return false;
+	}
+
+	FileHandle = hFile;
+	MappingHandle = hMapping;
+	Data = (const unsigned char*)View;
+	Size = (size_t)FileSize.QuadPart;
+#else
+	int fd = open(FullPath.c_str(), O_RDONLY);
+	if (fd < 0) {
+		return false;
+	}
+
+	struct stat Info;
+	if (fstat(fd, &Info) != 0 || Info.st_size == 0) {
+		close(fd);
+		return false;
+	}
+
+	void* View = mmap(nullptr, (size_t)Info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (View == MAP_FAILED) {
+		close(fd);
+		return false;
+	}
+
+	FileHandle = (void*)(intptr_t)fd;
+	Data = (const unsigned char*)View;
+	Size = (size_t)Info.st_size;
+#endif
+
+	IsValid = true;
+	return true;
+}
+
+void MappedFile::Unmap() {
+	if (!IsMapped()) {
+		return;
+	}
+
+#if defined(DPLATFORM_WINDOWS)
+	UnmapViewOfFile(Data);
+	CloseHandle((HANDLE)MappingHandle);
+	CloseHandle((HANDLE)FileHandle);
+#else
+	munmap((void*)Data, Size);
+	close((int)(intptr_t)FileHandle);
+#endif
+
+	Data = nullptr;
+	Size = 0;
+	FileHandle = nullptr;
+	MappingHandle = nullptr;
+	IsValid = false;
+}
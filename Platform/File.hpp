@@ -6,6 +6,7 @@
 
 #include <fstream>
 #include <sstream>
+#include <functional>
 
 enum class eFileMode {
 	Read = 0x1,
@@ -24,6 +25,10 @@ public:
 	std::string GetPrePath() const { return PrePath; }
 	std::string GetFileType() const { return FileType; }
 	std::string ReadBytes();
+
+	// 按块流式读取, 对每一行 (已去掉换行, 以 '\0' 结尾, 可原地修改) 调用 callback
+	// callback 返回 false 时停止读取并返回 false
+	bool ReadLines(const std::function<bool(char*)>& callback, size_t chunk_size = 1 << 20);
 	bool WriteBytes(const char* source, size_t size, std::ios::openmode mode = std::ios::ate);
 	bool IsExist();
 
@@ -34,3 +39,28 @@ protected:
 	std::string FileType;
 	bool IsValid;
 };
+
+// 只读内存映射文件, 映射内容在对象销毁前一直有效
+class MappedFile : public File {
+public:
+	MappedFile() : Data(nullptr), Size(0), FileHandle(nullptr), MappingHandle(nullptr) {}
+	MappedFile(const std::string& filename);
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+	virtual ~MappedFile() { Unmap(); }
+
+public:
+	bool Map();
+	void Unmap();
+	bool IsMapped() const { return Data != nullptr; }
+	const unsigned char* GetData() const { return Data; }
+	size_t GetSize() const { return Size; }
+
+private:
+	const unsigned char* Data;
+	size_t Size;
+
+	// Win32 使用文件/映射句柄, POSIX 只使用 FileHandle 保存 fd
+	void* FileHandle;
+	void* MappingHandle;
+};
@@ -87,6 +87,13 @@ bool Windows32::PlatformStartup(const PlatformInfo& info) {
 	return true;
 }
 
+void Windows32::SetClientSize(int Width, int Height) {
+	// ǰʽѿͻߴ绻Ϊڳߴ, λñֲ
+	RECT Rect = { 0, 0, Width, Height };
+	AdjustWindowRectEx(&Rect, (DWORD)GetWindowLongA(hwnd, GWL_STYLE), 0, (DWORD)GetWindowLongA(hwnd, GWL_EXSTYLE));
+	SetWindowPos(hwnd, 0, 0, 0, Rect.right - Rect.left, Rect.bottom - Rect.top, SWP_NOMOVE | SWP_NOZORDER | SWP_NOACTIVATE);
+}
+
 void Windows32::PlatformShutdown() {
 	DestroyWindow(hwnd);
 	hwnd = 0;
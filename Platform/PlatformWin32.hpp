@@ -25,6 +25,7 @@ public:
 
 	bool InitOpenGLContext();
 	void SwapBuffer() { SwapBuffers(m_hDC); }
+	void SetClientSize(int Width, int Height);
 	HWND GetHWND() { return hwnd; }
 
 private:
@@ -0,0 +1,175 @@
+﻿#include "Socket.hpp"
+
+#if defined(DPLATFORM_WINDOWS)
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#pragma comment(lib, "ws2_32.lib")
+typedef int socklen_t;
+#define CloseSocket closesocket
+#define NativeSocket(Handle) ((SOCKET)(Handle))
+#else
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <netdb.h>
+#include <unistd.h>
+#define CloseSocket close
+#define NativeSocket(Handle) ((int)(Handle))
+#endif
+
+#include <cstring>
+
+bool Socket::Startup() {
+#if defined(DPLATFORM_WINDOWS)
+	static const bool Started = []() {
+		WSADATA Data;
+		return WSAStartup(MAKEWORD(2, 2), &Data) == 0;
+	}();
+	return Started;
+#else
+	return true;
+#endif
+}
+
+Socket& Socket::operator=(Socket&& other) noexcept {
+	if (this != &other) {
+		Close();
+		Handle = other.Handle;
+		other.Handle = InvalidHandle;
+	}
+	return *this;
+}
+
+bool Socket::Listen(uint16_t port, int backlog) {
+	if (!Startup()) {
+		return false;
+	}
+
+	Close();
+	Handle = (intptr_t)socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	if (!IsValid()) {
+		return false;
+	}
+
+	int Reuse = 1;
+	setsockopt(NativeSocket(Handle), SOL_SOCKET, SO_REUSEADDR, (const char*)&Reuse, sizeof(Reuse));
+
+	sockaddr_in Address;
+	std::memset(&Address, 0, sizeof(Address));
+	Address.sin_family = AF_INET;
+	Address.sin_addr.s_addr = htonl(INADDR_ANY);
+	Address.sin_port = htons(port);
+	if (bind(NativeSocket(Handle), (const sockaddr*)&Address, sizeof(Address)) != 0 || listen(NativeSocket(Handle), backlog) != 0) {
+		Close();
+		return false;
+	}
+
+	return true;
+}
+
+Socket Socket::Accept() {
+	Socket Client;
+	if (!IsValid()) {
+		return Client;
+	}
+
+	intptr_t Accepted = (intptr_t)accept(NativeSocket(Handle), nullptr, nullptr);
+	if (Accepted != InvalidHandle) {
+		int NoDelay = 1;
+		setsockopt(NativeSocket(Accepted), IPPROTO_TCP, TCP_NODELAY, (const char*)&NoDelay, sizeof(NoDelay));
+		Client.Handle = Accepted;
+	}
+	return Client;
+}
+
+bool Socket::Connect(const std::string& host, uint16_t port) {
+	if (!Startup()) {
+		return false;
+	}
+
+	Close();
+	addrinfo Hints;
+	std::memset(&Hints, 0, sizeof(Hints));
+	Hints.ai_family = AF_INET;
+	Hints.ai_socktype = SOCK_STREAM;
+	Hints.ai_protocol = IPPROTO_TCP;
+
+	addrinfo* Result = nullptr;
+	if (getaddrinfo(host.c_str(), std::to_string(port).c_str(), &Hints, &Result) != 0) {
+		return false;
+	}
+
+	for (addrinfo* Info = Result; Info; Info = Info->ai_next) {
+		Handle = (intptr_t)socket(Info->ai_family, Info->ai_socktype, Info->ai_protocol);
+		if (!IsValid()) {
+			continue;
+		}
+		if (connect(NativeSocket(Handle), Info->ai_addr, (socklen_t)Info->ai_addrlen) == 0) {
+			break;
+		}
+		Close();
+	}
+	freeaddrinfo(Result);
+
+	if (IsValid()) {
+		int NoDelay = 1;
+		setsockopt(NativeSocket(Handle), IPPROTO_TCP, TCP_NODELAY, (const char*)&NoDelay, sizeof(NoDelay));
+	}
+	return IsValid();
+}
+
+bool Socket::SendAll(const void* data, size_t size) {
+	const char* Bytes = (const char*)data;
+	while (size > 0) {
+		int Chunk = (int)(size < (1u << 30) ? size : (1u << 30));
+#if defined(DPLATFORM_WINDOWS)
+		int Sent = send(NativeSocket(Handle), Bytes, Chunk, 0);
+#else
+		int Sent = (int)send(NativeSocket(Handle), Bytes, Chunk, MSG_NOSIGNAL);
+#endif
+		if (Sent <= 0) {
+			return false;
+		}
+		Bytes += Sent;
+		size -= Sent;
+	}
+	return true;
+}
+
+bool Socket::RecvAll(void* data, size_t size) {
+	char* Bytes = (char*)data;
+	while (size > 0) {
+		int Chunk = (int)(size < (1u << 30) ? size : (1u << 30));
+		int Received = (int)recv(NativeSocket(Handle), Bytes, Chunk, 0);
+		if (Received <= 0) {
+			return false;
+		}
+		Bytes += Received;
+		size -= Received;
+	}
+	return true;
+}
+
+bool Socket::SetRecvTimeout(double seconds) {
+	if (!IsValid()) {
+		return false;
+	}
+
+#if defined(DPLATFORM_WINDOWS)
+	DWORD Timeout = (DWORD)(seconds * 1000.0);
+#else
+	timeval Timeout;
+	Timeout.tv_sec = (long)seconds;
+	Timeout.tv_usec = (long)((seconds - (double)Timeout.tv_sec) * 1e6);
+#endif
+	return setsockopt(NativeSocket(Handle), SOL_SOCKET, SO_RCVTIMEO, (const char*)&Timeout, sizeof(Timeout)) == 0;
+}
+
+void Socket::Close() {
+	if (IsValid()) {
+		CloseSocket(NativeSocket(Handle));
+		Handle = InvalidHandle;
+	}
+}
@@ -0,0 +1,40 @@
+﻿#pragma once
+
+#include "Defines.hpp"
+#include <string>
+#include <cstddef>
+#include <cstdint>
+
+// 阻塞式 TCP 套接字, Win32 使用 Winsock, 其他平台使用 BSD socket
+class Socket {
+public:
+	Socket() : Handle(InvalidHandle) {}
+	Socket(const Socket&) = delete;
+	Socket& operator=(const Socket&) = delete;
+	Socket(Socket&& other) noexcept : Handle(other.Handle) { other.Handle = InvalidHandle; }
+	Socket& operator=(Socket&& other) noexcept;
+	virtual ~Socket() { Close(); }
+
+public:
+	// 监听本机所有地址上的端口
+	bool Listen(uint16_t port, int backlog = 16);
+	// 等待新连接; 监听套接字被关闭时返回无效的 Socket
+	Socket Accept();
+	bool Connect(const std::string& host, uint16_t port);
+
+	// 发送/接收恰好 size 字节, 连接断开或超时返回 false
+	bool SendAll(const void* data, size_t size);
+	bool RecvAll(void* data, size_t size);
+
+	// 接收超时 (秒), 0 表示一直等待
+	bool SetRecvTimeout(double seconds);
+
+	void Close();
+	bool IsValid() const { return Handle != InvalidHandle; }
+
+private:
+	static const intptr_t InvalidHandle = -1;
+	static bool Startup();
+
+	intptr_t Handle;
+};
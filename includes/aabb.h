@@ -0,0 +1,76 @@
+#ifndef AABB_H
+#define AABB_H
+
+#include "rtweekend.h"
+#include <utility>
+
+class aabb {
+public:
+	aabb();
+	aabb(const point3& a, const point3& b);
+
+	point3 min() const { return minimum; }
+	point3 max() const { return maximum; }
+	point3 centroid() const { return 0.5 * (minimum + maximum); }
+
+	inline void expand(const point3& p) {
+		for (int a = 0; a < 3; a++) {
+			minimum.e[a] = p.e[a] < minimum.e[a] ? p.e[a] : minimum.e[a];
+			maximum.e[a] = p.e[a] > maximum.e[a] ? p.e[a] : maximum.e[a];
+		}
+	}
+
+	inline void expand(const aabb& box) {
+		for (int a = 0; a < 3; a++) {
+			minimum.e[a] = box.minimum.e[a] < minimum.e[a] ? box.minimum.e[a] : minimum.e[a];
+			maximum.e[a] = box.maximum.e[a] > maximum.e[a] ? box.maximum.e[a] : maximum.e[a];
+		}
+	}
+
+	double surface_area() const;
+	int longest_axis() const;
+
+	// inv_dir 为光线方向的倒数, 由调用方每条光线计算一次
+	// t1 放大 1 + 2 * gamma(3) 以抵消舍入误差, 擦过包围盒角点的光线不会被漏掉 (Ize 2013)
+	inline bool hit(const ray& r, const vec3& inv_dir, double t_min, double t_max) const {
+		for (int a = 0; a < 3; a++) {
+			auto t0 = (minimum.e[a] - r.orig.e[a]) * inv_dir.e[a];
+			auto t1 = (maximum.e[a] - r.orig.e[a]) * inv_dir.e[a];
+			if (inv_dir.e[a] < 0.0) std::swap(t0, t1);
+			t1 *= robust_scale;
+			t_min = t0 > t_min ? t0 : t_min;
+			t_max = t1 < t_max ? t1 : t_max;
+			if (t_max < t_min) return false;
+		}
+		return true;
+	}
+
+	// 运动模糊: 本包围盒为快门开启 (time 0) 时的范围, end 为关闭 (time 1) 时的范围,
+	// 按光线时刻线性插值后求交. 线性运动的图元在任意时刻都被插值结果包含
+	// 比较写成 NaN 向后传播的形式, 空包围盒插值得到的 NaN 一定判为不相交
+	inline bool hit(const ray& r, const aabb& end, const vec3& inv_dir, double t_min, double t_max) const {
+		const double time = r.tm;
+		for (int a = 0; a < 3; a++) {
+			double lo = minimum.e[a] + (end.minimum.e[a] - minimum.e[a]) * time;
+			double hi = maximum.e[a] + (end.maximum.e[a] - maximum.e[a]) * time;
+			auto t0 = (lo - r.orig.e[a]) * inv_dir.e[a];
+			auto t1 = (hi - r.orig.e[a]) * inv_dir.e[a];
+			if (inv_dir.e[a] < 0.0) std::swap(t0, t1);
+			t1 *= robust_scale;
+			t_min = t_min > t0 ? t_min : t0;
+			t_max = t_max < t1 ? t_max : t1;
+			if (!(t_min <= t_max)) return false;
+		}
+		return true;
+	}
+
+public:
+	static constexpr double robust_scale = 1.0 + 2.0 * (3.0 * 1.1102230246251565e-16) / (1.0 - 3.0 * 1.1102230246251565e-16);
+
+	point3 minimum;
+	point3 maximum;
+};
+
+aabb surrounding_box(const aabb& box0, const aabb& box1);
+
+#endif // !AABB_H
@@ -0,0 +1,96 @@
+#ifndef ACCUMULATOR_H
+#define ACCUMULATOR_H
+
+#include "rtweekend.h"
+#include "framebuffer.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// 渐进式渲染的累积缓冲: 每像素保存颜色之和 (double) 与已采样数, 行号约定与 framebuffer 相同
+class accumulation_buffer {
+public:
+	accumulation_buffer();
+	accumulation_buffer(int width, int height);
+
+	void resize(int width, int height);
+	void clear();
+
+	int width() const { return w; }
+	int height() const { return h; }
+
+	inline void add(int x, int y, const color& sum, uint32_t samples) {
+		size_t index = size_t(y) * w + x;
+		double* p = &sums[3 * index];
+		p[0] += sum.e[0];
+		p[1] += sum.e[1];
+		p[2] += sum.e[2];
+		counts[index] += samples;
+		if (use_weights) {
+			weights[index] += samples;
+		}
+	}
+
+	// 重建滤波: 加入已乘以权重的颜色与权重本身, 样本数另行用 add_samples 计入; 需要先 set_weighted(true)
+	inline void add_weighted(int x, int y, const color& weighted, double weight) {
+		size_t index = size_t(y) * w + x;
+		double* p = &sums[3 * index];
+		p[0] += weighted.e[0];
+		p[1] += weighted.e[1];
+		p[2] += weighted.e[2];
+		weights[index] += weight;
+	}
+
+	inline void add_samples(int x, int y, uint32_t samples) { counts[size_t(y) * w + x] += samples; }
+
+	inline uint32_t samples(int x, int y) const { return counts[size_t(y) * w + x]; }
+
+	// 把 other 的 [src_row, src_row + row_count) 行加到本缓冲从 dst_row 开始的行, 两者宽度相同
+	void add_rows(const accumulation_buffer& other, int src_row, int dst_row, int row_count);
+
+	// 带权重时按权重之和归一化, 否则按样本数平均; 重新 resize 后保持该设置
+	void set_weighted(bool enable);
+	bool weighted() const { return use_weights; }
+
+	// 归一化后写入 framebuffer, 尚未采样的像素为黑色
+	void resolve(framebuffer& fb) const;
+	// 只写入 [x0, x1) x [y0, y1), fb 其余像素保持不变; fb 必须与本缓冲同尺寸
+	void resolve(framebuffer& fb, int x0, int y0, int x1, int y1) const;
+
+	const std::vector<double>& sum_data() const { return sums; }
+	const std::vector<uint32_t>& count_data() const { return counts; }
+	std::vector<double>& sum_data() { return sums; }
+	std::vector<uint32_t>& count_data() { return counts; }
+	const std::vector<double>& weight_data() const { return weights; }
+	std::vector<double>& weight_data() { return weights; }
+
+private:
+	int w;
+	int h;
+	std::vector<double> sums;
+	std::vector<uint32_t> counts;
+	std::vector<double> weights;	// 仅 use_weights 时分配
+	bool use_weights;
+};
+
+// 检查点记录的渲染进度; 样本 [0, next_sample) 已累积到缓冲中
+struct checkpoint_info {
+	int32_t width = 0;
+	int32_t height = 0;
+	int32_t samples_per_pixel = 0;
+	int32_t samples_per_pass = 0;
+	int32_t max_depth = 0;
+	int32_t next_sample = 0;
+	int32_t filter = 0;			// filter_type
+	float filter_radius = 0.5f;
+	int32_t weighted = 0;		// 非 0 时样本数之后还保存每像素的权重之和
+	int32_t reserved = 0;
+	uint64_t scene_hash = 0;	// 场景与相机的摘要, 恢复时必须与当前场景一致
+};
+
+// 检查点先写入 path + ".tmp" 再替换, 中途被中断时旧检查点仍然完整
+bool save_checkpoint(const std::string& path, const checkpoint_info& info, const accumulation_buffer& accum);
+bool load_checkpoint(const std::string& path, checkpoint_info& info, accumulation_buffer& accum);
+
+#endif // !ACCUMULATOR_H
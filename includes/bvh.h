@@ -0,0 +1,151 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include "aabb.h"
+#include "render_stats.h"
+#include <vector>
+#include <cstdint>
+
+// 扁平 BVH 节点, 深度优先存储: 左孩子紧跟在父节点之后, 右孩子由 offset 给出
+struct bvh_node {
+	aabb box;
+	uint32_t offset;	// 叶子: 第一个图元; 内部节点: 右孩子下标
+	uint16_t count;		// 叶子图元数量, 0 表示内部节点
+	uint16_t axis;		// 内部节点的划分轴, 用于决定遍历顺序
+};
+
+class bvh {
+public:
+	// 根据图元包围盒构建 BVH, order 返回图元的新顺序, 叶子引用其中的连续区间
+	static void build(const std::vector<aabb>& boxes, std::vector<bvh_node>& nodes, std::vector<uint32_t>& order);
+
+	// 检查外部读入的节点数组可以安全遍历与 refit: 孩子下标大于父节点且在数组内, 划分轴合法,
+	// 叶子区间在 primitive_count 之内, 树深不超过遍历栈的容量
+	static bool validate(const bvh_node* nodes, size_t node_count, size_t primitive_count);
+
+	// hit_primitive(index, t_min, closest) 命中更近的图元时更新 closest 并返回 true
+	template <typename HitPrimitive>
+	static bool traverse(const bvh_node* nodes, const ray& r, double t_min, double& closest, HitPrimitive&& hit_primitive);
+
+	// 以叶子为单位回调, 便于对叶子内连续的图元做批量求交
+	// hit_leaf(offset, count, t_min, closest) 命中更近的图元时更新 closest 并返回 true
+	template <typename HitLeaf>
+	static bool traverse_leaves(const bvh_node* nodes, const ray& r, double t_min, double& closest, HitLeaf&& hit_leaf);
+
+	// 运动模糊: node.box 为快门开启时的包围盒, end_boxes[i] 为节点 i 在快门关闭时的包围盒,
+	// 按光线时刻插值节点包围盒, 避免用整个快门区间的并集导致节点大量重叠; end_boxes 为空时与上面相同
+	template <typename HitLeaf>
+	static bool traverse_leaves(const bvh_node* nodes, const aabb* end_boxes, const ray& r, double t_min, double& closest, HitLeaf&& hit_leaf);
+
+	// 自底向上重算包围盒: 子节点下标总是大于父节点, 逆序扫描一遍即可
+	// dirty 为空时重算所有节点, 否则只重算被标记的节点 (叶子与它的所有祖先都要标记)
+	// leaf_box(offset, count) 返回叶子中图元的包围盒
+	template <typename LeafBox>
+	static void refit(bvh_node* nodes, size_t node_count, const uint8_t* dirty, LeafBox&& leaf_box);
+
+	// 与 refit 相同, 但结果写入与节点平行的 boxes (如快门关闭时的包围盒)
+	template <typename LeafBox>
+	static void refit_boxes(const bvh_node* nodes, aabb* boxes, size_t node_count, const uint8_t* dirty, LeafBox&& leaf_box);
+
+public:
+	static const int max_depth = 64;
+};
+
+template <typename LeafBox>
+inline void bvh::refit(bvh_node* nodes, size_t node_count, const uint8_t* dirty, LeafBox&& leaf_box) {
+	for (size_t i = node_count; i-- > 0;) {
+		if (dirty && !dirty[i]) continue;
+
+		bvh_node& node = nodes[i];
+		if (node.count > 0) {
+			node.box = leaf_box(node.offset, (uint32_t)node.count);
+		}
+		else {
+			node.box = surrounding_box(nodes[i + 1].box, nodes[node.offset].box);
+		}
+	}
+}
+
+template <typename LeafBox>
+inline void bvh::refit_boxes(const bvh_node* nodes, aabb* boxes, size_t node_count, const uint8_t* dirty, LeafBox&& leaf_box) {
+	for (size_t i = node_count; i-- > 0;) {
+		if (dirty && !dirty[i]) continue;
+
+		const bvh_node& node = nodes[i];
+		if (node.count > 0) {
+			boxes[i] = leaf_box(node.offset, (uint32_t)node.count);
+		}
+		else {
+			boxes[i] = surrounding_box(boxes[i + 1], boxes[node.offset]);
+		}
+	}
+}
+
+template <typename HitLeaf>
+inline bool bvh::traverse_leaves(const bvh_node* nodes, const ray& r, double t_min, double& closest, HitLeaf&& hit_leaf) {
+	return traverse_leaves(nodes, nullptr, r, t_min, closest, std::forward<HitLeaf>(hit_leaf));
+}
+
+template <typename HitLeaf>
+inline bool bvh::traverse_leaves(const bvh_node* nodes, const aabb* end_boxes, const ray& r, double t_min, double& closest, HitLeaf&& hit_leaf) {
+	const vec3 inv_dir(1.0 / r.dir.e[0], 1.0 / r.dir.e[1], 1.0 / r.dir.e[2]);
+	const bool dir_negative[3] = { inv_dir.e[0] < 0, inv_dir.e[1] < 0, inv_dir.e[2] < 0 };
+
+	uint32_t stack[max_depth];
+	int stack_size = 0;
+	uint32_t index = 0;
+	bool hit_anything = false;
+	RT_STAT_COUNTER(nodes_visited);
+	RT_STAT_COUNTER(primitive_tests);
+
+	while (true) {
+		const bvh_node& node = nodes[index];
+		RT_STAT_COUNT(nodes_visited);
+		bool hit_node = end_boxes ? node.box.hit(r, end_boxes[index], inv_dir, t_min, closest) : node.box.hit(r, inv_dir, t_min, closest);
+		if (hit_node) {
+			if (node.count > 0) {
+#ifdef RENDER_STATS_ENABLED
+				primitive_tests += node.count;
+#endif
+				if (hit_leaf(node.offset, (uint32_t)node.count, t_min, closest)) {
+					hit_anything = true;
+				}
+			}
+			else {
+				// 先访问离光线起点更近的孩子
+				if (dir_negative[node.axis]) {
+					stack[stack_size++] = index + 1;
+					index = node.offset;
+				}
+				else {
+					stack[stack_size++] = node.offset;
+					index = index + 1;
+				}
+				continue;
+			}
+		}
+
+		if (stack_size == 0) break;
+		index = stack[--stack_size];
+	}
+
+	RT_STAT_ADD(bvh_nodes_visited, nodes_visited);
+	RT_STAT_ADD(intersection_tests, primitive_tests);
+	return hit_anything;
+}
+
+template <typename HitPrimitive>
+inline bool bvh::traverse(const bvh_node* nodes, const ray& r, double t_min, double& closest, HitPrimitive&& hit_primitive) {
+	return traverse_leaves(nodes, r, t_min, closest,
+		[&](uint32_t offset, uint32_t count, double t0, double& t1) {
+			bool hit_anything = false;
+			for (uint32_t i = 0; i < count; i++) {
+				if (hit_primitive(offset + i, t0, t1)) {
+					hit_anything = true;
+				}
+			}
+			return hit_anything;
+		});
+}
+
+#endif // !BVH_H
@@ -3,12 +3,31 @@
 
 #include "rtweekend.h"
 
+// camera 构造参数
+struct camera_settings {
+	double vfov = 30.0;
+	point3 lookfrom = point3(13, 2, 3);
+	point3 lookat = point3(0, 0, 0);
+	vec3 vup = vec3(0, 1, 0);
+	double aperture = 0.1;
+	double focus_dist = 1.0;
+
+	// 快门开启与关闭的时刻, 取值 [0, 1]; 相同时没有运动模糊
+	double shutter_open = 0.0;
+	double shutter_close = 0.0;
+};
+
 class camera {
 public:
 	camera();
 	camera(double vfov, double aspect_radio, point3 lookfrom, 
-		point3 lookat, vec3 vup, double aperture = 0.0, double focus_dist = 1.0);
+		point3 lookat, vec3 vup, double aperture = 0.0, double focus_dist = 1.0,
+		double time0 = 0.0, double time1 = 0.0);
+	camera(const camera_settings& settings, double aspect_radio);
 	ray get_ray(double s, double t) const;
+
+	// 一个像素在视平面上张开的角度, 作为主光线锥的扩展量
+	double pixel_spread(int image_height) const;
 	
 public:
 	point3 origin;
@@ -18,6 +37,7 @@ public:
 
 	vec3 u, v, w;
 	double lens_radius;
+	double time0, time1;	// 快门区间
 
 };
 
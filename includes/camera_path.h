@@ -0,0 +1,34 @@
+#ifndef CAMERA_PATH_H
+#define CAMERA_PATH_H
+
+#include "camera.h"
+
+#include <vector>
+
+struct camera_key {
+	double frame;
+	camera_settings settings;
+};
+
+// 相机关键帧路径: lookfrom/lookat 使用 Catmull-Rom 样条插值, 使运动在关键帧处连续平滑,
+// 其余参数线性插值; 第一个关键帧之前和最后一个之后保持端点不变
+class camera_path {
+public:
+	// 已有相同帧号的关键帧时替换
+	void add(double frame, const camera_settings& settings);
+	void clear() { keys.clear(); }
+
+	bool empty() const { return keys.empty(); }
+	size_t size() const { return keys.size(); }
+	const std::vector<camera_key>& get_keys() const { return keys; }
+
+	camera_settings evaluate(double frame) const;
+
+	// 绕 lookat 沿 vup 轴旋转一周的转台动画, 第 frame_count 帧回到起点 (不包含)
+	static camera_path orbit(const camera_settings& base, int frame_count);
+
+private:
+	std::vector<camera_key> keys;	// 按帧号升序
+};
+
+#endif // !CAMERA_PATH_H
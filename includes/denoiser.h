@@ -0,0 +1,55 @@
+#ifndef DENOISER_H
+#define DENOISER_H
+
+#include "rtweekend.h"
+#include "framebuffer.h"
+
+#include <vector>
+
+// 一个样本在第一个漫反射命中点的特征; 沿玻璃与理想镜面继续寻找, 反射和折射出的物体也能被特征引导,
+// albedo 为沿途衰减与该点反照率的乘积
+struct sample_features {
+	color albedo = color(0, 0, 0);
+	vec3 normal = vec3(0, 0, 0);
+	double depth = 0.0;		// 沿路径到命中点的距离, 0 表示背景
+	bool valid = false;
+};
+
+// 降噪用的辅助输出 (AOV), 每像素为各样本的平均值, 行号约定与 framebuffer 相同
+class feature_buffers {
+public:
+	feature_buffers();
+	feature_buffers(int width, int height);
+
+	void resize(int width, int height);
+
+	int width() const { return albedo.width(); }
+	int height() const { return albedo.height(); }
+
+	// 写入一个像素: feature_sum 与 sum 为各样本特征与颜色之和, luminance_sq_sum 为各样本亮度平方之和
+	void set_pixel(int x, int y, const sample_features& feature_sum, const color& sum, double luminance_sq_sum, int samples);
+
+public:
+	framebuffer albedo;
+	framebuffer normal;			// 单位长度, 背景为 0
+	std::vector<float> depth;	// 背景为 0
+	std::vector<float> variance;	// 像素均值的亮度方差, 由样本方差除以样本数得到
+};
+
+struct denoise_settings {
+	int iterations = 3;				// à-trous 迭代次数, 第 i 次的采样间隔为 2^i 像素
+	double sigma_luminance = 2.0;	// 亮度差相对于标准差的容忍度
+	double sigma_normal = 4.0;	// 法线夹角权重 dot(n_p, n_q)^sigma_normal
+	double sigma_depth = 2.0;		// 深度差相对于局部深度梯度的容忍度
+	double firefly_sigma = 2.0;		// 亮度超过邻域均值加该倍数标准差的像素被压低, 0 表示不处理
+	int firefly_radius = 1;			// 萤火虫检测的邻域半径
+	int tile_size = 64;
+};
+
+// 特征引导的 à-trous 小波滤波 (Dammertz 2010, 权重与方差传播参照 SVGF, Schied 2017):
+// 先除以反照率只对照度滤波, 纹理与颜色边界不会被模糊; 滤波前压低萤火虫像素; 每次迭代按图块并行
+// thread_count 为 0 时使用全部硬件线程
+void denoise(const framebuffer& noisy, const feature_buffers& features, framebuffer& output,
+	const denoise_settings& settings = denoise_settings(), int thread_count = 0);
+
+#endif // !DENOISER_H
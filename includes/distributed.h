@@ -0,0 +1,92 @@
+#ifndef DISTRIBUTED_H
+#define DISTRIBUTED_H
+
+#include "accumulator.h"
+#include "Socket.hpp"
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// 协调者/工作进程之间的 TCP 协议: 每条消息为 net_header + payload, 字节序为本机字节序
+enum class net_message : uint32_t {
+	hello = 1,	// worker -> coordinator, 无 payload
+	job,		// coordinator -> worker, net_job + 场景路径
+	tile,		// coordinator -> worker, net_tile
+	result,		// worker -> coordinator, net_tile + sums + counts
+	done		// coordinator -> worker, 无 payload
+};
+
+struct net_header {
+	uint32_t magic;
+	uint32_t type;
+	uint64_t size;
+};
+
+struct net_job {
+	int32_t width;
+	int32_t height;
+	int32_t samples_per_pixel;
+	int32_t max_depth;
+
+	// vfov, lookfrom[3], lookat[3], vup[3], aperture, focus_dist, shutter_open, shutter_close
+	double camera[14];
+
+	// 场景文件路径的字节数 (紧跟在结构体之后), 0 表示使用默认场景
+	uint32_t scene_path_size;
+	uint32_t reserved;
+};
+
+// 一个工作单元: 若干整行上的样本区间 [first_sample, first_sample + sample_count)
+struct net_tile {
+	int32_t tile_id;
+	int32_t first_row;
+	int32_t row_count;
+	int32_t first_sample;
+	int32_t sample_count;
+	int32_t reserved;
+};
+
+bool send_message(Socket& socket, net_message type, const void* payload = nullptr, size_t size = 0);
+bool recv_message(Socket& socket, net_message& type, std::vector<char>& payload);
+
+// 把 tile 的累积结果 (行号从 0 开始) 打包成 result 消息
+bool send_tile_result(Socket& socket, const net_tile& tile, const accumulation_buffer& accum);
+// 解包 result 消息: 头部必须与派发的 tile 完全一致且尺寸正确, 否则不写入 accum
+bool read_tile_result(const std::vector<char>& payload, int width, const net_tile& expected, accumulation_buffer& accum);
+
+// 分发队列: 取出的 tile 若所在的工作进程断开或超时, 放回队列重新分发
+class tile_scheduler {
+public:
+	tile_scheduler(int height, int tile_height, int samples_per_pixel);
+
+	// 阻塞直到拿到一个待渲染的 tile; 全部完成时返回 false
+	bool acquire(net_tile& tile);
+	// 标记完成; 同一个 tile 重复完成时返回 false
+	bool complete(const net_tile& tile);
+	void release(const net_tile& tile);
+
+	// 服务线程在工作进程连接与断开时调用, 用于判断是否还有工作进程
+	void worker_joined();
+	void worker_left();
+
+	bool finished();
+	// 等待全部 tile 完成; 没有工作进程连接且仍有 tile 未完成的状态持续 idle_timeout 秒时返回 false
+	bool wait_finished(double idle_timeout);
+	int completed();
+	int total() const { return (int)tiles.size(); }
+
+private:
+	std::mutex mutex;
+	std::condition_variable changed;
+	std::vector<net_tile> tiles;
+	std::vector<bool> done;
+	std::deque<int> pending;
+	int remaining;
+	int workers;
+};
+
+#endif // !DISTRIBUTED_H
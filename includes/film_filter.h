@@ -0,0 +1,79 @@
+#ifndef FILM_FILTER_H
+#define FILM_FILTER_H
+
+#include "rtweekend.h"
+#include "accumulator.h"
+
+#include <string>
+#include <vector>
+
+enum class filter_type : unsigned char {
+	box = 0,
+	tent,
+	gaussian,
+	mitchell,
+	blackman_harris
+};
+
+// 可分离的像素重建滤波器 w(x, y) = f(x) * f(y), f 预先制成查找表
+// 半径以像素为单位; 为 0 时使用各类型的默认半径
+class reconstruction_filter {
+public:
+	static const int max_pixel_radius = 4;
+
+	reconstruction_filter() : reconstruction_filter(filter_type::box) {}
+	reconstruction_filter(filter_type type, double radius = 0.0);
+
+	filter_type type() const { return kind; }
+	double radius() const { return r; }
+
+	// 样本可能影响到的相邻像素数 (每侧)
+	int pixel_radius() const { return pixel_r; }
+
+	// 半径 0.5 的盒式滤波: 样本只落在自己的像素内, 等价于直接平均
+	bool is_box() const { return pixel_r == 0; }
+
+	// 距离像素中心 d 处的一维权重, Mitchell 的旁瓣为负
+	inline double weight(double d) const {
+		size_t i = size_t(std::abs(d) * inv_step);
+		return i < table.size() ? table[i] : 0.0;
+	}
+
+	static const char* name(filter_type type);
+	// 解析 "gaussian" 或 "gaussian:2.0"
+	static bool parse(const std::string& text, reconstruction_filter& filter);
+
+private:
+	filter_type kind;
+	double r;
+	int pixel_r;
+	double inv_step;
+	std::vector<float> table;	// [0, r] 上等距采样, 每项取区间中点的值
+};
+
+// 一个行带的滤波累积, 覆盖行带上下各扩展 pixel_radius 行; 样本按滤波器分摊到邻近像素
+// 行带自己的行由工作线程直接并入累积缓冲 (各行带的行互不重叠, 不需要加锁),
+// 溢出到相邻行带的边缘行在全部行带完成后由单个线程按行带顺序合并, 结果与线程调度无关
+class film_band {
+public:
+	film_band();
+
+	// 清空并重新设置范围, 每个 pass 开始时调用
+	void reset(const reconstruction_filter& filter, int width, int height, int first_row, int row_count);
+
+	// 像素 (x, y) 内位置 (dx, dy) ∈ [0, 1)^2 处的样本; 只计入 (x, y) 的样本数
+	void add_sample(int x, int y, double dx, double dy, const color& c);
+
+	void merge_rows(accumulation_buffer& accum) const;
+	void merge_borders(accumulation_buffer& accum) const;
+
+private:
+	const reconstruction_filter* filter;
+	int image_height;
+	int first_row;
+	int row_count;
+	int border;
+	accumulation_buffer pixels;	// 第 0 行对应图像的第 first_row - border 行
+};
+
+#endif // !FILM_FILTER_H
@@ -0,0 +1,41 @@
+#ifndef FRAMEBUFFER_H
+#define FRAMEBUFFER_H
+
+#include "rtweekend.h"
+
+#include <vector>
+
+// 线性 HDR 帧缓冲, 每像素 3 个 float (RGB); 第 0 行为图像底部, 与 OpenGL 纹理一致
+class framebuffer {
+public:
+	framebuffer();
+	framebuffer(int width, int height);
+
+	void resize(int width, int height);
+	void clear();
+
+	int width() const { return w; }
+	int height() const { return h; }
+
+	inline void set(int x, int y, const color& c) {
+		float* p = &pixels[3 * (size_t(y) * w + x)];
+		p[0] = static_cast<float>(c.e[0]);
+		p[1] = static_cast<float>(c.e[1]);
+		p[2] = static_cast<float>(c.e[2]);
+	}
+
+	inline color get(int x, int y) const {
+		const float* p = &pixels[3 * (size_t(y) * w + x)];
+		return color(p[0], p[1], p[2]);
+	}
+
+	const float* row(int y) const { return &pixels[3 * size_t(y) * w]; }
+	float* row(int y) { return &pixels[3 * size_t(y) * w]; }
+
+private:
+	int w;
+	int h;
+	std::vector<float> pixels;
+};
+
+#endif // !FRAMEBUFFER_H
@@ -0,0 +1,141 @@
+#ifndef GRID_H
+#define GRID_H
+
+#include "aabb.h"
+#include "render_stats.h"
+
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+// 均匀网格加速结构, 适合分布均匀、大小相近的图元 (如默认场景中铺满地面的小球)
+// 构建为 O(n): 两遍扫描统计每个格子的图元数量后按前缀和填充, 场景变化时重建的代价很低
+// 尺寸远大于典型图元的 (如作为地面的大球) 不放入格子, 每条光线单独测试
+class uniform_grid {
+public:
+	uniform_grid();
+
+	// density 为格子数与图元数之比, 分辨率按网格范围的长宽高比例自动选择
+	void build(const std::vector<aabb>& boxes, double density = default_density);
+	void clear();
+
+	bool empty() const { return primitive_count == 0; }
+	const aabb& bounds() const { return total_box; }
+	int resolution(int axis) const { return res[axis]; }
+	size_t cell_count() const { return cell_start.empty() ? 0 : cell_start.size() - 1; }
+
+	// hit_primitive(index, t_min, closest) 命中更近的图元时更新 closest 并返回 true
+	template <typename HitPrimitive>
+	bool traverse(const ray& r, double t_min, double& closest, HitPrimitive&& hit_primitive) const;
+
+public:
+	static constexpr double default_density = 3.0;
+	static constexpr int max_resolution = 1024;
+
+private:
+	aabb grid_box;		// 格子覆盖的范围, 不含过大的图元
+	aabb total_box;
+	int res[3];
+	double cell_size[3];
+	double inv_cell_size[3];
+	size_t primitive_count;
+
+	std::vector<uint32_t> cell_start;	// 格子 c 的图元为 cell_items[cell_start[c], cell_start[c + 1])
+	std::vector<uint32_t> cell_items;
+	std::vector<uint32_t> large_items;
+};
+
+template <typename HitPrimitive>
+inline bool uniform_grid::traverse(const ray& r, double t_min, double& closest, HitPrimitive&& hit_primitive) const {
+	bool hit_anything = false;
+	RT_STAT_COUNTER(cells_visited);
+	RT_STAT_COUNTER(primitive_tests);
+
+	for (uint32_t index : large_items) {
+		RT_STAT_COUNT(primitive_tests);
+		if (hit_primitive(index, t_min, closest)) {
+			hit_anything = true;
+		}
+	}
+
+	// 与网格范围求交, 得到进入与离开网格的参数
+	const double* origin = r.orig.e;
+	const double* dir = r.dir.e;
+	double inv_dir[3];
+	double t_enter = t_min;
+	double t_exit = closest;
+	for (int a = 0; a < 3 && !cell_start.empty(); a++) {
+		inv_dir[a] = 1.0 / dir[a];
+		double t0 = (grid_box.minimum.e[a] - origin[a]) * inv_dir[a];
+		double t1 = (grid_box.maximum.e[a] - origin[a]) * inv_dir[a];
+		if (inv_dir[a] < 0.0) std::swap(t0, t1);
+		t1 *= aabb::robust_scale;
+		t_enter = t0 > t_enter ? t0 : t_enter;
+		t_exit = t1 < t_exit ? t1 : t_exit;
+	}
+
+	if (!cell_start.empty() && t_enter <= t_exit) {
+		// 3D-DDA (Amanatides & Woo 1987): 每次沿下一个格子边界最近的轴前进一格
+		int cell[3], step[3], out[3];
+		double next_t[3], delta_t[3];
+		for (int a = 0; a < 3; a++) {
+			double p = origin[a] + t_enter * dir[a];
+			int c = static_cast<int>((p - grid_box.minimum.e[a]) * inv_cell_size[a]);
+			cell[a] = c < 0 ? 0 : (c >= res[a] ? res[a] - 1 : c);
+
+			if (dir[a] > 0.0) {
+				step[a] = 1;
+				out[a] = res[a];
+				next_t[a] = (grid_box.minimum.e[a] + (cell[a] + 1) * cell_size[a] - origin[a]) * inv_dir[a];
+				delta_t[a] = cell_size[a] * inv_dir[a];
+			}
+			else if (dir[a] < 0.0) {
+				step[a] = -1;
+				out[a] = -1;
+				next_t[a] = (grid_box.minimum.e[a] + cell[a] * cell_size[a] - origin[a]) * inv_dir[a];
+				delta_t[a] = -cell_size[a] * inv_dir[a];
+			}
+			else {
+				step[a] = 0;
+				out[a] = -1;
+				next_t[a] = std::numeric_limits<double>::infinity();
+				delta_t[a] = 0.0;
+			}
+		}
+
+		// 跨越多个格子的图元只测试一次 (直接映射的小邮箱)
+		const int mailbox_size = 8;
+		uint32_t mailbox[mailbox_size];
+		for (int i = 0; i < mailbox_size; i++) mailbox[i] = UINT32_MAX;
+
+		while (true) {
+			RT_STAT_COUNT(cells_visited);
+			size_t c = (size_t(cell[2]) * res[1] + cell[1]) * res[0] + cell[0];
+			for (uint32_t k = cell_start[c]; k < cell_start[c + 1]; k++) {
+				uint32_t index = cell_items[k];
+				uint32_t& slot = mailbox[index & (mailbox_size - 1)];
+				if (slot == index) continue;
+				slot = index;
+
+				RT_STAT_COUNT(primitive_tests);
+				if (hit_primitive(index, t_min, closest)) {
+					hit_anything = true;
+				}
+			}
+
+			int axis = next_t[0] < next_t[1] ? (next_t[0] < next_t[2] ? 0 : 2) : (next_t[1] < next_t[2] ? 1 : 2);
+			// 最近交点已落在当前格子内, 后面的格子不会更近
+			if (closest <= next_t[axis] || next_t[axis] > t_exit) break;
+
+			cell[axis] += step[axis];
+			if (cell[axis] == out[axis]) break;
+			next_t[axis] += delta_t[axis];
+		}
+	}
+
+	RT_STAT_ADD(grid_cells_visited, cells_visited);
+	RT_STAT_ADD(intersection_tests, primitive_tests);
+	return hit_anything;
+}
+
+#endif // !GRID_H
@@ -2,6 +2,7 @@
 #define HITTABLE_H
 
 #include "rtweekend.h"
+#include "aabb.h"
 
 class material;
 
@@ -9,19 +10,38 @@ struct hit_record
 {
 	point3 p3;
 	vec3 normal;
-	shared_ptr<material> mat_ptr;
+	const material* mat_ptr;
 	double t;
 	bool front_face;
 
+	// 纹理坐标, 以及 u / v 变化 1 时命中点移动的世界空间距离 (用于把光线覆盖范围换算为纹素)
+	double u, v;
+	double dpdu_length, dpdv_length;
+
 	inline void set_face_normal(const ray&r, const vec3& outward_normal) {
 		front_face = dot(r.direction(), outward_normal) < 0;
 		normal = front_face ? outward_normal : -outward_normal;
 	}
+
+	// 球面经纬度坐标: u 绕 y 轴一周, v 从 -y 极到 +y 极
+	inline void set_sphere_uv(const vec3& outward_normal, double radius) {
+		double theta = acos(clamp(-outward_normal.y(), -1.0, 1.0));
+		double phi = atan2(-outward_normal.z(), outward_normal.x()) + pi;
+		u = phi / (2 * pi);
+		v = theta / pi;
+		dpdu_length = 2 * pi * std::abs(radius) * sin(theta);
+		dpdv_length = pi * std::abs(radius);
+	}
 };
 
 class hittable {
 public:
+	virtual ~hittable() {}
+
 	virtual bool hit(const ray& r, double t_min, double t_max, hit_record& rec) const = 0;
+
+	// 返回 false 表示对象没有有限包围盒 (无法放入 BVH)
+	virtual bool bounding_box(aabb& output_box) const = 0;
 };
 
 #endif // !HITTABLE_H
@@ -0,0 +1,26 @@
+#ifndef HITTABLE_BVH_H
+#define HITTABLE_BVH_H
+
+#include "hittable_list.h"
+#include "bvh.h"
+
+// 对象级 BVH: 与各对象内部的 BVH 组成两级加速结构 (顶层为实例/对象, 底层为原型图元)
+class hittable_bvh : public hittable {
+public:
+	hittable_bvh(const hittable_list& list);
+
+	virtual bool hit(const ray& r, double t_min, double t_max, hit_record& rec) const override;
+	virtual bool bounding_box(aabb& output_box) const override;
+
+	// 对象移动或内部图元变化后更新包围盒, 不改变树的结构
+	void refit();
+
+private:
+	std::vector<shared_ptr<hittable>> objects;	// 按叶子顺序排列
+	std::vector<bvh_node> nodes;
+
+	// 没有有限包围盒的对象, 逐个求交
+	std::vector<shared_ptr<hittable>> unbounded;
+};
+
+#endif // !HITTABLE_BVH_H
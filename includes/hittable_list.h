@@ -1,5 +1,5 @@
 #ifndef HITTABLE_LIST
-#define HTTTABLE_LIST
+#define HITTABLE_LIST
 
 #include "rtweekend.h"
 #include "hittable.h"
@@ -16,6 +16,7 @@ public:
 	void add(std::shared_ptr<hittable> object);
 
 	virtual bool hit(const ray& r, double t_min, double t_max, hit_record& rec) const override ;
+	virtual bool bounding_box(aabb& output_box) const override;
 
 public:
 	std::vector<std::shared_ptr<hittable>> objects;
@@ -0,0 +1,112 @@
+#ifndef IMAGE_WRITER_H
+#define IMAGE_WRITER_H
+
+#include "framebuffer.h"
+
+#include <string>
+#include <vector>
+#include <functional>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <fstream>
+#include <condition_variable>
+
+enum class image_format {
+	ppm,	// 二进制 P6, 8 位 gamma 2
+	png,	// 8 位 RGB, 未压缩的 deflate 块
+	pfm,	// 线性 float RGB
+	invalid
+};
+
+// 根据扩展名 (.ppm/.png/.pfm) 推断格式
+image_format image_format_from_path(const std::string& path);
+
+// 一段连续行的编码结果; 各段可以并行编码, 再按顺序写入文件
+struct image_band {
+	std::vector<char> bytes;
+	uint32_t checksum = 1;	// PNG: 本段未压缩数据的 adler32
+	uint64_t raw_size = 0;
+};
+
+// 按行带编码图像. header / encode_band / footer 依次拼接即为完整文件
+class image_encoder {
+public:
+	// 第 file_row 行 (按文件中的顺序) 的线性 RGB 数据
+	using row_source = std::function<const float*(int file_row)>;
+
+public:
+	image_encoder(image_format format, int width, int height);
+
+	image_format format() const { return fmt; }
+
+	// 文件行序是否从图像底部开始 (PFM)
+	bool bottom_up() const { return fmt == image_format::pfm; }
+
+	std::vector<char> header() const;
+
+	// 线程安全, 可并行调用; last_band 标记整幅图像的最后一段
+	void encode_band(int first_row, int row_count, const row_source& rows, bool last_band, image_band& band) const;
+
+	// 按文件顺序登记已写出的段, 用于计算尾部校验和
+	void append(const image_band& band);
+
+	std::vector<char> footer() const;
+
+private:
+	image_format fmt;
+	int w;
+	int h;
+	uint32_t adler;
+};
+
+// 并行编码并一次性写出整幅图像, thread_count 为 0 时使用全部硬件线程
+bool write_image(const std::string& path, const framebuffer& fb, int thread_count = 0);
+
+// 流式写出: 渲染线程提交完成的行带, 写线程按文件行序重排后编码写出,
+// 常驻内存只与在途行带数量有关, 与图像大小无关
+class image_stream_writer {
+public:
+	// max_pending_bands 为等待写出的行带上限, 超过时 submit 阻塞
+	image_stream_writer(const std::string& path, int width, int height, size_t max_pending_bands);
+	~image_stream_writer();
+
+	bool open();
+
+	// rgb 为 row_count 行线性 RGB, 行号与 framebuffer 相同 (0 为图像底部), 行内顺序自下而上
+	void submit(int first_row, int row_count, std::vector<float> rgb);
+
+	// 等待所有行写出并关闭文件; 有行缺失或写入失败时返回 false
+	bool close();
+
+private:
+	struct pending_band {
+		int row_count;
+		std::vector<float> rgb;
+	};
+
+	void writer_loop();
+
+	// 行带在文件中的起始行
+	int file_row(int first_row, int row_count) const;
+
+private:
+	std::string path;
+	int w;
+	int h;
+	size_t max_pending;
+	image_encoder encoder;
+	std::ofstream out;
+
+	std::mutex mutex;
+	std::condition_variable band_ready;
+	std::condition_variable band_written;
+	std::map<int, pending_band> pending;	// key: 文件起始行
+	int next_file_row;
+	bool closing;
+	bool failed;
+	std::thread writer;
+};
+
+#endif // !IMAGE_WRITER_H
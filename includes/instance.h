@@ -0,0 +1,20 @@
+#ifndef INSTANCE_H
+#define INSTANCE_H
+
+#include "hittable.h"
+#include "transform.h"
+
+// 引用共享原型 (球集合, 网格或任意子 BVH) 的实例, 只保存世界到物体空间的变换
+class instance : public hittable {
+public:
+	instance(shared_ptr<hittable> prototype, const transform& object_to_world);
+
+	virtual bool hit(const ray& r, double t_min, double t_max, hit_record& rec) const override;
+	virtual bool bounding_box(aabb& output_box) const override;
+
+public:
+	shared_ptr<hittable> prototype;
+	transform world_to_object;
+};
+
+#endif // !INSTANCE_H
@@ -7,6 +7,7 @@ public:
 	Line() {}
 	Line(vec3 header, vec3 tail, shared_ptr<material> mat) : p1(header), p2(tail), mat_ptr(mat){}
 	virtual bool hit(const ray& r, double t_min, double t_max, hit_record& rec) const override;
+	virtual bool bounding_box(aabb& output_box) const override;
 
 private:
 	vec3 p1;
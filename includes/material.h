@@ -3,56 +3,333 @@
 
 #include "rtweekend.h"
 #include "hittable.h"
+#include "render_stats.h"
+#include "texture.h"
+#include "microfacet.h"
+#include "onb.h"
 
 struct hit_record;
 
+// ͱǩ, scatter ͨ switch ַ麯
+enum class material_type : unsigned char {
+	lambertian = 0,
+	metal,
+	dielectric,
+	custom
+};
+
+// һ BSDF Ľ, ռв
+struct bsdf_sample {
+	vec3 wi;			// ɢ䷽, λ
+	color f;			// BSDF ֵ, 
+	double pdf;			// ǲµĸܶ
+	color weight;		// ·Ȩ f * |cos| / pdf, ɲֱӵõ
+	bool specular;		// delta ֲ (뾵, ⻬, Զ): f  pdf , ֻʹ weight
+};
+
+// ղʼ¼: òʹͬһ, ԰
 class material {
 public:
+	material() : type(material_type::lambertian), texture_id(no_texture), albedo(color(1.0, 1.0, 1.0)), roughness(0.0), ref_rdx(1.0) {}
+	material(material_type type, color albedo, double roughness, double ri);
 
 	//ɢ
-	virtual bool scatter(const ray& r_in, const hit_record& rec, color& attenuation, ray& scattered) const = 0;
-};
+	inline bool scatter(const ray& r_in, const hit_record& rec, color& attenuation, ray& scattered) const;
+	static double schlick(double cosine, double ri);
 
-//ɢ
-class lambertian : public material {
-public:
-	lambertian() : albedo(color(1.0, 1.0, 1.0)) {}
-	lambertian(color albedo);
+	//  BSDF ҪԲɢ䷽; 䵽һʱ false, ·ֹ
+	inline bool sample(const ray& r_in, const hit_record& rec, bsdf_sample& s) const;
+
+	// wo ָ۲, wi ָԴ, Ǳĵλ; ڹԴҪԲ (MIS)
+	// delta ֲԶʵ eval  pdf Ϊ 0; footprint ΪĹ˿,  sample_texture
+	inline color eval(const hit_record& rec, const vec3& wi, const vec3& wo, double footprint = 0.0) const;
+	inline double pdf(const hit_record& rec, const vec3& wi, const vec3& wo) const;
+
+	// е㴦ķ: ʱֵ, ߵĸǷΧ
+	inline color albedo_at(const ray& r_in, const hit_record& rec) const {
+		return albedo_at(rec, r_in.footprint(rec.t));
+	}
+
+	inline color albedo_at(const hit_record& rec, double footprint) const {
+		return texture_id == no_texture ? albedo : albedo * sample_texture(texture_id, rec, footprint);
+	}
 
-	virtual bool scatter(const ray& r_in, const hit_record& rec, color& atteuation, ray& scattered) const override;
+private:
+	inline bool sample_lambertian(const ray& r_in, const hit_record& rec, bsdf_sample& s) const;
+	inline bool sample_metal(const ray& r_in, const hit_record& rec, bsdf_sample& s) const;
+	inline bool sample_dielectric(const ray& r_in, const hit_record& rec, bsdf_sample& s) const;
+
+	// eval  pdf Ĺͬʵ: д f,  pdf
+	inline double evaluate(const hit_record& rec, const vec3& wi, const vec3& wo, double footprint, color& f) const;
+	inline double evaluate_microfacet(const hit_record& rec, const vec3& wi, const vec3& wo, double footprint, color& f) const;
+
+	// ΢ϵ Fresnel , ȫʱΪ 1
+	inline double dielectric_fresnel(double cos_m, double etai_over_etat) const {
+		double sin2_t = etai_over_etat * etai_over_etat * (1.0 - cos_m * cos_m);
+		return sin2_t >= 1.0 ? 1.0 : schlick(cos_m, etai_over_etat);
+	}
 
 public:
+	material_type type;
+
+	// еı,  albedo (lambertian / metal)
+	uint32_t texture_id;
+
 	//
 	color albedo;
+
+	//ֲڶ (metal / dielectric), 0 Ϊ뾵, GGX alpha = roughness^2
+	double roughness;
+
+	// (dielectric)
+	double ref_rdx;
+};
+
+//ɢ
+class lambertian : public material {
+public:
+	lambertian() : lambertian(color(1.0, 1.0, 1.0)) {}
+	lambertian(color albedo);
 };
 
 //
 class metal : public material {
 public:
-	metal() : albedo(color(1.0, 1.0, 1.0)), roughness(0.0) {}
+	metal() : metal(color(1.0, 1.0, 1.0), 0.0) {}
 	metal(color albedo, double roughness);
-
-	virtual bool scatter(const ray& r_in, const hit_record& rec, color& atteuation, ray& scattered) const override;
-
-public:
-	//
-	color albedo;
-
-	//ֲڶ
-	double roughness;
 };
 
 //
 class dielectric : public material {
 public:
-	dielectric() : ref_rdx(1.0) {}
-	dielectric(double ri);
+	dielectric() : dielectric(1.0) {}
+	dielectric(double ri, double roughness = 0.0);
+};
 
-	virtual bool scatter(const ray& r_in, const hit_record& rec, color& atteuation, ray& scattered) const override;
-	double schlick(double cosine, double ri) const;
+// Զʵչ: ʵ scatter_custom, ͨ material::scatter 
+class custom_material : public material {
+public:
+	custom_material() : material(material_type::custom, color(1.0, 1.0, 1.0), 0.0, 1.0) {}
+	virtual ~custom_material() {}
 
-private:
-	double ref_rdx;
+	virtual bool scatter_custom(const ray& r_in, const hit_record& rec, color& attenuation, ray& scattered) const = 0;
 };
 
+inline bool material::scatter(const ray& r_in, const hit_record& rec, color& attenuation, ray& scattered) const {
+	RT_STAT_INC(scatter_calls[static_cast<int>(type)]);
+	if (type == material_type::custom) {
+		return static_cast<const custom_material*>(this)->scatter_custom(r_in, rec, attenuation, scattered);
+	}
+
+	bsdf_sample s;
+	if (!sample(r_in, rec, s)) {
+		return false;
+	}
+	scattered = ray(rec.p3, s.wi, r_in.time());
+	attenuation = s.weight;
+	return true;
+}
+
+inline bool material::sample(const ray& r_in, const hit_record& rec, bsdf_sample& s) const {
+	switch (type) {
+	case material_type::lambertian:	return sample_lambertian(r_in, rec, s);
+	case material_type::metal:		return sample_metal(r_in, rec, s);
+	case material_type::dielectric:	return sample_dielectric(r_in, rec, s);
+	case material_type::custom: {
+		// Զֻṩ scatter_custom, ֵ delta ֲ
+		ray scattered;
+		if (!static_cast<const custom_material*>(this)->scatter_custom(r_in, rec, s.weight, scattered)) return false;
+		s.wi = unit_vector(scattered.direction());
+		s.f = s.weight;
+		s.pdf = 0.0;
+		s.specular = true;
+		return true;
+	}
+	}
+
+	return false;
+}
+
+inline color material::eval(const hit_record& rec, const vec3& wi, const vec3& wo, double footprint) const {
+	color f;
+	evaluate(rec, wi, wo, footprint, f);
+	return f;
+}
+
+inline double material::pdf(const hit_record& rec, const vec3& wi, const vec3& wo) const {
+	// pdf 뷴޹, ȡ
+	if (type == material_type::lambertian) {
+		return dot(wo, rec.normal) > 0.0 ? std::fmax(dot(wi, rec.normal), 0.0) / pi : 0.0;
+	}
+	color f;
+	return evaluate(rec, wi, wo, 0.0, f);
+}
+
+inline double material::evaluate(const hit_record& rec, const vec3& wi, const vec3& wo, double footprint, color& f) const {
+	f = color(0, 0, 0);
+	switch (type) {
+	case material_type::lambertian: {
+		// f = albedo / pi, pdf = cos / pi
+		double cos_i = dot(wi, rec.normal);
+		if (cos_i <= 0.0 || dot(wo, rec.normal) <= 0.0) return 0.0;
+		f = albedo_at(rec, footprint) / pi;
+		return cos_i / pi;
+	}
+	case material_type::metal:
+	case material_type::dielectric:
+		return roughness == 0.0 ? 0.0 : evaluate_microfacet(rec, wi, wo, footprint, f);
+	case material_type::custom:
+		return 0.0;
+	}
+
+	return 0.0;
+}
+
+inline double material::evaluate_microfacet(const hit_record& rec, const vec3& wi, const vec3& wo, double footprint, color& f) const {
+	onb frame(rec.normal);
+	vec3 o = frame.to_local(wo);
+	vec3 i = frame.to_local(wi);
+	if (o.z() <= 0.0) return 0.0;
+
+	const double alpha = ggx::alpha_from_roughness(roughness);
+	if (i.z() > 0.0) {
+		// : f = F D G2 / (4 cos_o cos_i), ɼ߲ܶΪ G1(wo) D(m) / (4 cos_o)
+		vec3 m = unit_vector(o + i);
+		double cos_m = dot(o, m);
+		double d = ggx::distribution(m, alpha);
+		double reflect = d * ggx::masking_shadowing(o, i, alpha) / (4.0 * o.z() * i.z());
+		double density = ggx::reflection_pdf(o, m, alpha);
+		if (type == material_type::metal) {
+			color f0 = albedo_at(rec, footprint);
+			f = fresnel_schlick(f0, cos_m) * reflect * ggx::energy_compensation(f0, o.z(), alpha);
+			return density;
+		}
+		double fresnel = dielectric_fresnel(cos_m, rec.front_face ? (1.0 / ref_rdx) : ref_rdx);
+		f = color(1.0, 1.0, 1.0) * (fresnel * reflect);
+		return fresnel * density;
+	}
+	if (type != material_type::dielectric || i.z() == 0.0) return 0.0;
+
+	//  (Walter 2007):  m  -(eta * wo + wi) ͬ; ⻬һ,  eta^2 ŷ
+	const double eta = rec.front_face ? (1.0 / ref_rdx) : ref_rdx;
+	vec3 m = unit_vector(-(eta * o + i));
+	if (m.z() < 0.0) m = -m;
+	double cos_om = dot(o, m);
+	double cos_im = dot(i, m);
+	if (cos_om <= 0.0 || cos_im >= 0.0) return 0.0;
+
+	double transmit = 1.0 - dielectric_fresnel(cos_om, eta);
+	double denom = eta * cos_om + cos_im;
+	double jacobian = std::abs(cos_im) / (denom * denom);
+	double d = ggx::distribution(m, alpha);
+	f = color(1.0, 1.0, 1.0) * (transmit * d * ggx::masking_shadowing(o, i, alpha) * cos_om * jacobian / (o.z() * std::abs(i.z())));
+	return transmit * d * cos_om * jacobian / ((1.0 + ggx::lambda(o, alpha)) * o.z());
+}
+
+inline bool material::sample_lambertian(const ray& r_in, const hit_record& rec, bsdf_sample& s) const {
+	// ҼȨ, f * cos / pdf ǡΪ
+	double u1 = random_double();
+	double u2 = random_double();
+	vec3 local = sample_cosine_hemisphere(u1, u2);
+	color a = albedo_at(r_in, rec);
+
+	s.wi = onb(rec.normal).to_world(local);
+	s.f = a / pi;
+	s.pdf = local.z() / pi;
+	s.weight = a;
+	s.specular = false;
+	return true;
+}
+
+inline bool material::sample_metal(const ray& r_in, const hit_record& rec, bsdf_sample& s) const {
+	// albedo Ϊʱķ F0, Fresnel  Schlick 
+	vec3 unit_direction = unit_vector(r_in.direction());
+	color f0 = albedo_at(r_in, rec);
+	if (roughness == 0.0) {
+		s.wi = reflect(unit_direction, rec.normal);
+		s.weight = fresnel_schlick(f0, dot(-unit_direction, rec.normal));
+		s.f = s.weight;
+		s.pdf = 0.0;
+		s.specular = true;
+		return true;
+	}
+
+	// GGX : ɼ߲΢, ȨΪ F * G2 / G1, ٲɢ䶪ʧ
+	onb frame(rec.normal);
+	vec3 wo = frame.to_local(-unit_direction);
+	if (wo.z() <= 0.0) return false;
+
+	double alpha = ggx::alpha_from_roughness(roughness);
+	double u1 = random_double();
+	double u2 = random_double();
+	vec3 m = ggx::sample_visible_normal(wo, alpha, u1, u2);
+	double cos_m = dot(wo, m);
+	vec3 wi = 2.0 * cos_m * m - wo;
+	if (wi.z() <= 0.0) return false;
+
+	s.wi = frame.to_world(wi);
+	s.weight = fresnel_schlick(f0, cos_m) * ggx::sampled_weight(wo, wi, alpha) * ggx::energy_compensation(f0, wo.z(), alpha);
+	s.f = fresnel_schlick(f0, cos_m) * (ggx::distribution(m, alpha) * ggx::masking_shadowing(wo, wi, alpha) / (4.0 * wo.z() * wi.z()))
+		* ggx::energy_compensation(f0, wo.z(), alpha);
+	s.pdf = ggx::reflection_pdf(wo, m, alpha);
+	s.specular = false;
+	return true;
+}
+
+inline bool material::sample_dielectric(const ray& r_in, const hit_record& rec, bsdf_sample& s) const {
+	double etai_over_etat = (rec.front_face) ? (1.0 / ref_rdx) : ref_rdx;
+
+	vec3 unit_direction = unit_vector(r_in.direction());
+	if (roughness > 0.0) {
+		// ֲڲ (Walter 2007): ɼ߲΢, ΢ϰ Fresnel ѡ
+		onb frame(rec.normal);
+		vec3 wo = frame.to_local(-unit_direction);
+		if (wo.z() <= 0.0) return false;
+
+		double alpha = ggx::alpha_from_roughness(roughness);
+		double u1 = random_double();
+		double u2 = random_double();
+		vec3 m = ggx::sample_visible_normal(wo, alpha, u1, u2);
+		double cos_m = dot(wo, m);
+		double reflect_prob = dielectric_fresnel(cos_m, etai_over_etat);
+
+		vec3 wi;
+		if (random_double() < reflect_prob) {
+			wi = 2.0 * cos_m * m - wo;
+			if (wi.z() <= 0.0) return false;
+		}
+		else {
+			wi = refract(-wo, m, etai_over_etat);
+			if (wi.z() >= 0.0) return false;
+		}
+		s.wi = frame.to_world(wi);
+		s.weight = color(1.0, 1.0, 1.0) * ggx::sampled_weight(wo, wi, alpha);
+		s.pdf = evaluate_microfacet(rec, s.wi, -unit_direction, 0.0, s.f);
+		s.specular = false;
+		return true;
+	}
+
+	s.weight = color(1.0, 1.0, 1.0);
+	s.f = s.weight;
+	s.pdf = 0.0;
+	s.specular = true;
+
+	double cos_theta = std::fmin(dot(-unit_direction, rec.normal), 1.0);
+	double sin_theta = std::sqrt(1.0 - cos_theta * cos_theta);
+	if (etai_over_etat * sin_theta > 1.0) {
+		s.wi = reflect(unit_direction, rec.normal);
+		return true;
+	}
+
+	double reflect_prob = schlick(cos_theta, etai_over_etat);
+	if (random_double() < reflect_prob)
+	{
+		s.wi = reflect(unit_direction, rec.normal);
+		return true;
+	}
+
+	s.wi = refract(unit_direction, rec.normal, etai_over_etat);
+	return true;
+}
+
 #endif // !MATERIAL_H
@@ -0,0 +1,9 @@
+#ifndef MATERIAL_CHECK_H
+#define MATERIAL_CHECK_H
+
+// 材质采样接口的自检: 对每种材质采样方向, 检查非 delta 分布满足 sample().f == eval(),
+// sample().pdf == pdf(), 且 weight == f * |cos| / pdf; delta 分布的 eval 与 pdf 必须为 0
+// 全部通过时返回 true
+bool check_materials(int count);
+
+#endif // !MATERIAL_CHECK_H
@@ -0,0 +1,19 @@
+#ifndef MESH_LOADER_H
+#define MESH_LOADER_H
+
+#include "triangle_mesh.h"
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+// Wavefront OBJ: 只读取 v 与 f, 多边形按扇形三角化, 支持负索引
+bool load_obj(const std::string& path, std::vector<float>& positions, std::vector<uint32_t>& indices);
+
+// 二进制 PLY (大端/小端): 读取 vertex 的 x/y/z 与 face 的顶点索引列表
+bool load_ply(const std::string& path, std::vector<float>& positions, std::vector<uint32_t>& indices);
+
+// 根据扩展名选择加载器, 失败返回 nullptr
+shared_ptr<triangle_mesh> load_mesh(const std::string& path, shared_ptr<material> mat);
+
+#endif // !MESH_LOADER_H
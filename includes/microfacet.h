@@ -0,0 +1,67 @@
+#ifndef MICROFACET_H
+#define MICROFACET_H
+
+#include "rtweekend.h"
+
+#include <algorithm>
+
+// (1 - cosine)^5, 查表线性插值, 代替 Schlick 近似中的 pow
+double schlick_weight(double cosine);
+
+inline color fresnel_schlick(const color& f0, double cosine) {
+	return f0 + (color(1.0, 1.0, 1.0) - f0) * schlick_weight(cosine);
+}
+
+// GGX 微表面模型, 向量都在以宏观法线为 z 轴的局部坐标系中 (见 onb)
+namespace ggx {
+	// 感知粗糙度到 alpha 的映射, 下限避免采样退化
+	inline double alpha_from_roughness(double roughness) {
+		return std::max(roughness * roughness, 1e-3);
+	}
+
+	// Smith 遮蔽函数中的 Lambda(w)
+	inline double lambda(const vec3& w, double alpha) {
+		double cos2 = w.z() * w.z();
+		double tan2 = std::max(0.0, 1.0 - cos2) / std::max(cos2, 1e-12);
+		return 0.5 * (std::sqrt(1.0 + alpha * alpha * tan2) - 1.0);
+	}
+
+	// 法线分布 D(m)
+	inline double distribution(const vec3& m, double alpha) {
+		if (m.z() <= 0.0) return 0.0;
+		double a2 = alpha * alpha;
+		double d = m.z() * m.z() * (a2 - 1.0) + 1.0;
+		return a2 / (pi * d * d);
+	}
+
+	// 高度相关的 Smith 遮蔽-阴影函数 G2(wo, wi)
+	inline double masking_shadowing(const vec3& wo, const vec3& wi, double alpha) {
+		return 1.0 / (1.0 + lambda(wo, alpha) + lambda(wi, alpha));
+	}
+
+	// 可见法线采样得到 m 后按 m 反射的方向密度: G1(wo) D(m) / (4 wo.z)
+	inline double reflection_pdf(const vec3& wo, const vec3& m, double alpha) {
+		return distribution(m, alpha) / ((1.0 + lambda(wo, alpha)) * 4.0 * wo.z());
+	}
+
+	// 按可见法线分布采样微表面法线 (Heitz 2018), wo.z > 0
+	vec3 sample_visible_normal(const vec3& wo, double alpha, double u1, double u2);
+
+	// 按可见法线采样时的路径权重 G2(wo, wi) / G1(wo), 高度相关的 Smith 遮蔽; 反射与折射通用
+	inline double sampled_weight(const vec3& wo, const vec3& wi, double alpha) {
+		double lo = lambda(wo, alpha);
+		double li = lambda(wi, alpha);
+		return (1.0 + lo) / (1.0 + lo + li);
+	}
+
+	// 单次散射 (F = 1) 的方向反照率 E(cos_o, alpha), 预计算表双线性插值
+	double directional_albedo(double cos_o, double alpha);
+
+	// 单次散射丢失的多次散射能量的补偿因子 1 + F0 (1 - E) / E (Turquin 2019)
+	inline color energy_compensation(const color& f0, double cos_o, double alpha) {
+		double e = directional_albedo(cos_o, alpha);
+		return color(1.0, 1.0, 1.0) + f0 * ((1.0 - e) / e);
+	}
+}
+
+#endif // !MICROFACET_H
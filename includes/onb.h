@@ -0,0 +1,34 @@
+#ifndef ONB_H
+#define ONB_H
+
+#include "rtweekend.h"
+
+// 以 n 为 w 轴的正交基, 用于在法线的局部坐标系中采样 (Duff et al. 2017, 无分支)
+class onb {
+public:
+	onb() {}
+
+	explicit onb(const vec3& n) {
+		double sign = std::copysign(1.0, n.z());
+		double a = -1.0 / (sign + n.z());
+		double b = n.x() * n.y() * a;
+		u = vec3(1.0 + sign * n.x() * n.x() * a, sign * b, -sign * n.x());
+		v = vec3(b, sign + n.y() * n.y() * a, -n.y());
+		w = n;
+	}
+
+	// 局部坐标 (x, y, z) 到世界坐标
+	inline vec3 to_world(const vec3& a) const {
+		return a.e[0] * u + a.e[1] * v + a.e[2] * w;
+	}
+
+	// 世界坐标到局部坐标, z 分量为与法线夹角的余弦
+	inline vec3 to_local(const vec3& a) const {
+		return vec3(dot(a, u), dot(a, v), dot(a, w));
+	}
+
+public:
+	vec3 u, v, w;
+};
+
+#endif // !ONB_H
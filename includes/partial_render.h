@@ -0,0 +1,86 @@
+#ifndef PARTIAL_RENDER_H
+#define PARTIAL_RENDER_H
+
+#include "rtweekend.h"
+#include "framebuffer.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// 样本区间渲染的部分结果: 每个样本量化为定点整数后累加
+// 整数加法满足结合律, 任意切分样本区间后合并, 结果与单进程渲染整个区间逐位相同
+// 单进程的 --samples 与盒式滤波的 render_to_file 同样按此定点累加; 渐进模式与其他重建滤波按 double 累加,
+// 与合并结果只在舍入误差内一致
+class partial_buffer {
+public:
+	static const int fraction_bits = 32;
+
+	partial_buffer();
+	partial_buffer(int width, int height);
+
+	void resize(int width, int height);
+
+	int width() const { return w; }
+	int height() const { return h; }
+
+	inline void add_sample(int x, int y, const color& c) {
+		size_t index = size_t(y) * w + x;
+		int64_t* p = &sums[3 * index];
+		p[0] += quantize(c.e[0]);
+		p[1] += quantize(c.e[1]);
+		p[2] += quantize(c.e[2]);
+		counts[index]++;
+	}
+
+	// 非法值记为 0, 单个样本限制在 [0, 65536], 保证 2^15 个样本内不会溢出
+	static inline int64_t quantize(double v) {
+		if (!(v > 0.0)) return 0;
+		if (v > 65536.0) v = 65536.0;
+		return static_cast<int64_t>(v * 4294967296.0 + 0.5);
+	}
+
+	// 定点和乘以该系数得到平均值, 未采样的像素为 0
+	static inline double resolve_scale(uint32_t count) {
+		return count > 0 ? 1.0 / 4294967296.0 / count : 0.0;
+	}
+
+	// 合并另一个区间的结果, 尺寸不同时返回 false
+	bool merge(const partial_buffer& other);
+	void resolve(framebuffer& fb) const;
+
+	const std::vector<int64_t>& sum_data() const { return sums; }
+	const std::vector<uint32_t>& count_data() const { return counts; }
+	std::vector<int64_t>& sum_data() { return sums; }
+	std::vector<uint32_t>& count_data() { return counts; }
+
+private:
+	int w;
+	int h;
+	std::vector<int64_t> sums;
+	std::vector<uint32_t> counts;
+};
+
+// 部分结果所覆盖的样本区间与渲染参数, 合并时用于检查各部分是否来自同一帧
+struct partial_info {
+	int32_t width = 0;
+	int32_t height = 0;
+	int32_t first_sample = 0;
+	int32_t end_sample = 0;
+	int32_t max_depth = 0;
+	int32_t reserved = 0;
+
+	// vfov, lookfrom[3], lookat[3], vup[3], aperture, focus_dist, shutter_open, shutter_close
+	double camera[14] = {};
+};
+
+// 以 .rtpart 结尾的路径保存部分结果, 其他路径输出图像
+bool is_partial_path(const std::string& path);
+
+bool save_partial(const std::string& path, const partial_info& info, const partial_buffer& partial);
+bool load_partial(const std::string& path, partial_info& info, partial_buffer& partial);
+
+// 合并若干部分结果; 样本区间重叠或渲染参数不一致时失败, 区间有空缺时给出提示
+bool merge_partials(const std::vector<std::string>& paths, partial_info& info, partial_buffer& merged);
+
+#endif // !PARTIAL_RENDER_H
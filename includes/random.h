@@ -0,0 +1,57 @@
+#ifndef RANDOM_H
+#define RANDOM_H
+
+#include <cstdint>
+
+// 线程局部 PCG32 随机数, 替代全局 rand():
+// 各线程互不干扰, 并且可以按 (像素, 样本序号) 重新播种, 使渲染结果与线程调度无关
+struct rng_state {
+	uint64_t state;
+	uint64_t inc;
+};
+
+inline rng_state& thread_rng() {
+	static thread_local rng_state rng = { 0x853c49e6748fea9bULL, 0xda3e39cb94b95bdbULL };
+	return rng;
+}
+
+inline uint32_t random_u32() {
+	rng_state& rng = thread_rng();
+	uint64_t old = rng.state;
+	rng.state = old * 6364136223846793005ULL + rng.inc;
+	uint32_t xorshifted = static_cast<uint32_t>(((old >> 18u) ^ old) >> 27u);
+	uint32_t rot = static_cast<uint32_t>(old >> 59u);
+	return (xorshifted >> rot) | (xorshifted << ((~rot + 1u) & 31u));
+}
+
+// sequence 选择独立的随机序列 (如像素序号), index 为序列内的起点 (如样本序号)
+inline void seed_random(uint64_t sequence, uint64_t index) {
+	rng_state& rng = thread_rng();
+	rng.state = 0u;
+	rng.inc = (sequence << 1u) | 1u;
+	random_u32();
+	rng.state += index * 0x9e3779b97f4a7c15ULL;
+	random_u32();
+}
+
+// from 到 to 之间 random_u32 的调用次数, 两者须来自同一序列 (inc 相同)
+// LCG 跳跃的逆运算 (O'Neill, pcg 的 distance): 从低位到高位逐位确定步数, 不影响生成随机数的开销
+inline uint64_t random_distance(const rng_state& from, const rng_state& to) {
+	uint64_t state = from.state;
+	uint64_t mult = 6364136223846793005ULL;
+	uint64_t plus = from.inc;
+	uint64_t bit = 1u;
+	uint64_t distance = 0u;
+	while (state != to.state) {
+		if ((state & bit) != (to.state & bit)) {
+			state = state * mult + plus;
+			distance |= bit;
+		}
+		bit <<= 1u;
+		plus = (mult + 1u) * plus;
+		mult *= mult;
+	}
+	return distance;
+}
+
+#endif // !RANDOM_H
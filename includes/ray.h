@@ -6,16 +6,25 @@
 class ray {
 public:
 	ray();
-	ray(point3 origin, vec3 direction);
+	ray(point3 origin, vec3 direction, double time = 0.0);
 
 	point3 origin() const;
 	vec3 direction() const;
+	double time() const { return tm; }
 
 	point3 at(double t) const;
 
+	// 光线锥在距离 t 处的宽度 (世界空间), 用于选择纹理的 mip 层级
+	double footprint(double t) const { return cone_width + cone_spread * t * dir.length(); }
+
 public:
 	point3 orig;
 	vec3 dir;
+	double tm;	// 快门内的时刻, 0 与 1 分别为一帧时间区间的起点与终点
+
+	// 光线锥: 起点处的宽度与每单位距离的扩展量, 都为 0 时不做纹理过滤
+	double cone_width;
+	double cone_spread;
 
 };
 
@@ -0,0 +1,98 @@
+#ifndef RENDER_JOB_H
+#define RENDER_JOB_H
+
+#include "rtweekend.h"
+#include "camera.h"
+#include "accumulator.h"
+#include "film_filter.h"
+
+#include <thread_pool.hpp>
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+
+// 协作式取消标记: 拷贝共享同一个标志, 工作线程在像素粒度上检查
+class cancellation_token {
+public:
+	cancellation_token() : flag(std::make_shared<std::atomic<bool>>(false)) {}
+
+	void cancel() const { flag->store(true, std::memory_order_relaxed); }
+	bool cancelled() const { return flag->load(std::memory_order_relaxed); }
+
+private:
+	std::shared_ptr<std::atomic<bool>> flag;
+};
+
+// 图像中的矩形区域 [x0, x1) x [y0, y1), 行号约定与 framebuffer 相同 (0 为底部)
+struct render_region {
+	int x0 = 0;
+	int y0 = 0;
+	int x1 = 0;
+	int y1 = 0;
+
+	bool empty() const { return x1 <= x0 || y1 <= y0; }
+	int width() const { return x1 - x0; }
+	int height() const { return y1 - y0; }
+};
+
+// 一次渲染使用的参数快照, 渲染期间 UI 修改相机不会影响正在运行的任务
+struct render_job_settings {
+	camera view;
+	int width = 0;
+	int height = 0;
+	int samples_per_pixel = 1;
+	int samples_per_pass = 1;
+	int max_depth = 1;
+	int band_height = 16;
+	reconstruction_filter filter;
+	render_region region;	// 只渲染该区域, 为空时为整幅图像; 相机仍按 width x height 成像
+};
+
+// 渐进式渲染任务: 驱动线程按 pass 把行带提交到线程池, 每个 pass 结束后等待全部 future 再回调
+class render_job {
+public:
+	// 渲染 [first_row, first_row + row_count) 行的 [first_sample, first_sample + sample_count) 个样本
+	using band_function = std::function<void(render_job& job, int first_row, int row_count, int first_sample, int sample_count)>;
+	using pass_function = std::function<void(render_job& job)>;
+
+	render_job(const render_job_settings& settings);
+	render_job(const render_job&) = delete;
+	render_job& operator=(const render_job&) = delete;
+	~render_job();
+
+	// 从 first_sample 开始 (恢复检查点时非 0), 立即返回
+	void start(mt::ThreadPool& pool, band_function band, pass_function on_pass, int first_sample = 0);
+
+	// 请求取消并等待驱动线程及其提交的所有任务结束
+	void cancel();
+	void wait();
+
+	const render_job_settings& settings() const { return job_settings; }
+	const cancellation_token& token() const { return cancel_token; }
+	bool cancelled() const { return cancel_token.cancelled(); }
+	bool finished() const { return done; }
+	int completed_samples() const { return next_sample; }
+
+	accumulation_buffer& accum() { return buffer; }
+	const accumulation_buffer& accum() const { return buffer; }
+
+	// 非盒式滤波时起始于 first_row 的行带的累积区, 由该行带的任务独占
+	film_band& band(int first_row) { return bands[first_row / job_settings.band_height]; }
+
+private:
+	void drive(mt::ThreadPool& pool, band_function band, pass_function on_pass);
+
+private:
+	render_job_settings job_settings;
+	cancellation_token cancel_token;
+	accumulation_buffer buffer;
+	std::vector<film_band> bands;
+	std::atomic<int> next_sample;
+	std::atomic<bool> done;
+	std::thread driver;
+};
+
+#endif // !RENDER_JOB_H
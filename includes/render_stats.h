@@ -0,0 +1,77 @@
+#ifndef RENDER_STATS_H
+#define RENDER_STATS_H
+
+#include <cstdint>
+#include <string>
+
+// 渲染统计: 每个线程写自己的计数器, 渲染结束 (所有任务已 join) 后再汇总
+// 定义 RENDER_STATS_ENABLED 时才会计数, 否则所有 RT_STAT_* 宏展开为空
+
+// 路径结束原因
+enum path_end {
+	path_escaped = 0,	// 没有击中任何物体, 取背景色
+	path_absorbed,		// 材质没有产生散射光线
+	path_depth_limit,	// 达到 max_depth
+	path_end_count
+};
+
+const int stats_material_types = 4;		// 与 material_type 一一对应
+const int stats_path_length_bins = 64;	// 最后一格统计所有更长的路径
+
+struct render_stats {
+	uint64_t primary_rays;
+	uint64_t secondary_rays;
+	uint64_t intersection_tests;
+	uint64_t bvh_nodes_visited;
+	uint64_t grid_cells_visited;
+	uint64_t scatter_calls[stats_material_types];
+	uint64_t path_ends[path_end_count];
+	uint64_t path_length[stats_path_length_bins];
+
+	render_stats() { clear(); }
+
+	void clear();
+	void merge(const render_stats& other);
+
+	uint64_t rays() const { return primary_rays + secondary_rays; }
+
+	std::string to_json(double seconds) const;
+	bool write_json(const std::string& path, double seconds) const;
+};
+
+// 汇总所有线程 (包括已退出的线程) 的计数; 调用时不应有线程在计数
+render_stats collect_render_stats();
+void reset_render_stats();
+
+#ifdef RENDER_STATS_ENABLED
+
+// 线程局部计数器, 构造时注册, 线程退出时把计数并入全局
+struct render_stats_slot {
+	render_stats data;
+
+	render_stats_slot();
+	~render_stats_slot();
+};
+
+inline render_stats& local_render_stats() {
+	static thread_local render_stats_slot slot;
+	return slot.data;
+}
+
+#define RT_STAT_INC(field) (++local_render_stats().field)
+#define RT_STAT_ADD(field, n) (local_render_stats().field += (n))
+
+// 热循环里先累加到局部变量, 循环结束后一次性写入线程计数器
+#define RT_STAT_COUNTER(name) uint64_t name = 0
+#define RT_STAT_COUNT(name) (++name)
+
+#else
+
+#define RT_STAT_INC(field) ((void)0)
+#define RT_STAT_ADD(field, n) ((void)0)
+#define RT_STAT_COUNTER(name)
+#define RT_STAT_COUNT(name) ((void)0)
+
+#endif // RENDER_STATS_ENABLED
+
+#endif // !RENDER_STATS_H
@@ -6,6 +6,13 @@
 #include "camera.h"
 #include "color.h"
 #include "hittable_list.h"
+#include "scene.h"
+#include "framebuffer.h"
+#include "image_writer.h"
+#include "accumulator.h"
+#include "render_job.h"
+#include "render_stats.h"
+#include "denoiser.h"
 #include "../Platform/Platform.hpp"
 
 #include <glad/glad.h>
@@ -16,6 +23,8 @@
 
 #include <thread_pool.hpp>
 
+#include <functional>
+
 class renderer {
 public:
 	renderer();
@@ -25,6 +34,62 @@ public:
 	void render();
 	void close();
 
+	bool load_scene(const std::string& path);
+	bool save_scene(const std::string& path);
+	bool save_image(const std::string& path);
+
+	// 无窗口渲染到文件, 行带完成后立即写出, 不保留整幅帧缓冲
+	bool render_to_file(const std::string& path, int width, int height);
+
+	// 渐进式无窗口渲染, 定期把累积缓冲写入检查点; resume 时从检查点继续, 结果与不中断时一致
+	bool render_progressive(const std::string& path, int width, int height, const std::string& checkpoint_path, bool resume, double checkpoint_interval);
+
+	// 分布式渲染: 协调者按行分块分发给工作进程并合并结果, 工作进程断开时重新分发
+	bool run_coordinator(uint16_t port, const std::string& path, int width, int height, const std::string& scene_path, double worker_timeout);
+	bool run_worker(const std::string& host, uint16_t port);
+
+	// 只渲染每个像素的样本 [first_sample, end_sample); 输出 .rtpart 时保存定点原始和, 可用 merge_partials 合并
+	bool render_sample_range(const std::string& path, int width, int height, int first_sample, int end_sample);
+
+	// 帧序列渲染: 按场景中的相机关键帧渲染第 first_frame..last_frame 帧, 场景没有关键帧时绕 lookat 转一周
+	// 场景、加速结构与线程池在各帧之间复用, 下一帧开始渲染时上一帧的尾部仍在编码写出
+	// pattern 中的 %d / %04d 替换为帧号, 没有时在扩展名前插入 _0001
+	bool render_sequence(const std::string& pattern, int width, int height, int first_frame, int last_frame);
+
+	// 低采样数渲染后做特征引导的降噪; write_aovs 时另外写出 _noisy / _albedo / _normal / _depth 图像
+	bool render_denoised(const std::string& path, int width, int height, bool write_aovs);
+
+	// 动态场景: 停止当前渲染, 在 edit 中移动/增删球体, 然后增量更新加速结构
+	// 交互渲染进行中时会以新场景重新开始
+	sphere_update edit_scene(const std::function<void(sphere_set&)>& edit);
+
+	// 交互测试动态更新: 随机移动 fraction 比例的球, 位移不超过各自半径的 amount 倍; 跳过地面这样的大球
+	sphere_update jitter_spheres(double fraction, double amount);
+
+	// 球体集合使用的加速结构, 已加载的场景会立即重建
+	void set_accelerator(sphere_accelerator type);
+
+	// 在默认场景的不同规模 (约 (2 * size)^2 个小球) 下比较 BVH 与均匀网格的构建和渲染时间
+	void benchmark_accelerators(const std::vector<int>& sizes, int width, int height, int samples);
+
+	// 无窗口渲染结束后把统计计数写成 JSON
+	void set_stats_path(const std::string& path) { stats_path = path; }
+
+	void set_samples_per_pixel(int samples) { samples_per_pixel = std::max(1, samples); }
+
+	// 交互预览的分辨率, 宽高比随之改变; 渲染中修改时以新尺寸重新开始, 预览纹理与窗口随之调整
+	void set_resolution(int width, int height);
+	int get_width() const { return image_width; }
+	int get_height() const { return image_height; }
+
+	// 只渲染 [x0, x1) x [y0, y1) 区域 (左上角为原点的像素坐标), 全为 0 时渲染整幅图像
+	// 交互模式下区域外保留上一次的画面; 单帧与帧序列的无窗口渲染只输出区域内的像素,
+	// 渐进、降噪、分布式与样本区间模式总是渲染整幅图像
+	void set_region(int x0, int y0, int x1, int y1);
+
+	// 像素重建滤波器, 用于交互、渐进与单帧无窗口渲染; 帧序列、分布式与降噪模式始终使用盒式滤波
+	void set_filter(const reconstruction_filter& f) { filter = f; }
+
 public:
 	void render_fbo();
 	void clear_fbo();
@@ -32,26 +97,60 @@ public:
 private:
 	hittable_list init_scene(int size = 11);
 
-	color ray_color(ray r, const hittable& world, int depth);
-	void subrender(int start_x, int start_y, int end_x, int end_y);
+	color ray_color(ray r, const hittable& world, int depth, int bounce, sample_features* features = nullptr);
+	color trace_sample(const render_job_settings& s, int i, int j, int sample, sample_features* features = nullptr, double* offset = nullptr);
+	color sample_pixel(const render_job_settings& s, int i, int j, int first_sample, int sample_count);
+	void render_band(const render_job_settings& s, int first_row, int row_count, image_stream_writer& writer);
+	void commit_bands(const render_job_settings& s, image_stream_writer& writer, bool bottom_up, std::vector<std::future<void>>& futures);
+	void render_feature_band(const render_job_settings& s, int first_row, int row_count, framebuffer& image, feature_buffers& features);
+	void accumulate_band(render_job& j, int first_row, int row_count, int first_sample, int sample_count);
+	void render_tile(const render_job_settings& s, int first_row, int row_count, int first_sample, int sample_count, accumulation_buffer& tile);
+
+	camera_settings current_camera() const;
+	// 当前场景与相机的摘要, 与球的存储顺序和加速结构无关; 用于检查点恢复时确认场景未变
+	uint64_t scene_hash() const;
+	double aspect_ratio() const { return double(image_width) / image_height; }
+	render_job_settings make_job_settings(const camera& view, int width, int height, int samples_per_pass) const;
+	void stop_job();
+	void clear_preview();
+	void update_preview(render_job& j);
+	void write_stats(double seconds);
 
 private:
 	// Base properties
 	float fov;
 	camera cam;
 	hittable_list world;
+	shared_ptr<sphere_set> spheres;
+	sphere_accelerator accelerator;
 	int samples_per_pixel;
 	int max_depth;
+	reconstruction_filter filter;
 	vec3 camera_pos;
 	vec3 lookat;
 	vec3 worldup;
 	double dist_to_focus;
 	float aperture;
+	double shutter_open;
+	double shutter_close;
+	camera_path animation;
+
+	// 预览分辨率与渲染区域 (左上角为原点)
+	int image_width;
+	int image_height;
+	render_region region;
 
 	// thread properties
 	std::mutex pixels_mutex;
 	std::vector<unsigned char> pixels;
-	std::atomic<bool> Renderering;
+	framebuffer hdr;
+	std::unique_ptr<render_job> job;
+
+	// statistics
+	render_stats last_stats;
+	double render_start;
+	double last_render_seconds;
+	std::string stats_path;
 	mt::ThreadPool ThreadPool;
 
 	// OpenGL properties
@@ -65,4 +164,5 @@ private:
 	float leftPanelWidth;
 	float rightPanelWidth;
 	float statusBarHeight;
+	char outputPath[256];
 };
\ No newline at end of file
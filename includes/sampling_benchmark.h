@@ -0,0 +1,9 @@
+#ifndef SAMPLING_BENCHMARK_H
+#define SAMPLING_BENCHMARK_H
+
+// 比较 vec3.h 中的闭式采样映射与原先的拒绝采样: 每次调用的耗时与实测消耗的随机数个数,
+// 并对每种分布做等面积分箱的卡方检验与矩检验, 确认映射后的分布正确
+// 全部通过时返回 true
+bool benchmark_sampling(int count);
+
+#endif // !SAMPLING_BENCHMARK_H
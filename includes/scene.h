@@ -0,0 +1,44 @@
+#ifndef SCENE_H
+#define SCENE_H
+
+#include "rtweekend.h"
+#include "hittable_list.h"
+#include "sphere_set.h"
+#include "camera_path.h"
+
+#include <string>
+
+struct render_settings {
+	int samples_per_pixel = 100;
+	int max_depth = 50;
+};
+
+class scene {
+public:
+	camera_settings cam;
+	render_settings settings;
+
+	// 相机关键帧, 为空时场景是静止的单帧; 只有文本格式保存关键帧
+	camera_path animation;
+
+	// 场景中的球体集合, 同时也是 world 中的一个对象; 网格等其他对象直接放在 world 中
+	shared_ptr<sphere_set> spheres;
+	hittable_list world;
+};
+
+/**
+ * 二进制场景格式 (.rtbin), 小端, 所有段按 64 字节对齐:
+ *   header | center_x | center_y | center_z | radius | material_ids | materials | bvh_nodes
+ * 材质与 BVH 节点直接保存内存布局, 加载时通过 mmap 零拷贝引用, 不做任何解析.
+ * 文件只能在相同 ABI 的平台之间使用, header 中记录了记录大小用于校验.
+ */
+bool save_scene_binary(const std::string& path, const scene& s);
+bool load_scene_binary(const std::string& path, scene& s);
+
+// 文本场景格式见 scene_parser.h
+bool load_scene_text(const std::string& path, scene& s);
+
+// 根据扩展名选择格式: .rtbin 为二进制, 其余按文本解析
+bool load_scene(const std::string& path, scene& s);
+
+#endif // !SCENE_H
@@ -0,0 +1,67 @@
+#ifndef SCENE_PARSER_H
+#define SCENE_PARSER_H
+
+#include "scene.h"
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * 文本场景格式 (.rts), 每行一条命令, '#' 之后为注释:
+ *   camera vfov 30 lookfrom 13 2 3 lookat 0 0 0 vup 0 1 0 aperture 0.1 focus_dist 10 shutter 0 1
+ *   settings samples_per_pixel 100 max_depth 50
+ *   texture <name> image <file.ppm|file.pfm|file.rttex> [scale s]   首次使用时在同目录生成分块 mip-map 文件 <file>.rttex
+ *   texture <name> checker <r0 g0 b0> <r1 g1 b1> [scale s]
+ *   texture <name> noise <r0 g0 b0> <r1 g1 b1> [scale s]
+ *   material <name> lambertian <r> <g> <b> [texture <name>]        纹理值与 albedo 相乘
+ *   material <name> metal <r> <g> <b> <roughness> [texture <name>]  GGX 导体, albedo 为 F0
+ *   material <name> dielectric <ri> [roughness <r>]              roughness > 0 为 GGX 粗糙玻璃
+ *   sphere <x> <y> <z> <radius> <material name> [to <x1> <y1> <z1>]   给出 to 时球心在快门区间内移动到 (x1, y1, z1)
+ *   mesh <file.obj|file.ply> <material name>
+ *   object <name> <file.obj|file.ply> <material name>       定义可实例化的网格原型, 本身不参与渲染
+ *   instance <name> [translate x y z] [rotate ax ay az deg] [scale sx sy sz]
+ *   keyframe <frame> [与 camera 相同的键]                      相机关键帧, 用于帧序列渲染
+ * instance 的变换按书写顺序依次应用. 场景对象最终组织为顶层 BVH.
+ * camera/settings 中的键都是可选的, 未给出的保持默认值.
+ * keyframe 中未给出的键沿用文件中前一行书写的关键帧 (按书写顺序, 与帧号大小无关), 第一个关键帧沿用 camera.
+ */
+class scene_parser {
+public:
+	scene_parser(scene& target);
+
+	// 按块流式读取文件, 不会把整个文件读入内存
+	bool parse_file(const std::string& path);
+
+	// line 必须以 '\0' 结尾, 解析过程中会被原地修改
+	bool parse_line(char* line);
+
+	int get_line_number() const { return line_number; }
+
+private:
+	bool parse_camera(char* p);
+	bool parse_camera_keys(char* p, camera_settings& cam);
+	bool parse_keyframe(char* p);
+	bool parse_settings(char* p);
+	bool parse_material(char* p);
+	bool parse_texture(char* p);
+	bool parse_sphere(char* p);
+	bool parse_mesh(char* p);
+	bool parse_object(char* p);
+	bool parse_instance(char* p);
+	shared_ptr<hittable> load_mesh_object(char* path, char* material_name);
+	bool fail(const char* message);
+
+private:
+	scene& target;
+	std::unordered_map<std::string, uint32_t> material_ids;
+	std::unordered_map<std::string, uint32_t> texture_ids;
+	std::vector<shared_ptr<hittable>> extra_objects;
+	std::unordered_map<std::string, shared_ptr<hittable>> prototypes;
+	std::string base_path;
+	camera_settings last_keyframe;	// 最近解析的关键帧, 之后的关键帧从它继承未给出的键
+	bool has_keyframe;
+	int line_number;
+};
+
+#endif // !SCENE_PARSER_H
@@ -3,12 +3,16 @@
 
 #include "hittable.h"
 
+#include <cmath>
+#include <utility>
+
 class sphere : public hittable {
 public:
 	sphere();
 	sphere(point3 center, double r, shared_ptr<material> mtl);
 
 	virtual bool hit(const ray& r, double t_min, double t_max, hit_record& rec) const override;
+	virtual bool bounding_box(aabb& output_box) const override;
 
 public:
 	point3 center;
@@ -16,4 +20,103 @@ public:
 	shared_ptr<material> mat_ptr;
 };
 
+// 方向归一化后的光线: 与多个球求交时只做一次归一化, 二次方程的 a 恒为 1
+struct sphere_ray {
+	point3 origin;
+	vec3 unit_dir;
+	double length;		// 原方向的长度, 参数 t 与距离之间的换算
+	double inv_length;
+
+	explicit sphere_ray(const ray& r) : origin(r.orig) {
+		length = std::sqrt(r.dir.e[0] * r.dir.e[0] + r.dir.e[1] * r.dir.e[1] + r.dir.e[2] * r.dir.e[2]);
+		inv_length = 1.0 / length;
+		unit_dir = vec3(r.dir.e[0] * inv_length, r.dir.e[1] * inv_length, r.dir.e[2] * inv_length);
+	}
+};
+
+// 光线与球求交, 距离 d 沿归一化方向计算, 区间 [d_min, d_max] 同样以距离表示
+// 判别式用 r^2 - |f - b*d|^2 计算, 远处的小球不会因为 b^2 - c 相消而丢失精度;
+// 两个根由 q = -b - sign(b)*h 与 c/q 得到, 只需一次开方, 且不会出现两个相近数相减
+inline bool hit_sphere_unit(double cx, double cy, double cz, double radius, const sphere_ray& sr, double d_min, double d_max, double& d) {
+	const double fx = sr.origin.e[0] - cx;
+	const double fy = sr.origin.e[1] - cy;
+	const double fz = sr.origin.e[2] - cz;
+	const double dx = sr.unit_dir.e[0];
+	const double dy = sr.unit_dir.e[1];
+	const double dz = sr.unit_dir.e[2];
+
+	const double b = fx * dx + fy * dy + fz * dz;
+	const double r2 = radius * radius;
+	const double c = fx * fx + fy * fy + fz * fz - r2;
+
+	// 起点在球外且背离球心: 两个根都为负
+	if (c > 0.0 && b > 0.0) {
+		return false;
+	}
+
+	const double lx = fx - b * dx;
+	const double ly = fy - b * dy;
+	const double lz = fz - b * dz;
+	const double discriminant = r2 - (lx * lx + ly * ly + lz * lz);
+	if (discriminant < 0.0) {
+		return false;
+	}
+
+	// q 为 0 时 b 与判别式都为 0, 光线在起点处与球相切, 两个根都是 0
+	const double q = -b - std::copysign(std::sqrt(discriminant), b);
+	double near_root = q != 0.0 ? c / q : 0.0;
+	double far_root = q;
+	if (near_root > far_root) std::swap(near_root, far_root);
+
+	d = near_root >= d_min ? near_root : far_root;
+	return d >= d_min && d <= d_max;
+}
+
+// SoA 批量求交 (BVH 叶子中的连续若干个球), 循环体无分支, 便于编译器向量化
+// 返回最近命中的下标, 并把 d_max 缩短为其距离; 没有命中返回 -1
+inline int hit_spheres_unit(const double* cx, const double* cy, const double* cz, const double* radius, int count,
+	const sphere_ray& sr, double d_min, double& d_max) {
+	const double ox = sr.origin.e[0], oy = sr.origin.e[1], oz = sr.origin.e[2];
+	const double dx = sr.unit_dir.e[0], dy = sr.unit_dir.e[1], dz = sr.unit_dir.e[2];
+
+	int hit_index = -1;
+	for (int i = 0; i < count; i++) {
+		const double fx = ox - cx[i];
+		const double fy = oy - cy[i];
+		const double fz = oz - cz[i];
+		const double b = fx * dx + fy * dy + fz * dz;
+		const double r2 = radius[i] * radius[i];
+		const double c = fx * fx + fy * fy + fz * fz - r2;
+		const double lx = fx - b * dx;
+		const double ly = fy - b * dy;
+		const double lz = fz - b * dz;
+		const double discriminant = r2 - (lx * lx + ly * ly + lz * lz);
+
+		// 判别式为负时按 0 开方, 结果由 hit 条件排除
+		const double q = -b - std::copysign(std::sqrt(std::fmax(discriminant, 0.0)), b);
+		const double root0 = q != 0.0 ? c / q : 0.0;
+		const double near_root = std::fmin(root0, q);
+		const double far_root = std::fmax(root0, q);
+		const double d = near_root >= d_min ? near_root : far_root;
+
+		const bool hit = discriminant >= 0.0 && d >= d_min && d <= d_max;
+		d_max = hit ? d : d_max;
+		hit_index = hit ? i : hit_index;
+	}
+
+	return hit_index;
+}
+
+// 任意长度方向的光线与球求交, t 为光线参数 (与 ray::at 一致)
+inline bool hit_sphere(const point3& center, double radius, const ray& r, double t_min, double t_max, double& t) {
+	sphere_ray sr(r);
+	double d;
+	if (!hit_sphere_unit(center.e[0], center.e[1], center.e[2], radius, sr, t_min * sr.length, t_max * sr.length, d)) {
+		return false;
+	}
+
+	t = d * sr.inv_length;
+	return true;
+}
+
 #endif // !SPHERE_H
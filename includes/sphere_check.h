@@ -0,0 +1,9 @@
+#ifndef SPHERE_CHECK_H
+#define SPHERE_CHECK_H
+
+// 球求交内核的自检: 按构造生成已知交点距离的光线 (外部射入, 远处的小球, 起点在球内, 擦边未命中, 起点处相切),
+// 比较 hit_sphere_unit 与 hit_spheres_unit 的结果, 并列出原先的二次公式在同一批光线上的误差作为对照
+// 全部通过时返回 true
+bool check_sphere_kernels(int count);
+
+#endif // !SPHERE_CHECK_H
@@ -0,0 +1,175 @@
+#ifndef SPHERE_SET_H
+#define SPHERE_SET_H
+
+#include "hittable.h"
+#include "material.h"
+#include "bvh.h"
+#include "grid.h"
+
+#include <vector>
+#include <cstdint>
+#include <future>
+
+// sphere_set 的只读数据视图, 可以指向自身存储或外部映射的内存
+struct sphere_set_view {
+	const double* center_x = nullptr;
+	const double* center_y = nullptr;
+	const double* center_z = nullptr;
+	const double* radius = nullptr;
+	const uint32_t* material_ids = nullptr;
+	size_t count = 0;
+
+	// 快门区间内的位移, 时刻 t 的球心为 center + t * motion; 没有运动图元时为空
+	const double* motion_x = nullptr;
+	const double* motion_y = nullptr;
+	const double* motion_z = nullptr;
+
+	const material* materials = nullptr;
+	size_t material_count = 0;
+
+	const bvh_node* nodes = nullptr;
+	size_t node_count = 0;
+};
+
+// 求交加速结构: BVH 适用于任意分布; 均匀网格构建为 O(n), 适合分布均匀的球和需要频繁重建的场景
+enum class sphere_accelerator {
+	bvh,
+	grid
+};
+
+// commit 对加速结构所做的更新
+enum class sphere_update {
+	none,				// 没有修改
+	refit,				// 只自底向上更新了包围盒
+	partial_rebuild,	// 重建了发生变化的子树
+	full_rebuild		// 完整重建, 包括替换为后台重建的结果
+};
+
+// SoA 存储的大量球体, 使用 BVH 或均匀网格加速求交
+// 材质表只保存内置材质记录, 自定义材质请使用单独的 sphere
+class sphere_set : public hittable {
+public:
+	sphere_set();
+
+	uint32_t add_material(const material& mat);
+
+	// 返回图元 id, 重建加速结构重排图元之后 id 保持不变
+	uint32_t add(point3 center, double radius, uint32_t material_id);
+
+	// 运动模糊: 球心在快门区间内从 center0 (时刻 0) 匀速移动到 center1 (时刻 1)
+	// BVH 按整个区间的范围划分图元, 节点分别保存开启与关闭时刻的包围盒, 求交时按光线时刻插值
+	uint32_t add(point3 center0, point3 center1, double radius, uint32_t material_id);
+	bool has_motion() const { return data.motion_x != nullptr; }
+
+	// 动态场景: 在两帧之间移动/增删图元, 然后调用 commit 更新加速结构; move 保留图元原有的运动
+	// 修改与 commit 期间不能有线程在求交; build 之后新增的图元在下次重建前逐个测试
+	bool move(uint32_t id, point3 center, double radius);
+	bool remove(uint32_t id);
+	bool contains(uint32_t id) const;
+	bool get(uint32_t id, point3& center, double& radius) const;
+
+	// 已分配的 id 个数, 有效的 id 都小于它 (删除后 id 不复用)
+	uint32_t id_limit() const;
+
+	// BVH 先自底向上 refit; 节点包围盒相对构建时明显变大后, 变化集中在局部则重建该子树,
+	// 否则在后台线程完整重建, 完成后的某次 commit 替换进来. 网格直接重建 (O(n))
+	// allow_background 为 false 时需要完整重建就立即重建
+	sphere_update commit(bool allow_background = true);
+
+	// 后台重建已启动且结果尚未被 commit 取走; wait_background 阻塞到重建完成, 结果仍由下一次 commit 替换或丢弃
+	bool background_pending() const { return background.valid(); }
+	void wait_background() const { if (background.valid()) background.wait(); }
+
+	// 完整重建并去掉已删除的图元, 保存场景前调用
+	void compact();
+
+	// 构建 set_accelerator 选择的加速结构, add 之后必须调用
+	// BVH: 按叶子顺序重排图元; 网格: 不改变图元顺序
+	void build();
+
+	// 已经构建过时按新的结构重建; 网格不写入场景文件, 保存后再加载时使用 BVH
+	void set_accelerator(sphere_accelerator type);
+	sphere_accelerator get_accelerator() const { return accelerator; }
+
+	// 直接引用外部数据 (如 mmap 的场景文件), backing 保证数据在使用期间有效
+	// 视图中没有 BVH 时会在本地构建
+	void attach(const sphere_set_view& view, std::shared_ptr<void> backing);
+
+	virtual bool hit(const ray& r, double t_min, double t_max, hit_record& rec) const override;
+	virtual bool bounding_box(aabb& output_box) const override;
+
+	const sphere_set_view& view() const { return data; }
+	size_t size() const { return data.count - removed_count; }
+
+private:
+	void build_nodes();
+	void build_grid();
+	void refresh_view();
+	void gather_columns(const std::vector<uint32_t>& slots, size_t first);
+	void resize_columns(size_t count);
+	point3 center_at(uint32_t slot, double time) const;
+
+	// 动态更新
+	struct background_build {
+		std::vector<bvh_node> nodes;
+		std::vector<uint32_t> order;
+		std::vector<uint32_t> slots;	// 快照时的存活槽位, order 是其中的下标
+	};
+
+	void make_local();
+	void index_tree();
+	void index_subtree(uint32_t root);
+	void remove_dead_slots();
+	void mark_dirty(uint32_t slot);
+	void refit_dirty();
+	aabb slot_box(uint32_t slot, double time = 0.0) const;
+	aabb swept_box(uint32_t slot) const;
+	aabb leaf_box(uint32_t offset, uint32_t count, double time = 0.0) const;
+	void refit_nodes(const uint8_t* dirty);
+	double tree_degradation(uint32_t root) const;
+	uint32_t rebuild_target() const;
+	bool rebuild_subtree(uint32_t root);
+	void start_background_build();
+	bool finish_background_build();
+
+private:
+	sphere_set_view data;
+	std::shared_ptr<void> backing;
+
+	std::vector<double> center_x;
+	std::vector<double> center_y;
+	std::vector<double> center_z;
+	std::vector<double> radius;
+	std::vector<uint32_t> material_ids;
+	std::vector<material> materials;
+	std::vector<bvh_node> nodes;
+
+	// 运动模糊: 各槽位的位移, 以及各节点在快门关闭时刻的包围盒; 静止场景中为空
+	std::vector<double> motion_x;
+	std::vector<double> motion_y;
+	std::vector<double> motion_z;
+	std::vector<aabb> end_boxes;
+
+	sphere_accelerator accelerator;
+	uniform_grid grid;
+
+	// 引用外部数据时为空, 第一次修改时由 make_local 建立
+	std::vector<uint32_t> slot_ids;		// 槽位 -> id, 已删除的槽位为 invalid_id
+	std::vector<uint32_t> id_slots;		// id -> 槽位
+	std::vector<uint32_t> slot_leaf;	// 槽位 -> 所在的叶子节点
+	std::vector<uint32_t> parents;
+	std::vector<aabb> built_boxes;		// 构建时各节点的包围盒, 用于判断变化是否局限在子树内
+	std::vector<uint8_t> dirty_nodes;
+	std::vector<uint32_t> touched_leaves;	// 本次 commit 之前有图元变化的叶子
+	std::vector<uint32_t> overflow;		// build 之后新增, 尚未进入加速结构的槽位
+	size_t removed_count;
+	bool indexed;
+	bool changed;
+
+	// add/remove 与槽位重排计数, 后台重建期间图元集合或槽位顺序变化时丢弃其结果
+	uint64_t edit_epoch;
+	uint64_t background_epoch;
+	std::future<background_build> background;
+};
+
+#endif // !SPHERE_SET_H
@@ -0,0 +1,9 @@
+#ifndef SPHERE_SET_CHECK_H
+#define SPHERE_SET_CHECK_H
+
+// sphere_set 动态修改的回归检查: 按会触发过局部重建与后台重建交错的编辑序列修改场景,
+// 之后逐个检查 id 与槽位的对应, 并用随机光线与暴力求交比较
+// 全部通过时返回 true
+bool check_sphere_set_edits();
+
+#endif // !SPHERE_SET_CHECK_H
@@ -0,0 +1,38 @@
+#ifndef TEXTURE_H
+#define TEXTURE_H
+
+#include "rtweekend.h"
+#include "hittable.h"
+
+#include <cstdint>
+#include <string>
+
+enum class texture_type : unsigned char {
+	image = 0,	// 按 (u, v) 从 texture_cache 读取
+	checker,	// 按世界坐标的三维棋盘格
+	noise		// 按世界坐标的 Perlin 大理石纹
+};
+
+// 纹理记录, 与 material 一样按值存放在全局表中; 材质只保存表中的编号
+struct texture {
+	texture_type type = texture_type::checker;
+	uint32_t image = 0;					// texture_cache 中的图像编号 (image)
+	color color0 = color(0, 0, 0);		// checker / noise 的两种颜色
+	color color1 = color(1, 1, 1);
+	double scale = 1.0;					// image: 纹理坐标的重复次数; checker / noise: 每单位长度的频率
+};
+
+const uint32_t no_texture = 0xFFFFFFFF;
+
+// 纹理表只能在渲染开始前 (场景加载时) 修改
+uint32_t add_texture(const texture& tex);
+size_t texture_count();
+
+// 读取并打开图像纹理, 失败时返回 no_texture
+uint32_t add_image_texture(const std::string& path, double scale = 1.0);
+
+// footprint 为命中点处光线锥的宽度 (世界空间): 图像纹理据此选择 mip 层级,
+// 程序纹理据此去掉高于采样频率的细节 (远处的棋盘格淡化为平均色, 噪声减少倍频程)
+color sample_texture(uint32_t id, const hit_record& rec, double footprint);
+
+#endif // !TEXTURE_H
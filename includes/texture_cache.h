@@ -0,0 +1,111 @@
+#ifndef TEXTURE_CACHE_H
+#define TEXTURE_CACHE_H
+
+#include "rtweekend.h"
+
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * 分块 mip-map 纹理格式 (.rttex), 小端:
+ *   header | level 0 的图块 | level 1 的图块 | ... | 1x1 层的图块
+ * 每层按行优先存放 ceil(w / tile_size) x ceil(h / tile_size) 个图块, 图块大小固定 (边缘用最后一个纹素填充),
+ * 纹素为 8 位 RGB, 按 gamma 2 编码 (与 image_writer 一致); 行从图像顶部开始.
+ * 图块可以按偏移量直接读取, 不需要索引表.
+ */
+struct texture_file_header {
+	char magic[8];
+	uint32_t version;
+	uint32_t endian;
+	int32_t width;
+	int32_t height;
+	int32_t levels;
+	int32_t tile_size;
+};
+
+struct texture_cache_stats {
+	uint64_t hits = 0;			// 在共享缓存中找到的图块请求 (不含线程本地的最近图块)
+	uint64_t misses = 0;		// 需要从磁盘读取的图块
+	uint64_t evictions = 0;
+	size_t resident_bytes = 0;
+	size_t peak_bytes = 0;
+};
+
+// 有内存上限的纹理图块缓存: 图块在首次访问时从磁盘读取, 超过上限时按 LRU 淘汰
+// 缓存分为多个分片, 每个分片一把锁; 每个线程另外记住最近用过的几个图块, 连续访问同一图块时不加锁
+class texture_cache {
+public:
+	static const uint32_t invalid_image = 0xFFFFFFFF;
+
+	static texture_cache& instance();
+
+	// 打开纹理并返回图像编号, 同一路径只打开一次; .ppm / .pfm 源图像先转换为同目录下的 <path>.rttex
+	// 只能在渲染开始前调用 (场景加载时), 渲染期间只读
+	uint32_t open(const std::string& path);
+
+	// 把 .ppm / .pfm 转换为 .rttex
+	static bool make_texture(const std::string& source, const std::string& path, int tile_size = 64);
+
+	void set_budget(size_t bytes);
+	size_t get_budget() const { return budget; }
+
+	size_t image_count() const { return images.size(); }
+	int width(uint32_t image, int level = 0) const;
+	int height(uint32_t image, int level = 0) const;
+	int levels(uint32_t image) const { return images[image]->header.levels; }
+
+	// 三线性过滤, 按重复方式寻址; v = 0 为图像底部, lod 为 mip 层级 (可为小数, 超出范围时截断)
+	color sample(uint32_t image, double u, double v, double lod);
+
+	texture_cache_stats stats() const;
+
+private:
+	struct image_file {
+		std::string path;
+		texture_file_header header;
+		std::vector<uint64_t> level_first_tile;	// 各层第一个图块的序号
+		std::mutex file_mutex;
+		std::ifstream file;
+	};
+
+	struct tile {
+		std::vector<unsigned char> texels;
+	};
+
+	struct shard {
+		mutable std::mutex mutex;
+		std::list<uint64_t> lru;	// 最近使用的在前
+		std::unordered_map<uint64_t, std::pair<std::shared_ptr<const tile>, std::list<uint64_t>::iterator>> tiles;
+		size_t bytes = 0;
+		uint64_t hits = 0;
+	};
+
+	static const int shard_count = 16;
+
+	texture_cache();
+
+	color texel(uint32_t image, int level, int x, int y);
+	color bilinear(uint32_t image, int level, double u, double v);
+	const tile* fetch(uint32_t image, int level, int tile_x, int tile_y);
+	std::shared_ptr<const tile> load(image_file& img, int level, int tile_x, int tile_y);
+
+private:
+	std::vector<std::unique_ptr<image_file>> images;
+	std::unordered_map<std::string, uint32_t> image_ids;
+	shard shards[shard_count];
+	size_t budget;
+	std::atomic<uint64_t> misses;
+	std::atomic<uint64_t> evictions;
+	std::atomic<size_t> resident;
+	std::atomic<size_t> peak;
+	float decode[256];	// 8 位纹素到线性值
+};
+
+#endif // !TEXTURE_CACHE_H
@@ -65,11 +65,11 @@ namespace mt {
 
 				while (!m_pThreadPool->m_bShutdown) {
 					{
+						// 入队与检查都在 m_Mutex 下进行, 避免丢失唤醒
 						std::unique_lock lock(m_pThreadPool->m_Mutex);
-
-						if (m_pThreadPool->m_Tasks.empty()) {
-							m_pThreadPool->m_Condition.wait(lock);
-						}
+						m_pThreadPool->m_Condition.wait(lock, [this]() {
+							return m_pThreadPool->m_bShutdown || !m_pThreadPool->m_Tasks.empty();
+						});
 
 						dequeued = m_pThreadPool->m_Tasks.Dequeue(func);
 					}
@@ -99,6 +99,7 @@ namespace mt {
 				return;
 			}
 
+			m_bShutdown = false;
 			for (int i = 0; i < m_Threads.size(); ++i) {
 				m_Threads.at(i) = std::thread(ThreadWorker(this, i));
 			}
@@ -106,7 +107,10 @@ namespace mt {
 		}
 
 		void Shutdown() {
-			m_bShutdown = true;
+			{
+				std::unique_lock lock(m_Mutex);
+				m_bShutdown = true;
+			}
 			m_Condition.notify_all();
 
 			for (int i = 0; i < m_Threads.size(); ++i) {
@@ -117,6 +121,8 @@ namespace mt {
 			is_initialized = false;
 		}
 
+		int GetThreadCount() const { return static_cast<int>(m_Threads.size()); }
+
 		template <typename Func, typename... Args>
 		auto Commit(Func&& func, Args&&... args)
 			-> std::future<decltype(std::invoke(std::forward<Func>(func), std::forward<Args>(args)...))>
@@ -134,7 +140,10 @@ namespace mt {
 				(*task)();
 				};
 
-			m_Tasks.Enqueue(newTask);
+			{
+				std::unique_lock lock(m_Mutex);
+				m_Tasks.Enqueue(newTask);
+			}
 			m_Condition.notify_one();
 			return task->get_future();
 		}
@@ -147,7 +156,7 @@ namespace mt {
 		std::mutex m_Mutex;
 		std::condition_variable m_Condition;
 
-		bool m_bShutdown;
+		std::atomic<bool> m_bShutdown;
 
 	};
 };
@@ -0,0 +1,66 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <cstdint>
+#include <string>
+
+// 渲染阶段时间线, 导出为 Chrome trace JSON (chrome://tracing 或 Perfetto 打开)
+// 每个线程写自己的环形缓冲, 记录时不加锁; 缓冲写满后覆盖最旧的事件
+// 定义 RENDER_TRACE_ENABLED 时才会记录, 运行时还需调用 trace_begin() 打开
+
+struct trace_event {
+	const char* name;	// 必须是字符串常量
+	int64_t start;		// 微秒, 相对 trace_begin()
+	int64_t duration;
+	int64_t arg;		// 可选参数 (如行号), < 0 表示没有
+};
+
+// 清空已有事件并开始记录; 调用时不应有线程在记录
+void trace_begin(size_t events_per_thread = 1 << 16);
+void trace_end();
+bool trace_enabled();
+
+// 给当前线程命名, 显示在时间线的线程标题上
+void trace_thread_name(const char* name);
+
+// 把所有线程的事件写成 Chrome trace JSON; 调用时不应有线程在记录
+bool write_chrome_trace(const std::string& path);
+
+void trace_record(const char* name, int64_t start, int64_t duration, int64_t arg);
+int64_t trace_now();
+
+// 作用域计时: 构造时记下开始时间, 析构时写入当前线程的缓冲
+class trace_zone {
+public:
+	explicit trace_zone(const char* name, int64_t arg = -1)
+		: name(trace_enabled() ? name : nullptr), arg(arg), start(this->name ? trace_now() : 0) {}
+	~trace_zone() {
+		if (name) trace_record(name, start, trace_now() - start, arg);
+	}
+
+	trace_zone(const trace_zone&) = delete;
+	trace_zone& operator=(const trace_zone&) = delete;
+
+private:
+	const char* name;
+	int64_t arg;
+	int64_t start;
+};
+
+#ifdef RENDER_TRACE_ENABLED
+
+#define RT_TRACE_CONCAT_INNER(a, b) a##b
+#define RT_TRACE_CONCAT(a, b) RT_TRACE_CONCAT_INNER(a, b)
+#define RT_TRACE_ZONE(name) trace_zone RT_TRACE_CONCAT(trace_zone_, __LINE__)(name)
+#define RT_TRACE_ZONE_ARG(name, arg) trace_zone RT_TRACE_CONCAT(trace_zone_, __LINE__)(name, arg)
+#define RT_TRACE_THREAD_NAME(name) trace_thread_name(name)
+
+#else
+
+#define RT_TRACE_ZONE(name) ((void)0)
+#define RT_TRACE_ZONE_ARG(name, arg) ((void)0)
+#define RT_TRACE_THREAD_NAME(name) ((void)0)
+
+#endif // RENDER_TRACE_ENABLED
+
+#endif // !TRACE_H
@@ -0,0 +1,48 @@
+#ifndef TRANSFORM_H
+#define TRANSFORM_H
+
+#include "rtweekend.h"
+#include "aabb.h"
+
+// 仿射变换, 以 3x4 矩阵保存 (线性部分 + 平移)
+class transform {
+public:
+	transform();
+
+	static transform translate(const vec3& offset);
+	static transform scale(const vec3& factor);
+	static transform rotate(const vec3& axis, double degrees);
+
+	// 先应用 other, 再应用 *this
+	transform operator*(const transform& other) const;
+	transform inverse() const;
+
+	inline point3 point(const point3& p) const {
+		return point3(
+			m[0][0] * p.e[0] + m[0][1] * p.e[1] + m[0][2] * p.e[2] + m[0][3],
+			m[1][0] * p.e[0] + m[1][1] * p.e[1] + m[1][2] * p.e[2] + m[1][3],
+			m[2][0] * p.e[0] + m[2][1] * p.e[1] + m[2][2] * p.e[2] + m[2][3]);
+	}
+
+	inline vec3 vector(const vec3& v) const {
+		return vec3(
+			m[0][0] * v.e[0] + m[0][1] * v.e[1] + m[0][2] * v.e[2],
+			m[1][0] * v.e[0] + m[1][1] * v.e[1] + m[1][2] * v.e[2],
+			m[2][0] * v.e[0] + m[2][1] * v.e[1] + m[2][2] * v.e[2]);
+	}
+
+	// 乘以线性部分的转置; 对逆变换调用即可把法线变回原空间
+	inline vec3 transposed_vector(const vec3& v) const {
+		return vec3(
+			m[0][0] * v.e[0] + m[1][0] * v.e[1] + m[2][0] * v.e[2],
+			m[0][1] * v.e[0] + m[1][1] * v.e[1] + m[2][1] * v.e[2],
+			m[0][2] * v.e[0] + m[1][2] * v.e[1] + m[2][2] * v.e[2]);
+	}
+
+	aabb box(const aabb& b) const;
+
+public:
+	double m[3][4];
+};
+
+#endif // !TRANSFORM_H
@@ -0,0 +1,34 @@
+#ifndef TRIANGLE_MESH_H
+#define TRIANGLE_MESH_H
+
+#include "hittable.h"
+#include "bvh.h"
+
+#include <vector>
+#include <cstdint>
+
+// 带索引的三角网格: 顶点共享一份 float 缓冲区, 每个三角形只保存 3 个索引
+class triangle_mesh : public hittable {
+public:
+	triangle_mesh(std::vector<float> positions, std::vector<uint32_t> indices, shared_ptr<material> mat);
+
+	virtual bool hit(const ray& r, double t_min, double t_max, hit_record& rec) const override;
+	virtual bool bounding_box(aabb& output_box) const override;
+
+	size_t vertex_count() const { return positions.size() / 3; }
+	size_t triangle_count() const { return indices.size() / 3; }
+
+private:
+	point3 vertex(uint32_t index) const {
+		const float* p = &positions[3 * size_t(index)];
+		return point3(p[0], p[1], p[2]);
+	}
+
+private:
+	std::vector<float> positions;	// xyz
+	std::vector<uint32_t> indices;	// 每个三角形 3 个, 按 BVH 叶子顺序排列
+	std::vector<bvh_node> nodes;
+	shared_ptr<material> mat_ptr;
+};
+
+#endif // !TRIANGLE_MESH_H
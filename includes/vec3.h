@@ -4,8 +4,10 @@
 #include <cmath>
 #include <iostream>
 
+#include "random.h"
+
 inline double random_double() {
-	return rand() / (RAND_MAX + 1.0);
+	return random_u32() * (1.0 / 4294967296.0);
 }
 
 inline double random_double(double min, double max) {
@@ -97,16 +99,64 @@ inline vec3 unit_vector(const vec3 &v) {
 	return v / v.length();
 }
 
-inline vec3 random_in_unit_sphere() {
-	while (true) {
-		auto p = vec3::random(-1, 1);
-		if (p.length_squared() > 1) continue;
-		return p;
+// ӳ [0, 1)^2 ϵľ任Ŀֲ, ÿǡʹ, ûоܾѭ,
+// ֱӴֲͲ
+
+// λԲϾȷֲ, ͬӳ (Shirley & Chiu 1997): ӳȻ, ֲ
+inline vec3 sample_unit_disk(double u1, double u2) {
+	const double quarter_pi = 0.78539816339744830962;
+	double a = 2.0 * u1 - 1.0;
+	double b = 2.0 * u2 - 1.0;
+	if (a == 0.0 && b == 0.0) return vec3(0, 0, 0);
+
+	double r, theta;
+	if (std::abs(a) > std::abs(b)) {
+		r = a;
+		theta = quarter_pi * (b / a);
 	}
+	else {
+		r = b;
+		theta = 2.0 * quarter_pi - quarter_pi * (a / b);
+	}
+	return vec3(r * std::cos(theta), r * std::sin(theta), 0);
+}
+
+// λϾȷֲ: z ȷֲ (׵¶), λǾȷֲ
+inline vec3 sample_unit_sphere(double u1, double u2) {
+	const double two_pi = 6.28318530717958647693;
+	double z = 1.0 - 2.0 * u1;
+	double r = std::sqrt(std::fmax(0.0, 1.0 - z * z));
+	double phi = two_pi * u2;
+	return vec3(r * std::cos(phi), r * std::sin(phi), z);
+}
+
+//  +z ΪĵҼȨ, pdf = cos(theta) / pi: ԲϵľȵͶӰ (Malley )
+inline vec3 sample_cosine_hemisphere(double u1, double u2) {
+	vec3 d = sample_unit_disk(u1, u2);
+	double z = std::sqrt(std::fmax(0.0, 1.0 - d.e[0] * d.e[0] - d.e[1] * d.e[1]));
+	return vec3(d.e[0], d.e[1], z);
+}
+
+//  +z ΪĵľȰ, pdf = 1 / (2 pi)
+inline vec3 sample_uniform_hemisphere(double u1, double u2) {
+	const double two_pi = 6.28318530717958647693;
+	double z = u1;
+	double r = std::sqrt(std::fmax(0.0, 1.0 - z * z));
+	double phi = two_pi * u2;
+	return vec3(r * std::cos(phi), r * std::sin(phi), z);
+}
+
+// λھȷֲ: Ҫ뾶
+inline vec3 random_in_unit_sphere() {
+	double u1 = random_double();
+	double u2 = random_double();
+	return std::cbrt(random_double()) * sample_unit_sphere(u1, u2);
 }
 
 inline vec3 random_unit_vector() {
-	return unit_vector(random_in_unit_sphere());
+	double u1 = random_double();
+	double u2 = random_double();
+	return sample_unit_sphere(u1, u2);
 }
 
 inline vec3 random_in_hemisphere(const vec3& normal) {
@@ -131,11 +181,9 @@ inline vec3 refract(const vec3& uv, const vec3& n, double etai_over_etat) {
 
 //һλСԲ
 inline vec3 random_in_unit_disk() {
-	while (true) {
-		auto p = vec3(random_double(-1, 1), random_double(-1, 1), 0);
-		if (p.length_squared() >= 1) continue;
-		return p;
-	}
+	double u1 = random_double();
+	double u2 = random_double();
+	return sample_unit_disk(u1, u2);
 }
 
 #endif // !VEC3_H
@@ -3,8 +3,18 @@
 #endif
 
 #include "renderer.h"
+#include "trace.h"
+#include "partial_render.h"
+#include "texture_cache.h"
+#include "sampling_benchmark.h"
+#include "sphere_set_check.h"
+#include "material_check.h"
+#include "sphere_check.h"
 
-int main()
+#include <climits>
+#include <cstdlib>
+
+int main(int argc, char** argv)
 {
 	/**
 	 0 . . . object_count
@@ -14,20 +24,266 @@ int main()
 	 object_count
 	 */
 	int object_count = 3;		// ȾΪ object_count * object_count
+
+	// : RayTracer [scene] [--output image] [--width W] [--height H]
+	//                  [--checkpoint file] [--checkpoint-interval seconds] [--resume]
+	//                  [--stats file.json] [--trace file.json]
+	//                  [--coordinator port] [--worker host:port] [--worker-timeout seconds]
+	//                  [--samples first:end] [--accelerator bvh|grid] [--frames first:last]
+	//                  [--spp N] [--denoise] [--aov]
+	//                  [--filter box|tent|gaussian|mitchell|blackman-harris[:radius]]
+	//                  [--aspect W/H] [--region x0,y0,x1,y1] [--texture-cache MB]
+	//         RayTracer --benchmark-accelerators [--width W] [--height H]
+	//         RayTracer --benchmark-sampling
+	//         RayTracer --check-sphere-edits
+	//         RayTracer --check-materials
+	//         RayTracer --check-sphere-kernels
+	//         RayTracer --merge output part.rtpart [part.rtpart ...]
+	//         RayTracer --make-texture image.ppm|image.pfm output.rttex
+	std::string scene_path;
+	std::string output_path;
+	std::string checkpoint_path;
+	double checkpoint_interval = 60.0;
+	bool resume = false;
+	std::string stats_path;
+	std::string trace_path;
+	int first_sample = -1;
+	int end_sample = -1;
+	std::vector<std::string> merge_paths;
+	int coordinator_port = 0;
+	std::string worker_address;
+	double worker_timeout = 600.0;
+	std::string accelerator;
+	bool benchmark_accelerators = false;
+	bool benchmark_samplers = false;
+	bool check_sphere_edits = false;
+	bool check_material_sampling = false;
+	bool check_kernels = false;
+	int first_frame = -1;
+	int last_frame = -1;
+	int samples_per_pixel = 0;
+	bool denoise = false;
+	bool write_aovs = false;
+	std::string filter;
+	double aspect = 0.0;
+	int region[4] = { 0, 0, 0, 0 };
+	int texture_cache_mb = 0;
+	std::string texture_source;
+	int width = 1200;
+	int height = 675;
+	bool size_ok = true;
+
+	// ͼߴ: ǲС 2  (trace_sample  width - 1  height - 1 һ)
+	auto parse_size = [&](const char* option, const char* text, int& value) {
+		char* end = nullptr;
+		long parsed = strtol(text, &end, 10);
+		if (end == text || *end != '\0' || parsed < 2 || parsed > INT_MAX) {
+			std::cout << "Invalid " << option << " " << text << ": expected an integer >= 2" << std::endl;
+			size_ok = false;
+			return;
+		}
+		value = (int)parsed;
+	};
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg == "--output" && i + 1 < argc) output_path = argv[++i];
+		else if (arg == "--width" && i + 1 < argc) parse_size("--width", argv[++i], width);
+		else if (arg == "--height" && i + 1 < argc) parse_size("--height", argv[++i], height);
+		else if (arg == "--checkpoint" && i + 1 < argc) checkpoint_path = argv[++i];
+		else if (arg == "--checkpoint-interval" && i + 1 < argc) checkpoint_interval = atof(argv[++i]);
+		else if (arg == "--resume") resume = true;
+		else if (arg == "--stats" && i + 1 < argc) stats_path = argv[++i];
+		else if (arg == "--trace" && i + 1 < argc) trace_path = argv[++i];
+		else if (arg == "--coordinator" && i + 1 < argc) coordinator_port = atoi(argv[++i]);
+		else if (arg == "--worker" && i + 1 < argc) worker_address = argv[++i];
+		else if (arg == "--worker-timeout" && i + 1 < argc) worker_timeout = atof(argv[++i]);
+		else if (arg == "--accelerator" && i + 1 < argc) accelerator = argv[++i];
+		else if (arg == "--benchmark-accelerators") benchmark_accelerators = true;
+		else if (arg == "--benchmark-sampling") benchmark_samplers = true;
+		else if (arg == "--check-sphere-edits") check_sphere_edits = true;
+		else if (arg == "--check-materials") check_material_sampling = true;
+		else if (arg == "--check-sphere-kernels") check_kernels = true;
+		else if (arg == "--spp" && i + 1 < argc) samples_per_pixel = atoi(argv[++i]);
+		else if (arg == "--denoise") denoise = true;
+		else if (arg == "--aov") write_aovs = denoise = true;
+		else if (arg == "--filter" && i + 1 < argc) filter = argv[++i];
+		else if (arg == "--aspect" && i + 1 < argc) {
+			// д 2.39  21/9
+			const char* ratio = argv[++i];
+			const char* slash = strchr(ratio, '/');
+			aspect = slash ? atof(ratio) / atof(slash + 1) : atof(ratio);
+		}
+		else if (arg == "--region" && i + 1 < argc) {
+			sscanf(argv[++i], "%d,%d,%d,%d", &region[0], &region[1], &region[2], &region[3]);
+		}
+		else if (arg == "--texture-cache" && i + 1 < argc) texture_cache_mb = atoi(argv[++i]);
+		else if (arg == "--make-texture" && i + 2 < argc) {
+			texture_source = argv[++i];
+			output_path = argv[++i];
+		}
+		else if (arg == "--samples" && i + 1 < argc) {
+			const char* range = argv[++i];
+			const char* colon = strchr(range, ':');
+			first_sample = atoi(range);
+			end_sample = colon ? atoi(colon + 1) : first_sample + 1;
+		}
+		else if (arg == "--frames" && i + 1 < argc) {
+			const char* range = argv[++i];
+			const char* colon = strchr(range, ':');
+			first_frame = atoi(range);
+			last_frame = colon ? atoi(colon + 1) : first_frame;
+		}
+		else if (arg == "--merge" && i + 2 < argc) {
+			// ֮Ĳȫ·벿ֽ
+			output_path = argv[++i];
+			while (i + 1 < argc) merge_paths.push_back(argv[++i]);
+		}
+		else scene_path = arg;
+	}
+
+	// ߱ʱȼ߶
+	if (aspect > 0.0) {
+		height = int(width / aspect + 0.5);
+		if (height < 2) {
+			std::cout << "Aspect ratio " << aspect << " gives a height below 2 pixels" << std::endl;
+			size_ok = false;
+		}
+	}
+	if (!size_ok) {
+		return 1;
+	}
+
+	// ѡ: ¼׶εʱ (ĬϳĹ), ʱ Chrome trace
+	if (!trace_path.empty()) {
+		trace_begin();
+		RT_TRACE_THREAD_NAME("main");
+	}
+
+	// ĺʱֲ, Ҫ
+	if (benchmark_samplers) {
+		return benchmark_sampling(4000000) ? 0 : 1;
+	}
+
+	// ̬༭Ļع, Ҫ
+	if (check_sphere_edits) {
+		return check_sphere_set_edits() ? 0 : 1;
+	}
+
+	//  sample  eval/pdf һԼ, Ҫ
+	if (check_material_sampling) {
+		return check_materials(1000000) ? 0 : 1;
+	}
+
+	// ں֪ıȽ, Ҫ
+	if (check_kernels) {
+		return check_sphere_kernels(1000000) ? 0 : 1;
+	}
+
+	// ԤȰԴͼתΪֿ mip-map , Ҫ
+	if (!texture_source.empty()) {
+		return texture_cache::make_texture(texture_source, output_path) ? 0 : 1;
+	}
+	if (texture_cache_mb > 0) {
+		texture_cache::instance().set_budget(size_t(texture_cache_mb) << 20);
+	}
+
+	// ϲĲֽ, Ҫ
+	if (!merge_paths.empty()) {
+		partial_info info;
+		partial_buffer merged;
+		if (!merge_partials(merge_paths, info, merged)) {
+			return 1;
+		}
+		if (is_partial_path(output_path)) {
+			return save_partial(output_path, info, merged) ? 0 : 1;
+		}
+		framebuffer result;
+		merged.resolve(result);
+		return write_image(output_path, result) ? 0 : 1;
+	}
+
 	renderer* ray_tracer = new renderer(object_count);
+	// ޴ģʽĽ˳, űȾũжʧ
+	bool ok = true;
+	ray_tracer->set_stats_path(stats_path);
+	if (accelerator == "grid") {
+		ray_tracer->set_accelerator(sphere_accelerator::grid);
+	}
 	try
 	{
+		// ѡ: ӳļ (.rtbin ıʽ)
+		if (!scene_path.empty() && !ray_tracer->load_scene(scene_path)) {
+			std::cout << "Failed to load scene: " << scene_path << std::endl;
+			delete(ray_tracer);
+			return 1;
+		}
+		if (samples_per_pixel > 0) {
+			ray_tracer->set_samples_per_pixel(samples_per_pixel);
+		}
+		ray_tracer->set_resolution(width, height);
+		ray_tracer->set_region(region[0], region[1], region[2], region[3]);
+		if (!filter.empty()) {
+			reconstruction_filter f;
+			if (reconstruction_filter::parse(filter, f)) {
+				ray_tracer->set_filter(f);
+			}
+			else {
+				std::cout << "Unknown filter: " << filter << std::endl;
+			}
+		}
+
+		if (benchmark_accelerators) {
+			// ÿֹģȾ 16 spp
+			ray_tracer->benchmark_accelerators({ 11, 50, 200 }, width, height, 16);
+		}
+		else if (!worker_address.empty()) {
+			// : Э·
+			size_t colon = worker_address.rfind(':');
+			std::string host = colon == std::string::npos ? worker_address : worker_address.substr(0, colon);
+			int port = colon == std::string::npos ? 7878 : atoi(worker_address.c_str() + colon + 1);
+			ok = ray_tracer->run_worker(host, (uint16_t)port);
+		}
+		else if (!output_path.empty() && coordinator_port > 0) {
+			ok = ray_tracer->run_coordinator((uint16_t)coordinator_port, output_path, width, height, scene_path, worker_timeout);
+		}
+		else if (!output_path.empty() && end_sample > 0) {
+			// ģʽ, ڰһ֡зֵ̨
+			ok = ray_tracer->render_sample_range(output_path, width, height, first_sample, end_sample);
+		}
+		else if (!output_path.empty() && last_frame >= 0) {
+			// ֡ģʽ: output Ϊļģ,  frames/shot_%04d.png
+			ok = ray_tracer->render_sequence(output_path, width, height, first_frame, last_frame);
+		}
+		else if (!output_path.empty() && denoise) {
+			// ģʽ: ͲȾ֡,  --spp 16 --denoise
+			ok = ray_tracer->render_denoised(output_path, width, height, write_aovs);
+		}
+		else if (!output_path.empty() && !checkpoint_path.empty()) {
+			// ޴ڽģʽ: д, ɴӼָ
+			ok = ray_tracer->render_progressive(output_path, width, height, checkpoint_path, resume, checkpoint_interval);
+		}
+		else if (!output_path.empty()) {
+			// ޴ģʽ: Ⱦд
+			ok = ray_tracer->render_to_file(output_path, width, height);
+		}
+		else {
+			ray_tracer->init();
+			ray_tracer->render();
+			ray_tracer->close();
+		}
 
-		ray_tracer->init();
-		ray_tracer->render();
-		ray_tracer->close();
+		if (!trace_path.empty()) {
+			trace_end();
+			write_chrome_trace(trace_path);
+		}
 		delete(ray_tracer);
 	}
 	catch (std::exception e)
 	{
 		std::cout << e.what() << std::endl;
+		ok = false;
 	}
 
 
-	return 0;
+	return ok ? 0 : 1;
 }
\ No newline at end of file
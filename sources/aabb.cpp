@@ -0,0 +1,22 @@
+#include "aabb.h"
+
+aabb::aabb() : minimum(infinity, infinity, infinity), maximum(-infinity, -infinity, -infinity) {}
+aabb::aabb(const point3& a, const point3& b) : minimum(a), maximum(b) {}
+
+double aabb::surface_area() const {
+	vec3 d = maximum - minimum;
+	if (d.x() < 0 || d.y() < 0 || d.z() < 0) return 0.0;
+	return 2.0 * (d.x() * d.y() + d.y() * d.z() + d.z() * d.x());
+}
+
+int aabb::longest_axis() const {
+	vec3 d = maximum - minimum;
+	if (d.x() > d.y() && d.x() > d.z()) return 0;
+	return d.y() > d.z() ? 1 : 2;
+}
+
+aabb surrounding_box(const aabb& box0, const aabb& box1) {
+	aabb box = box0;
+	box.expand(box1);
+	return box;
+}
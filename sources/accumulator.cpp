@@ -0,0 +1,168 @@
+#include "accumulator.h"
+#include "File.hpp"
+#include "trace.h"
+
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+namespace {
+	const char checkpoint_magic[8] = { 'R', 'T', 'C', 'K', 'P', 'T', '\0', '\0' };
+	const uint32_t checkpoint_version = 3;
+	const uint32_t checkpoint_endian_tag = 0x01020304;
+
+	struct checkpoint_header {
+		char magic[8];
+		uint32_t version;
+		uint32_t endian;
+		checkpoint_info info;
+	};
+}
+
+accumulation_buffer::accumulation_buffer() : w(0), h(0), use_weights(false) {}
+
+accumulation_buffer::accumulation_buffer(int width, int height) : w(0), h(0), use_weights(false) {
+	resize(width, height);
+}
+
+void accumulation_buffer::resize(int width, int height) {
+	w = width;
+	h = height;
+	sums.assign(size_t(width) * height * 3, 0.0);
+	counts.assign(size_t(width) * height, 0u);
+	if (use_weights) {
+		weights.assign(size_t(width) * height, 0.0);
+	}
+}
+
+void accumulation_buffer::clear() {
+	std::fill(sums.begin(), sums.end(), 0.0);
+	std::fill(counts.begin(), counts.end(), 0u);
+	std::fill(weights.begin(), weights.end(), 0.0);
+}
+
+void accumulation_buffer::set_weighted(bool enable) {
+	use_weights = enable;
+	if (!enable) {
+		weights.clear();
+		weights.shrink_to_fit();
+		return;
+	}
+	// 已有的样本按盒式滤波计入权重
+	weights.resize(counts.size());
+	for (size_t i = 0; i < counts.size(); i++) {
+		weights[i] = counts[i];
+	}
+}
+
+void accumulation_buffer::add_rows(const accumulation_buffer& other, int src_row, int dst_row, int row_count) {
+	const size_t src = size_t(src_row) * w;
+	const size_t dst = size_t(dst_row) * w;
+	const size_t count = size_t(row_count) * w;
+	for (size_t i = 0; i < 3 * count; i++) {
+		sums[3 * dst + i] += other.sums[3 * src + i];
+	}
+	for (size_t i = 0; i < count; i++) {
+		counts[dst + i] += other.counts[src + i];
+	}
+	if (use_weights) {
+		for (size_t i = 0; i < count; i++) {
+			weights[dst + i] += other.use_weights ? other.weights[src + i] : other.counts[src + i];
+		}
+	}
+}
+
+void accumulation_buffer::resolve(framebuffer& fb) const {
+	if (fb.width() != w || fb.height() != h) {
+		fb.resize(w, h);
+	}
+	resolve(fb, 0, 0, w, h);
+}
+
+void accumulation_buffer::resolve(framebuffer& fb, int x0, int y0, int x1, int y1) const {
+	for (int y = y0; y < y1; y++) {
+		float* out = fb.row(y) + 3 * x0;
+		for (int x = x0; x < x1; x++) {
+			size_t index = size_t(y) * w + x;
+			// Mitchell 等带负旁瓣的滤波器在样本极少时权重之和可能不为正
+			double weight = use_weights ? weights[index] : counts[index];
+			double scale = weight > 0.0 ? 1.0 / weight : 0.0;
+			*out++ = static_cast<float>(sums[3 * index + 0] * scale);
+			*out++ = static_cast<float>(sums[3 * index + 1] * scale);
+			*out++ = static_cast<float>(sums[3 * index + 2] * scale);
+		}
+	}
+}
+
+bool save_checkpoint(const std::string& path, const checkpoint_info& info, const accumulation_buffer& accum) {
+	RT_TRACE_ZONE("checkpoint write");
+	checkpoint_header header = {};
+	std::memcpy(header.magic, checkpoint_magic, sizeof(checkpoint_magic));
+	header.version = checkpoint_version;
+	header.endian = checkpoint_endian_tag;
+	header.info = info;
+	header.info.weighted = accum.weighted() ? 1 : 0;
+
+	const std::string temp_path = path + ".tmp";
+	File file(temp_path);
+	const auto& sums = accum.sum_data();
+	const auto& counts = accum.count_data();
+	const auto& weights = accum.weight_data();
+	if (!file.WriteBytes((const char*)&header, sizeof(header), std::ios::binary | std::ios::trunc) ||
+		!file.WriteBytes((const char*)sums.data(), sums.size() * sizeof(double), std::ios::binary | std::ios::app) ||
+		!file.WriteBytes((const char*)counts.data(), counts.size() * sizeof(uint32_t), std::ios::binary | std::ios::app) ||
+		(header.info.weighted && !file.WriteBytes((const char*)weights.data(), weights.size() * sizeof(double), std::ios::binary | std::ios::app))) {
+		std::cout << "Failed to write checkpoint: " << temp_path << std::endl;
+		return false;
+	}
+
+	// Windows 上 rename 不会覆盖已存在的文件
+	std::remove(path.c_str());
+	if (std::rename(temp_path.c_str(), path.c_str()) != 0) {
+		std::cout << "Failed to replace checkpoint: " << path << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+bool load_checkpoint(const std::string& path, checkpoint_info& info, accumulation_buffer& accum) {
+	MappedFile file(path);
+	if (!file.Map()) {
+		std::cout << "Failed to map checkpoint: " << path << std::endl;
+		return false;
+	}
+
+	checkpoint_header header;
+	if (file.GetSize() < sizeof(header)) {
+		std::cout << "Checkpoint is truncated: " << path << std::endl;
+		return false;
+	}
+	std::memcpy(&header, file.GetData(), sizeof(header));
+
+	if (std::memcmp(header.magic, checkpoint_magic, sizeof(checkpoint_magic)) != 0 ||
+		header.version != checkpoint_version || header.endian != checkpoint_endian_tag) {
+		std::cout << "Unsupported checkpoint: " << path << std::endl;
+		return false;
+	}
+
+	const checkpoint_info& stored = header.info;
+	size_t pixel_count = size_t(stored.width) * stored.height;
+	size_t sums_size = pixel_count * 3 * sizeof(double);
+	size_t counts_size = pixel_count * sizeof(uint32_t);
+	size_t weights_size = stored.weighted ? pixel_count * sizeof(double) : 0;
+	if (stored.width <= 0 || stored.height <= 0 || file.GetSize() < sizeof(header) + sums_size + counts_size + weights_size) {
+		std::cout << "Checkpoint is truncated: " << path << std::endl;
+		return false;
+	}
+
+	accum.set_weighted(stored.weighted != 0);
+	accum.resize(stored.width, stored.height);
+	std::memcpy(accum.sum_data().data(), file.GetData() + sizeof(header), sums_size);
+	std::memcpy(accum.count_data().data(), file.GetData() + sizeof(header) + sums_size, counts_size);
+	if (stored.weighted) {
+		std::memcpy(accum.weight_data().data(), file.GetData() + sizeof(header) + sums_size + counts_size, weights_size);
+	}
+	info = stored;
+	return true;
+}
@@ -0,0 +1,189 @@
+#include "bvh.h"
+#include "trace.h"
+
+#include <algorithm>
+
+namespace {
+	struct build_item {
+		aabb box;
+		point3 centroid;
+		uint32_t index;
+	};
+
+	const size_t max_leaf_size = 4;
+	const size_t max_leaf_count = 0xFFFF;
+	const int bin_count = 16;
+
+	// SAH 深度超过该值后改为中位数划分, 保证遍历栈不会溢出
+	const int sah_depth_limit = 32;
+
+	bool find_sah_split(std::vector<build_item>& items, size_t begin, size_t end,
+		const aabb& bounds, const aabb& centroid_bounds, int& split_axis, size_t& mid) {
+		struct bin {
+			aabb box;
+			size_t count = 0;
+		};
+
+		const size_t count = end - begin;
+		double best_cost = static_cast<double>(count) * bounds.surface_area();
+		int best_axis = -1;
+		double best_split = 0.0;
+
+		for (int axis = 0; axis < 3; axis++) {
+			double lo = centroid_bounds.minimum.e[axis];
+			double extent = centroid_bounds.maximum.e[axis] - lo;
+			if (extent <= 0.0) continue;
+
+			bin bins[bin_count];
+			double scale = bin_count / extent;
+			for (size_t i = begin; i < end; i++) {
+				int b = std::min(bin_count - 1, static_cast<int>((items[i].centroid.e[axis] - lo) * scale));
+				bins[b].count++;
+				bins[b].box.expand(items[i].box);
+			}
+
+			// 从右向左累积右侧包围盒面积
+			double right_area[bin_count];
+			size_t right_count[bin_count];
+			aabb right_box;
+			size_t right_total = 0;
+			for (int b = bin_count - 1; b > 0; b--) {
+				right_box.expand(bins[b].box);
+				right_total += bins[b].count;
+				right_area[b] = right_box.surface_area();
+				right_count[b] = right_total;
+			}
+
+			aabb left_box;
+			size_t left_total = 0;
+			for (int b = 0; b < bin_count - 1; b++) {
+				left_box.expand(bins[b].box);
+				left_total += bins[b].count;
+				if (left_total == 0 || right_count[b + 1] == 0) continue;
+
+				double cost = left_total * left_box.surface_area() + right_count[b + 1] * right_area[b + 1];
+				if (cost < best_cost) {
+					best_cost = cost;
+					best_axis = axis;
+					best_split = lo + (b + 1) / scale;
+				}
+			}
+		}
+
+		if (best_axis < 0) {
+			return false;
+		}
+
+		auto it = std::partition(items.begin() + begin, items.begin() + end,
+			[=](const build_item& item) { return item.centroid.e[best_axis] < best_split; });
+		mid = static_cast<size_t>(it - items.begin());
+		split_axis = best_axis;
+		return mid != begin && mid != end;
+	}
+
+	void build_recursive(std::vector<build_item>& items, size_t begin, size_t end,
+		std::vector<bvh_node>& nodes, int depth) {
+		aabb bounds, centroid_bounds;
+		for (size_t i = begin; i < end; i++) {
+			bounds.expand(items[i].box);
+			centroid_bounds.expand(items[i].centroid);
+		}
+
+		size_t node_index = nodes.size();
+		nodes.push_back(bvh_node());
+		nodes[node_index].box = bounds;
+
+		const size_t count = end - begin;
+		if (count <= max_leaf_size) {
+			nodes[node_index].offset = static_cast<uint32_t>(begin);
+			nodes[node_index].count = static_cast<uint16_t>(count);
+			nodes[node_index].axis = 0;
+			return;
+		}
+
+		int axis = centroid_bounds.longest_axis();
+		size_t mid = begin;
+		bool split = depth < sah_depth_limit && find_sah_split(items, begin, end, bounds, centroid_bounds, axis, mid);
+
+		if (!split) {
+			// 图元中心全部重合时无法划分, 直接作为叶子; 否则按中位数划分
+			vec3 extent = centroid_bounds.maximum - centroid_bounds.minimum;
+			if (count <= max_leaf_count && extent.x() <= 0.0 && extent.y() <= 0.0 && extent.z() <= 0.0) {
+				nodes[node_index].offset = static_cast<uint32_t>(begin);
+				nodes[node_index].count = static_cast<uint16_t>(count);
+				nodes[node_index].axis = 0;
+				return;
+			}
+
+			axis = centroid_bounds.longest_axis();
+			mid = begin + count / 2;
+			std::nth_element(items.begin() + begin, items.begin() + mid, items.begin() + end,
+				[=](const build_item& a, const build_item& b) { return a.centroid.e[axis] < b.centroid.e[axis]; });
+		}
+
+		build_recursive(items, begin, mid, nodes, depth + 1);
+		nodes[node_index].offset = static_cast<uint32_t>(nodes.size());
+		nodes[node_index].count = 0;
+		nodes[node_index].axis = static_cast<uint16_t>(axis);
+		build_recursive(items, mid, end, nodes, depth + 1);
+	}
+}
+
+void bvh::build(const std::vector<aabb>& boxes, std::vector<bvh_node>& nodes, std::vector<uint32_t>& order) {
+	RT_TRACE_ZONE_ARG("bvh build", (int64_t)boxes.size());
+	nodes.clear();
+	order.clear();
+	if (boxes.empty()) {
+		return;
+	}
+
+	std::vector<build_item> items(boxes.size());
+	for (size_t i = 0; i < boxes.size(); i++) {
+		items[i].box = boxes[i];
+		items[i].centroid = boxes[i].centroid();
+		items[i].index = static_cast<uint32_t>(i);
+	}
+
+	nodes.reserve(2 * boxes.size());
+	build_recursive(items, 0, items.size(), nodes, 0);
+
+	order.resize(items.size());
+	for (size_t i = 0; i < items.size(); i++) {
+		order[i] = items[i].index;
+	}
+}
+
+bool bvh::validate(const bvh_node* nodes, size_t node_count, size_t primitive_count) {
+	if (node_count == 0) {
+		return primitive_count == 0;
+	}
+
+	// refit 会扫描所有节点, 不可达的节点同样需要合法
+	for (size_t i = 0; i < node_count; i++) {
+		const bvh_node& node = nodes[i];
+		if (node.count > 0) {
+			if (uint64_t(node.offset) + node.count > primitive_count) return false;
+		}
+		else if (node.axis > 2 || i + 1 >= node_count || node.offset <= i + 1 || node.offset >= node_count) {
+			return false;
+		}
+	}
+
+	// 孩子下标总是大于父节点, 因此一定是一棵无环的树; 按遍历的方式走一遍, 每个内部节点向栈中压入一项
+	struct entry {
+		uint32_t index;
+		int depth;
+	};
+	std::vector<entry> stack;
+	stack.push_back({ 0, 0 });
+	while (!stack.empty()) {
+		entry e = stack.back();
+		stack.pop_back();
+		const bvh_node& node = nodes[e.index];
+		if (node.count > 0) continue;
+		if (e.depth + 1 > max_depth) return false;
+		stack.push_back({ e.index + 1, e.depth + 1 });
+		stack.push_back({ node.offset, e.depth + 1 });
+	}
+	return true;
+}
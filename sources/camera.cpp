@@ -10,11 +10,12 @@ camera::camera() {
 	horization = vec3(viewport_width, 0, 0);
 	vertical = vec3(0, viewport_height, 0);
 	lower_left_corner = origin - horization / 2 - vertical / 2 - vec3(0, 0, focal_length);
+	time0 = time1 = 0.0;
 
 }
 
 camera::camera(double vfov, double aspect_radio, point3 lookfrom, 
-	point3 lookat, vec3 vup, double aperture, double focus_dist) {
+	point3 lookat, vec3 vup, double aperture, double focus_dist, double time0, double time1) {
 	auto theta = degress_to_radians(vfov);
 	auto half_height = tan(theta / 2);
 	auto half_width = half_height * aspect_radio;
@@ -32,11 +33,28 @@ camera::camera(double vfov, double aspect_radio, point3 lookfrom,
 	lens_radius = aperture / 2.0;
 	horization = 2.0 * half_width * focus_dist * u;
 	vertical = 2.0 * half_height * focus_dist * v;
+
+	// 运动图元只在 [0, 1] 内线性插值, 快门区间限制在其中
+	this->time0 = clamp(time0, 0.0, 1.0);
+	this->time1 = clamp(time1, this->time0, 1.0);
+}
+
+camera::camera(const camera_settings& settings, double aspect_radio)
+	: camera(settings.vfov, aspect_radio, settings.lookfrom, settings.lookat, settings.vup, settings.aperture, settings.focus_dist,
+		settings.shutter_open, settings.shutter_close) {
 }
 
 ray camera::get_ray(double s, double t) const {
 	vec3 rd = lens_radius * random_in_unit_disk();
 	vec3 offset = u * rd.x() + v * rd.y();
 
-	return ray(origin + offset, lower_left_corner + s * horization + t * vertical - origin - offset);
+	// 快门关闭时不消耗随机数, 静止画面的样本序列保持不变
+	double time = time1 > time0 ? random_double(time0, time1) : time0;
+	return ray(origin + offset, lower_left_corner + s * horization + t * vertical - origin - offset, time);
+}
+
+double camera::pixel_spread(int image_height) const {
+	// 视平面位于对焦距离处, 像素高度除以到视平面中心的距离
+	vec3 center = lower_left_corner + 0.5 * horization + 0.5 * vertical - origin;
+	return vertical.length() / (center.length() * image_height);
 }
\ No newline at end of file
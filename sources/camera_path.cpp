@@ -0,0 +1,84 @@
+#include "camera_path.h"
+
+#include <algorithm>
+
+namespace {
+	// 非均匀间隔的 Catmull-Rom: 切线按相邻关键帧的帧距缩放, 关键帧疏密不同时不会过冲
+	vec3 catmull_rom(const std::vector<camera_key>& keys, size_t i, double t, point3 camera_settings::* member) {
+		const size_t last = keys.size() - 1;
+		const size_t prev = i > 0 ? i - 1 : i;
+		const size_t next = i + 1 < last ? i + 2 : last;
+
+		const point3& p0 = keys[prev].settings.*member;
+		const point3& p1 = keys[i].settings.*member;
+		const point3& p2 = keys[i + 1].settings.*member;
+		const point3& p3 = keys[next].settings.*member;
+
+		const double span = keys[i + 1].frame - keys[i].frame;
+		vec3 m1 = (p2 - p0) * (span / (keys[i + 1].frame - keys[prev].frame));
+		vec3 m2 = (p3 - p1) * (span / (keys[next].frame - keys[i].frame));
+
+		// 三次 Hermite 基函数
+		double t2 = t * t;
+		double t3 = t2 * t;
+		return (2 * t3 - 3 * t2 + 1) * p1 + (t3 - 2 * t2 + t) * m1 + (-2 * t3 + 3 * t2) * p2 + (t3 - t2) * m2;
+	}
+
+	inline double lerp(double a, double b, double t) {
+		return a + (b - a) * t;
+	}
+
+	// Rodrigues 公式: v 绕单位轴 axis 旋转 angle 弧度
+	vec3 rotate(const vec3& v, const vec3& axis, double angle) {
+		double c = cos(angle);
+		double s = sin(angle);
+		return v * c + cross(axis, v) * s + axis * (dot(axis, v) * (1 - c));
+	}
+}
+
+void camera_path::add(double frame, const camera_settings& settings) {
+	auto it = std::lower_bound(keys.begin(), keys.end(), frame,
+		[](const camera_key& key, double f) { return key.frame < f; });
+	if (it != keys.end() && it->frame == frame) {
+		it->settings = settings;
+		return;
+	}
+	keys.insert(it, { frame, settings });
+}
+
+camera_settings camera_path::evaluate(double frame) const {
+	if (keys.empty()) return camera_settings();
+	if (frame <= keys.front().frame) return keys.front().settings;
+	if (frame >= keys.back().frame) return keys.back().settings;
+
+	// 找到 keys[i].frame <= frame < keys[i + 1].frame
+	auto it = std::upper_bound(keys.begin(), keys.end(), frame,
+		[](double f, const camera_key& key) { return f < key.frame; });
+	size_t i = size_t(it - keys.begin()) - 1;
+	const camera_settings& a = keys[i].settings;
+	const camera_settings& b = keys[i + 1].settings;
+	double t = (frame - keys[i].frame) / (keys[i + 1].frame - keys[i].frame);
+
+	camera_settings result;
+	result.lookfrom = catmull_rom(keys, i, t, &camera_settings::lookfrom);
+	result.lookat = catmull_rom(keys, i, t, &camera_settings::lookat);
+	result.vup = a.vup + (b.vup - a.vup) * t;
+	result.vfov = lerp(a.vfov, b.vfov, t);
+	result.aperture = lerp(a.aperture, b.aperture, t);
+	result.focus_dist = lerp(a.focus_dist, b.focus_dist, t);
+	result.shutter_open = lerp(a.shutter_open, b.shutter_open, t);
+	result.shutter_close = lerp(a.shutter_close, b.shutter_close, t);
+	return result;
+}
+
+camera_path camera_path::orbit(const camera_settings& base, int frame_count) {
+	camera_path path;
+	vec3 axis = unit_vector(base.vup);
+	vec3 offset = base.lookfrom - base.lookat;
+	for (int frame = 0; frame < frame_count; frame++) {
+		camera_settings settings = base;
+		settings.lookfrom = base.lookat + rotate(offset, axis, 2.0 * pi * frame / frame_count);
+		path.add(frame, settings);
+	}
+	return path;
+}
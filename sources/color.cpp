@@ -12,7 +12,7 @@ void write_color(std::ostream &out, color pixel_color, int samples_per_pixel) {
 
 	out << static_cast<int>(256 * clamp(r, 0.0, 0.999)) << " " 
 		<< static_cast<int>(256 * clamp(g, 0.0, 0.999)) << " "
-		<< static_cast<int>(256 * clamp(b, 0.0, 0.999)) << std::endl;
+		<< static_cast<int>(256 * clamp(b, 0.0, 0.999)) << '\n';
 }
 
 int convert_color(double pixel, int samples_per_pixel) {
@@ -0,0 +1,305 @@
+#include "denoiser.h"
+#include "trace.h"
+
+#include <thread_pool.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <future>
+#include <thread>
+
+namespace {
+	// 反照率低于该值的通道按该值解调, 解调与重新调制使用相同的值, 结果可逆
+	const float min_albedo = 0.01f;
+
+	// B3 样条核 [1/16, 1/4, 3/8, 1/4, 1/16], 按到中心的距离索引
+	const double kernel[3] = { 3.0 / 8.0, 1.0 / 4.0, 1.0 / 16.0 };
+
+	inline double luminance(const float* c) {
+		return 0.2126 * c[0] + 0.7152 * c[1] + 0.0722 * c[2];
+	}
+
+	// 一次迭代的输入或输出: 照度与其亮度方差
+	struct atrous_image {
+		framebuffer irradiance;
+		std::vector<float> variance;
+	};
+
+	struct atrous_pass {
+		const feature_buffers& features;
+		const std::vector<float>& depth_gradient;
+		const denoise_settings& settings;
+		int step;
+	};
+
+	// 方差估计本身噪声很大, 计算亮度权重前先做 3x3 高斯平滑
+	double filtered_variance(const std::vector<float>& variance, int width, int height, int x, int y) {
+		const double gaussian[2] = { 1.0 / 4.0, 1.0 / 8.0 };
+		double sum = 0.0;
+		double weight_sum = 0.0;
+		for (int dy = -1; dy <= 1; dy++) {
+			int qy = y + dy;
+			if (qy < 0 || qy >= height) continue;
+			for (int dx = -1; dx <= 1; dx++) {
+				int qx = x + dx;
+				if (qx < 0 || qx >= width) continue;
+				double w = gaussian[std::abs(dx)] * gaussian[std::abs(dy)];
+				sum += w * variance[size_t(qy) * width + qx];
+				weight_sum += w;
+			}
+		}
+		return sum / weight_sum;
+	}
+
+	void filter_tile(const atrous_pass& pass, const atrous_image& src, atrous_image& dst, int x0, int y0, int x1, int y1) {
+		const feature_buffers& f = pass.features;
+		const denoise_settings& s = pass.settings;
+		const int width = f.width();
+		const int height = f.height();
+
+		for (int y = y0; y < y1; y++) {
+			for (int x = x0; x < x1; x++) {
+				const size_t p = size_t(y) * width + x;
+				const float* cp = src.irradiance.row(y) + 3 * x;
+				const float* np = f.normal.row(y) + 3 * x;
+				const double zp = f.depth[p];
+				const bool sky_p = zp <= 0.0;
+				const double lp = luminance(cp);
+				const double sigma_l = s.sigma_luminance * std::sqrt(std::max(0.0, filtered_variance(src.variance, width, height, x, y))) + 1e-6;
+				const double sigma_z = s.sigma_depth * pass.depth_gradient[p] * pass.step + 1e-6;
+
+				double sum[3] = { 0.0, 0.0, 0.0 };
+				double variance_sum = 0.0;
+				double weight_sum = 0.0;
+				for (int dy = -2; dy <= 2; dy++) {
+					const int qy = y + dy * pass.step;
+					if (qy < 0 || qy >= height) continue;
+					for (int dx = -2; dx <= 2; dx++) {
+						const int qx = x + dx * pass.step;
+						if (qx < 0 || qx >= width) continue;
+
+						const size_t q = size_t(qy) * width + qx;
+						const float* cq = src.irradiance.row(qy) + 3 * qx;
+						double w = kernel[std::abs(dx)] * kernel[std::abs(dy)];
+						if (dx != 0 || dy != 0) {
+							// 背景与物体之间不混合; 背景内部只按亮度加权
+							const double zq = f.depth[q];
+							if (sky_p != (zq <= 0.0)) continue;
+
+							double exponent = std::abs(lp - luminance(cq)) / sigma_l;
+							if (!sky_p) {
+								const float* nq = f.normal.row(qy) + 3 * qx;
+								double cos_n = np[0] * nq[0] + np[1] * nq[1] + np[2] * nq[2];
+								if (cos_n <= 0.0) continue;
+								w *= std::pow(cos_n, s.sigma_normal);
+								exponent += std::abs(zp - zq) / (sigma_z * std::sqrt(double(dx * dx + dy * dy)));
+							}
+							w *= std::exp(-exponent);
+						}
+
+						sum[0] += w * cq[0];
+						sum[1] += w * cq[1];
+						sum[2] += w * cq[2];
+						variance_sum += w * w * src.variance[q];
+						weight_sum += w;
+					}
+				}
+
+				// 中心像素的权重恒为正, weight_sum 不会为 0
+				float* out = dst.irradiance.row(y) + 3 * x;
+				out[0] = static_cast<float>(sum[0] / weight_sum);
+				out[1] = static_cast<float>(sum[1] / weight_sum);
+				out[2] = static_cast<float>(sum[2] / weight_sum);
+				dst.variance[p] = static_cast<float>(variance_sum / (weight_sum * weight_sum));
+			}
+		}
+	}
+
+	// 萤火虫抑制: 像素亮度超过邻域 (同为背景或同为物体) 均值加 firefly_sigma 倍标准差时按比例压低,
+	// 方差同时限制在邻域的最大值, 避免单个高亮样本在之后的迭代中扩散成光斑
+	void clamp_fireflies(const feature_buffers& f, const denoise_settings& s, const atrous_image& src, atrous_image& dst, int y0, int y1) {
+		const int width = f.width();
+		const int height = f.height();
+		const int r = s.firefly_radius;
+		for (int y = y0; y < y1; y++) {
+			for (int x = 0; x < width; x++) {
+				const size_t p = size_t(y) * width + x;
+				const float* cp = src.irradiance.row(y) + 3 * x;
+				float* out = dst.irradiance.row(y) + 3 * x;
+				const bool sky_p = f.depth[p] <= 0.0f;
+
+				double sum = 0.0;
+				double sum_sq = 0.0;
+				float max_variance = 0.0f;
+				int count = 0;
+				for (int qy = std::max(0, y - r); qy <= std::min(height - 1, y + r); qy++) {
+					for (int qx = std::max(0, x - r); qx <= std::min(width - 1, x + r); qx++) {
+						const size_t q = size_t(qy) * width + qx;
+						if (q == p || (f.depth[q] <= 0.0f) != sky_p) continue;
+						double l = luminance(src.irradiance.row(qy) + 3 * qx);
+						sum += l;
+						sum_sq += l * l;
+						max_variance = std::max(max_variance, src.variance[q]);
+						count++;
+					}
+				}
+
+				const double lp = luminance(cp);
+				double scale = 1.0;
+				if (count > 1) {
+					double mean = sum / count;
+					double deviation = std::sqrt(std::max(0.0, sum_sq / count - mean * mean));
+					double limit = mean + s.firefly_sigma * deviation;
+					if (lp > limit && lp > 0.0) {
+						scale = limit / lp;
+					}
+				}
+				out[0] = static_cast<float>(cp[0] * scale);
+				out[1] = static_cast<float>(cp[1] * scale);
+				out[2] = static_cast<float>(cp[2] * scale);
+				dst.variance[p] = scale < 1.0 ? std::min(src.variance[p], max_variance) : src.variance[p];
+			}
+		}
+	}
+
+	// 每像素的屏幕空间深度梯度 (中心差分, 忽略背景邻居), 用于把深度差换算为像素距离上的期望变化
+	std::vector<float> depth_gradients(const feature_buffers& f) {
+		const int width = f.width();
+		const int height = f.height();
+		std::vector<float> gradient(size_t(width) * height, 0.0f);
+		auto depth_at = [&](int x, int y) {
+			return (x < 0 || x >= width || y < 0 || y >= height) ? 0.0f : f.depth[size_t(y) * width + x];
+		};
+		auto slope = [](float z, float a, float b) {
+			float da = a > 0.0f ? std::abs(z - a) : 0.0f;
+			float db = b > 0.0f ? std::abs(z - b) : 0.0f;
+			return (a > 0.0f && b > 0.0f) ? 0.5f * (da + db) : std::max(da, db);
+		};
+
+		for (int y = 0; y < height; y++) {
+			for (int x = 0; x < width; x++) {
+				float z = depth_at(x, y);
+				if (z <= 0.0f) continue;
+				gradient[size_t(y) * width + x] = std::max(slope(z, depth_at(x - 1, y), depth_at(x + 1, y)),
+					slope(z, depth_at(x, y - 1), depth_at(x, y + 1)));
+			}
+		}
+		return gradient;
+	}
+}
+
+feature_buffers::feature_buffers() {}
+
+feature_buffers::feature_buffers(int width, int height) {
+	resize(width, height);
+}
+
+void feature_buffers::resize(int width, int height) {
+	albedo.resize(width, height);
+	normal.resize(width, height);
+	depth.assign(size_t(width) * height, 0.0f);
+	variance.assign(size_t(width) * height, 0.0f);
+}
+
+void feature_buffers::set_pixel(int x, int y, const sample_features& feature_sum, const color& sum, double luminance_sq_sum, int samples) {
+	const double inv = 1.0 / samples;
+	const size_t index = size_t(y) * width() + x;
+	albedo.set(x, y, feature_sum.albedo * inv);
+	normal.set(x, y, feature_sum.normal.near_zero() ? vec3(0, 0, 0) : unit_vector(feature_sum.normal));
+	depth[index] = static_cast<float>(feature_sum.depth * inv);
+
+	// 样本方差除以样本数即为均值的方差
+	double mean = (0.2126 * sum.x() + 0.7152 * sum.y() + 0.0722 * sum.z()) * inv;
+	double sample_variance = samples > 1 ? std::max(0.0, (luminance_sq_sum - samples * mean * mean) / (samples - 1)) : 0.0;
+	variance[index] = static_cast<float>(sample_variance * inv);
+}
+
+void denoise(const framebuffer& noisy, const feature_buffers& features, framebuffer& output,
+	const denoise_settings& settings, int thread_count) {
+	RT_TRACE_ZONE("denoise");
+	const int width = noisy.width();
+	const int height = noisy.height();
+
+	// 解调: 滤波对象为照度 (颜色 / 反照率), 方差按反照率亮度的平方缩放
+	atrous_image images[2];
+	for (atrous_image& image : images) {
+		image.irradiance.resize(width, height);
+		image.variance.assign(size_t(width) * height, 0.0f);
+	}
+	for (int y = 0; y < height; y++) {
+		const float* c = noisy.row(y);
+		const float* a = features.albedo.row(y);
+		float* irradiance = images[0].irradiance.row(y);
+		for (int x = 0; x < width; x++) {
+			float albedo[3];
+			for (int k = 0; k < 3; k++) {
+				albedo[k] = std::max(a[3 * x + k], min_albedo);
+				irradiance[3 * x + k] = c[3 * x + k] / albedo[k];
+			}
+			double l = luminance(albedo);
+			size_t index = size_t(y) * width + x;
+			images[0].variance[index] = static_cast<float>(features.variance[index] / (l * l));
+		}
+	}
+
+	const std::vector<float> gradient = depth_gradients(features);
+
+	if (thread_count <= 0) {
+		thread_count = std::max(1, (int)std::thread::hardware_concurrency());
+	}
+	mt::ThreadPool pool(thread_count);
+	pool.Init();
+
+	int current = 0;
+	if (settings.firefly_sigma > 0.0) {
+		RT_TRACE_ZONE("firefly clamp");
+		std::vector<std::future<void>> futures;
+		for (int y0 = 0; y0 < height; y0 += settings.tile_size) {
+			int y1 = std::min(height, y0 + settings.tile_size);
+			futures.push_back(pool.Commit([&features, &settings, &images, y0, y1]() {
+				RT_TRACE_THREAD_NAME("denoise worker");
+				clamp_fireflies(features, settings, images[0], images[1], y0, y1);
+			}));
+		}
+		for (auto& future : futures) {
+			future.wait();
+		}
+		current = 1;
+	}
+
+	// 每次迭代读取上一次的结果, 同一次迭代内的图块互不依赖
+	for (int i = 0; i < settings.iterations; i++) {
+		RT_TRACE_ZONE_ARG("a-trous pass", i);
+		const atrous_pass pass = { features, gradient, settings, 1 << i };
+		const atrous_image& src = images[current];
+		atrous_image& dst = images[1 - current];
+
+		std::vector<std::future<void>> futures;
+		for (int y0 = 0; y0 < height; y0 += settings.tile_size) {
+			for (int x0 = 0; x0 < width; x0 += settings.tile_size) {
+				int x1 = std::min(width, x0 + settings.tile_size);
+				int y1 = std::min(height, y0 + settings.tile_size);
+				futures.push_back(pool.Commit([&pass, &src, &dst, x0, y0, x1, y1]() {
+					RT_TRACE_THREAD_NAME("denoise worker");
+					filter_tile(pass, src, dst, x0, y0, x1, y1);
+				}));
+			}
+		}
+		for (auto& future : futures) {
+			future.wait();
+		}
+		current = 1 - current;
+	}
+	pool.Shutdown();
+
+	// 重新乘以反照率
+	output.resize(width, height);
+	for (int y = 0; y < height; y++) {
+		const float* irradiance = images[current].irradiance.row(y);
+		const float* a = features.albedo.row(y);
+		float* out = output.row(y);
+		for (int x = 0; x < 3 * width; x++) {
+			out[x] = irradiance[x] * std::max(a[x], min_albedo);
+		}
+	}
+}
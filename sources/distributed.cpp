@@ -0,0 +1,162 @@
+#include "distributed.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+namespace {
+	const uint32_t net_magic = 0x52544e31;	// "RTN1"
+	const uint64_t max_payload_size = uint64_t(1) << 32;
+}
+
+bool send_message(Socket& socket, net_message type, const void* payload, size_t size) {
+	net_header header = { net_magic, static_cast<uint32_t>(type), size };
+	return socket.SendAll(&header, sizeof(header)) && (size == 0 || socket.SendAll(payload, size));
+}
+
+bool recv_message(Socket& socket, net_message& type, std::vector<char>& payload) {
+	net_header header;
+	if (!socket.RecvAll(&header, sizeof(header))) {
+		return false;
+	}
+	if (header.magic != net_magic || header.size > max_payload_size) {
+		return false;
+	}
+
+	type = static_cast<net_message>(header.type);
+	payload.resize(header.size);
+	return header.size == 0 || socket.RecvAll(payload.data(), header.size);
+}
+
+bool send_tile_result(Socket& socket, const net_tile& tile, const accumulation_buffer& accum) {
+	const auto& sums = accum.sum_data();
+	const auto& counts = accum.count_data();
+	size_t sums_size = sums.size() * sizeof(double);
+	size_t counts_size = counts.size() * sizeof(uint32_t);
+
+	std::vector<char> payload(sizeof(net_tile) + sums_size + counts_size);
+	std::memcpy(payload.data(), &tile, sizeof(net_tile));
+	std::memcpy(payload.data() + sizeof(net_tile), sums.data(), sums_size);
+	std::memcpy(payload.data() + sizeof(net_tile) + sums_size, counts.data(), counts_size);
+	return send_message(socket, net_message::result, payload.data(), payload.size());
+}
+
+bool read_tile_result(const std::vector<char>& payload, int width, const net_tile& expected, accumulation_buffer& accum) {
+	if (payload.size() < sizeof(net_tile)) {
+		return false;
+	}
+
+	// 过期或出错的工作进程可能返回别的 tile, 在写入任何行之前拒绝
+	net_tile tile;
+	std::memcpy(&tile, payload.data(), sizeof(net_tile));
+	if (tile.tile_id != expected.tile_id || tile.first_row != expected.first_row || tile.row_count != expected.row_count ||
+		tile.first_sample != expected.first_sample || tile.sample_count != expected.sample_count) {
+		return false;
+	}
+	if (tile.first_row < 0 || tile.row_count <= 0 || tile.first_row + tile.row_count > accum.height() || width != accum.width()) {
+		return false;
+	}
+
+	size_t pixel_count = size_t(width) * tile.row_count;
+	size_t sums_size = pixel_count * 3 * sizeof(double);
+	size_t counts_size = pixel_count * sizeof(uint32_t);
+	if (payload.size() != sizeof(net_tile) + sums_size + counts_size) {
+		return false;
+	}
+
+	// 整行覆盖写入, 重复收到同一个 tile 也不会重复累加
+	size_t first_pixel = size_t(width) * tile.first_row;
+	std::memcpy(accum.sum_data().data() + first_pixel * 3, payload.data() + sizeof(net_tile), sums_size);
+	std::memcpy(accum.count_data().data() + first_pixel, payload.data() + sizeof(net_tile) + sums_size, counts_size);
+	return true;
+}
+
+tile_scheduler::tile_scheduler(int height, int tile_height, int samples_per_pixel) {
+	tile_height = std::max(1, tile_height);
+	for (int first_row = 0; first_row < height; first_row += tile_height) {
+		net_tile tile;
+		tile.tile_id = (int32_t)tiles.size();
+		tile.first_row = first_row;
+		tile.row_count = std::min(tile_height, height - first_row);
+		tile.first_sample = 0;
+		tile.sample_count = samples_per_pixel;
+		tile.reserved = 0;
+		pending.push_back(tile.tile_id);
+		tiles.push_back(tile);
+	}
+	done.assign(tiles.size(), false);
+	remaining = (int)tiles.size();
+	workers = 0;
+}
+
+bool tile_scheduler::acquire(net_tile& tile) {
+	std::unique_lock<std::mutex> lock(mutex);
+	changed.wait(lock, [this]() { return remaining == 0 || !pending.empty(); });
+	if (remaining == 0) {
+		return false;
+	}
+
+	tile = tiles[pending.front()];
+	pending.pop_front();
+	return true;
+}
+
+bool tile_scheduler::complete(const net_tile& tile) {
+	std::unique_lock<std::mutex> lock(mutex);
+	if (tile.tile_id < 0 || tile.tile_id >= (int)tiles.size() || done[tile.tile_id]) {
+		return false;
+	}
+
+	done[tile.tile_id] = true;
+	remaining--;
+	changed.notify_all();
+	return true;
+}
+
+void tile_scheduler::release(const net_tile& tile) {
+	std::unique_lock<std::mutex> lock(mutex);
+	if (!done[tile.tile_id]) {
+		// 放到队首, 尽快交给其他工作进程; 主线程也在等待同一个条件变量, 必须全部唤醒
+		pending.push_front(tile.tile_id);
+		changed.notify_all();
+	}
+}
+
+bool tile_scheduler::finished() {
+	std::unique_lock<std::mutex> lock(mutex);
+	return remaining == 0;
+}
+
+void tile_scheduler::worker_joined() {
+	std::unique_lock<std::mutex> lock(mutex);
+	workers++;
+	changed.notify_all();
+}
+
+void tile_scheduler::worker_left() {
+	std::unique_lock<std::mutex> lock(mutex);
+	workers--;
+	changed.notify_all();
+}
+
+bool tile_scheduler::wait_finished(double idle_timeout) {
+	std::unique_lock<std::mutex> lock(mutex);
+	while (remaining > 0) {
+		if (workers > 0) {
+			changed.wait(lock, [this]() { return remaining == 0 || workers == 0; });
+			continue;
+		}
+
+		// 没有工作进程时开始计时, 期间有新的工作进程连接则重新等待
+		auto deadline = std::chrono::steady_clock::now() + std::chrono::duration<double>(idle_timeout);
+		if (!changed.wait_until(lock, deadline, [this]() { return remaining == 0 || workers > 0; })) {
+			return false;
+		}
+	}
+	return true;
+}
+
+int tile_scheduler::completed() {
+	std::unique_lock<std::mutex> lock(mutex);
+	return (int)tiles.size() - remaining;
+}
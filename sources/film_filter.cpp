@@ -0,0 +1,153 @@
+#include "film_filter.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+namespace {
+	const int table_size = 256;
+
+	struct filter_info {
+		const char* name;
+		double default_radius;
+	};
+
+	const filter_info filters[] = {
+		{ "box", 0.5 },
+		{ "tent", 1.0 },
+		{ "gaussian", 1.5 },
+		{ "mitchell", 2.0 },
+		{ "blackman-harris", 2.0 },
+	};
+
+	// Mitchell-Netravali, B = C = 1/3; x 已缩放到 [0, 2]
+	double mitchell(double x) {
+		const double B = 1.0 / 3.0;
+		const double C = 1.0 / 3.0;
+		x = std::abs(x);
+		if (x < 1.0) {
+			return ((12 - 9 * B - 6 * C) * x * x * x + (-18 + 12 * B + 6 * C) * x * x + (6 - 2 * B)) / 6.0;
+		}
+		if (x < 2.0) {
+			return ((-B - 6 * C) * x * x * x + (6 * B + 30 * C) * x * x + (-12 * B - 48 * C) * x + (8 * B + 24 * C)) / 6.0;
+		}
+		return 0.0;
+	}
+
+	// 一维滤波函数, 0 <= d <= r
+	double evaluate(filter_type type, double d, double r) {
+		switch (type) {
+		case filter_type::box:
+			return 1.0;
+		case filter_type::tent:
+			return r - d;
+		case filter_type::gaussian: {
+			// sigma = 0.5 像素, 减去边界处的值使权重在半径处连续降到 0
+			const double alpha = 2.0;
+			return std::max(0.0, std::exp(-alpha * d * d) - std::exp(-alpha * r * r));
+		}
+		case filter_type::mitchell:
+			return mitchell(2.0 * d / r);
+		case filter_type::blackman_harris: {
+			// 窗口覆盖 [-r, r], t 为窗口内的位置
+			const double t = 0.5 + 0.5 * d / r;
+			return 0.35875 - 0.48829 * cos(2 * pi * t) + 0.14128 * cos(4 * pi * t) - 0.01168 * cos(6 * pi * t);
+		}
+		}
+		return 0.0;
+	}
+}
+
+reconstruction_filter::reconstruction_filter(filter_type type, double radius) : kind(type) {
+	if (radius <= 0.0) {
+		radius = filters[static_cast<int>(type)].default_radius;
+	}
+	r = clamp(radius, 0.5, max_pixel_radius + 0.5);
+
+	// 样本到像素 x + k 中心的距离为 |dx - 0.5 - k|, dx ∈ [0, 1)
+	pixel_r = int(std::ceil(r + 0.5)) - 1;
+
+	table.resize(table_size);
+	inv_step = table_size / r;
+	for (int i = 0; i < table_size; i++) {
+		table[i] = static_cast<float>(evaluate(type, (i + 0.5) / inv_step, r));
+	}
+}
+
+const char* reconstruction_filter::name(filter_type type) {
+	return filters[static_cast<int>(type)].name;
+}
+
+bool reconstruction_filter::parse(const std::string& text, reconstruction_filter& filter) {
+	size_t colon = text.find(':');
+	std::string type_name = text.substr(0, colon);
+	double radius = colon == std::string::npos ? 0.0 : atof(text.c_str() + colon + 1);
+	for (int i = 0; i < int(sizeof(filters) / sizeof(filters[0])); i++) {
+		if (type_name == filters[i].name) {
+			filter = reconstruction_filter(static_cast<filter_type>(i), radius);
+			return true;
+		}
+	}
+	return false;
+}
+
+film_band::film_band() : filter(nullptr), image_height(0), first_row(0), row_count(0), border(0) {
+	pixels.set_weighted(true);
+}
+
+void film_band::reset(const reconstruction_filter& f, int width, int height, int first, int count) {
+	filter = &f;
+	image_height = height;
+	first_row = first;
+	row_count = count;
+	border = f.pixel_radius();
+
+	int rows = row_count + 2 * border;
+	if (pixels.width() != width || pixels.height() != rows) {
+		pixels.resize(width, rows);
+	}
+	else {
+		pixels.clear();
+	}
+}
+
+void film_band::add_sample(int x, int y, double dx, double dy, const color& c) {
+	const int radius = border;
+	const int width = pixels.width();
+	double wx[2 * reconstruction_filter::max_pixel_radius + 1];
+	double wy[2 * reconstruction_filter::max_pixel_radius + 1];
+	for (int k = -radius; k <= radius; k++) {
+		wx[k + radius] = filter->weight(dx - 0.5 - k);
+		wy[k + radius] = filter->weight(dy - 0.5 - k);
+	}
+
+	const int row_offset = border - first_row;
+	for (int ky = -radius; ky <= radius; ky++) {
+		const int py = y + ky;
+		if (py < 0 || py >= image_height || wy[ky + radius] == 0.0) continue;
+		for (int kx = -radius; kx <= radius; kx++) {
+			const int px = x + kx;
+			if (px < 0 || px >= width) continue;
+			const double w = wx[kx + radius] * wy[ky + radius];
+			if (w != 0.0) {
+				pixels.add_weighted(px, py + row_offset, c * w, w);
+			}
+		}
+	}
+	pixels.add_samples(x, y + row_offset, 1);
+}
+
+void film_band::merge_rows(accumulation_buffer& accum) const {
+	accum.add_rows(pixels, border, first_row, row_count);
+}
+
+void film_band::merge_borders(accumulation_buffer& accum) const {
+	// 下边缘 [first_row - border, first_row) 与上边缘 [first_row + row_count, + border), 裁剪到图像内
+	int below = std::min(border, first_row);
+	if (below > 0) {
+		accum.add_rows(pixels, border - below, first_row - below, below);
+	}
+	int above = std::min(border, image_height - (first_row + row_count));
+	if (above > 0) {
+		accum.add_rows(pixels, border + row_count, first_row + row_count, above);
+	}
+}
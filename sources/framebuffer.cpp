@@ -0,0 +1,18 @@
+#include "framebuffer.h"
+
+#include <algorithm>
+
+framebuffer::framebuffer() : w(0), h(0) {}
+framebuffer::framebuffer(int width, int height) : w(0), h(0) {
+	resize(width, height);
+}
+
+void framebuffer::resize(int width, int height) {
+	w = width;
+	h = height;
+	pixels.assign(3 * size_t(width) * height, 0.0f);
+}
+
+void framebuffer::clear() {
+	std::fill(pixels.begin(), pixels.end(), 0.0f);
+}
@@ -0,0 +1,138 @@
+#include "grid.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+	// 最大边长超过中位数该倍数的图元视为过大, 放入单独的列表
+	const double large_extent_ratio = 16.0;
+
+	// 所有格子总数的上限, 避免极端长宽比下索引数组过大
+	const double max_total_cells = 64.0 * 1024.0 * 1024.0;
+
+	double max_extent(const aabb& box) {
+		return std::max(box.maximum.e[0] - box.minimum.e[0],
+			std::max(box.maximum.e[1] - box.minimum.e[1], box.maximum.e[2] - box.minimum.e[2]));
+	}
+}
+
+uniform_grid::uniform_grid() {
+	clear();
+}
+
+void uniform_grid::clear() {
+	grid_box = aabb();
+	total_box = aabb();
+	primitive_count = 0;
+	for (int a = 0; a < 3; a++) {
+		res[a] = 0;
+		cell_size[a] = 0.0;
+		inv_cell_size[a] = 0.0;
+	}
+	cell_start.clear();
+	cell_items.clear();
+	large_items.clear();
+}
+
+void uniform_grid::build(const std::vector<aabb>& boxes, double density) {
+	RT_TRACE_ZONE_ARG("grid build", (int64_t)boxes.size());
+	clear();
+	primitive_count = boxes.size();
+	if (boxes.empty()) {
+		return;
+	}
+
+	// nth_element 为线性时间, 整个构建保持 O(n)
+	std::vector<double> extents(boxes.size());
+	for (size_t i = 0; i < boxes.size(); i++) {
+		extents[i] = max_extent(boxes[i]);
+	}
+	auto median = extents.begin() + extents.size() / 2;
+	std::nth_element(extents.begin(), median, extents.end());
+	const double large_extent = *median * large_extent_ratio;
+
+	total_box = boxes[0];
+	size_t small_count = 0;
+	for (size_t i = 0; i < boxes.size(); i++) {
+		total_box.expand(boxes[i]);
+		if (max_extent(boxes[i]) > large_extent) {
+			large_items.push_back((uint32_t)i);
+			continue;
+		}
+		if (small_count++ == 0) grid_box = boxes[i];
+		else grid_box.expand(boxes[i]);
+	}
+	if (small_count == 0) {
+		return;
+	}
+
+	// 格子尽量接近立方体: 每轴格子数与该轴长度成正比, 总数约为 density * n
+	double extent[3];
+	double longest = 0.0;
+	for (int a = 0; a < 3; a++) {
+		extent[a] = grid_box.maximum.e[a] - grid_box.minimum.e[a];
+		longest = std::max(longest, extent[a]);
+	}
+	for (int a = 0; a < 3; a++) {
+		// 退化的轴 (如所有球心在同一平面) 给一个很小的厚度
+		if (extent[a] < longest * 1e-6 || extent[a] <= 0.0) {
+			extent[a] = longest > 0.0 ? longest * 1e-6 : 1.0;
+			grid_box.maximum.e[a] = grid_box.minimum.e[a] + extent[a];
+		}
+	}
+
+	double target = std::min(density * double(small_count), max_total_cells);
+	double cells_per_unit = std::cbrt(target / (extent[0] * extent[1] * extent[2]));
+	for (int a = 0; a < 3; a++) {
+		res[a] = std::max(1, std::min(max_resolution, static_cast<int>(extent[a] * cells_per_unit + 0.5)));
+		cell_size[a] = extent[a] / res[a];
+		inv_cell_size[a] = 1.0 / cell_size[a];
+	}
+
+	auto cell_range = [this](const aabb& box, int lo[3], int hi[3]) {
+		for (int a = 0; a < 3; a++) {
+			lo[a] = std::max(0, std::min(res[a] - 1, static_cast<int>((box.minimum.e[a] - grid_box.minimum.e[a]) * inv_cell_size[a])));
+			hi[a] = std::max(0, std::min(res[a] - 1, static_cast<int>((box.maximum.e[a] - grid_box.minimum.e[a]) * inv_cell_size[a])));
+		}
+	};
+
+	// 第一遍统计每个格子的图元数, 前缀和得到起点, 第二遍填充
+	const size_t cells = size_t(res[0]) * res[1] * res[2];
+	cell_start.assign(cells + 1, 0);
+	size_t next_large = 0;
+	for (int pass = 0; pass < 2; pass++) {
+		next_large = 0;
+		for (size_t i = 0; i < boxes.size(); i++) {
+			if (next_large < large_items.size() && large_items[next_large] == i) {
+				next_large++;
+				continue;
+			}
+
+			int lo[3], hi[3];
+			cell_range(boxes[i], lo, hi);
+			for (int z = lo[2]; z <= hi[2]; z++) {
+				for (int y = lo[1]; y <= hi[1]; y++) {
+					size_t row = (size_t(z) * res[1] + y) * res[0];
+					for (int x = lo[0]; x <= hi[0]; x++) {
+						if (pass == 0) cell_start[row + x + 1]++;
+						else cell_items[cell_start[row + x]++] = (uint32_t)i;
+					}
+				}
+			}
+		}
+
+		if (pass == 0) {
+			for (size_t c = 0; c < cells; c++) {
+				cell_start[c + 1] += cell_start[c];
+			}
+			cell_items.resize(cell_start[cells]);
+		}
+	}
+
+	// 填充时起点被推进到了下一个格子的起点, 整体右移一位恢复
+	for (size_t c = cells; c > 0; c--) {
+		cell_start[c] = cell_start[c - 1];
+	}
+	cell_start[0] = 0;
+}
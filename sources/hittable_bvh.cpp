@@ -0,0 +1,70 @@
+#include "hittable_bvh.h"
+
+hittable_bvh::hittable_bvh(const hittable_list& list) {
+	std::vector<aabb> boxes;
+	std::vector<shared_ptr<hittable>> bounded;
+	for (const auto& object : list.objects) {
+		aabb box;
+		if (object->bounding_box(box)) {
+			boxes.push_back(box);
+			bounded.push_back(object);
+		}
+		else {
+			unbounded.push_back(object);
+		}
+	}
+
+	std::vector<uint32_t> order;
+	bvh::build(boxes, nodes, order);
+
+	objects.reserve(order.size());
+	for (uint32_t index : order) {
+		objects.push_back(bounded[index]);
+	}
+}
+
+bool hittable_bvh::hit(const ray& r, double t_min, double t_max, hit_record& rec) const {
+	double closest = t_max;
+	bool hit_anything = false;
+
+	if (!nodes.empty()) {
+		hit_anything = bvh::traverse(nodes.data(), r, t_min, closest,
+			[&](uint32_t i, double t0, double& t1) {
+				if (!objects[i]->hit(r, t0, t1, rec)) {
+					return false;
+				}
+				t1 = rec.t;
+				return true;
+			});
+	}
+
+	for (const auto& object : unbounded) {
+		if (object->hit(r, t_min, closest, rec)) {
+			closest = rec.t;
+			hit_anything = true;
+		}
+	}
+
+	return hit_anything;
+}
+
+void hittable_bvh::refit() {
+	bvh::refit(nodes.data(), nodes.size(), nullptr,
+		[this](uint32_t offset, uint32_t count) {
+			aabb box;
+			for (uint32_t i = offset; i < offset + count; i++) {
+				aabb object_box;
+				if (objects[i]->bounding_box(object_box)) {
+					box.expand(object_box);
+				}
+			}
+			return box;
+		});
+}
+
+bool hittable_bvh::bounding_box(aabb& output_box) const {
+	if (nodes.empty() || !unbounded.empty()) return false;
+
+	output_box = nodes[0].box;
+	return true;
+}
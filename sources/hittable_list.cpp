@@ -30,3 +30,16 @@ bool hittable_list::hit(const ray& r, double t_min, double t_max, hit_record& re
 
 	return hit_anything;
 }
+
+bool hittable_list::bounding_box(aabb& output_box) const {
+	if (objects.empty()) return false;
+
+	aabb temp_box;
+	output_box = aabb();
+	for (const auto& object : objects) {
+		if (!object->bounding_box(temp_box)) return false;
+		output_box.expand(temp_box);
+	}
+
+	return true;
+}
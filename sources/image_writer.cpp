@@ -0,0 +1,379 @@
+#include "image_writer.h"
+#include "thread_pool.hpp"
+#include "trace.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+namespace {
+	const uint32_t adler_base = 65521;
+
+	// deflate 未压缩块最多 65535 字节
+	const size_t max_stored_block = 65535;
+
+	inline unsigned char to_byte(float value) {
+		// 与 convert_color 一致: gamma 2
+		return static_cast<unsigned char>(256 * clamp(std::sqrt(static_cast<double>(value)), 0.0, 0.999));
+	}
+
+	void put_u32_be(std::vector<char>& out, uint32_t value) {
+		out.push_back(char((value >> 24) & 0xFF));
+		out.push_back(char((value >> 16) & 0xFF));
+		out.push_back(char((value >> 8) & 0xFF));
+		out.push_back(char(value & 0xFF));
+	}
+
+	const uint32_t* crc_table() {
+		static const struct table {
+			uint32_t values[256];
+			table() {
+				for (uint32_t n = 0; n < 256; n++) {
+					uint32_t c = n;
+					for (int k = 0; k < 8; k++) {
+						c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+					}
+					values[n] = c;
+				}
+			}
+		} instance;
+		return instance.values;
+	}
+
+	uint32_t crc32(const char* data, size_t size, uint32_t crc = 0) {
+		const uint32_t* table = crc_table();
+		crc = ~crc;
+		for (size_t i = 0; i < size; i++) {
+			crc = table[(crc ^ (unsigned char)data[i]) & 0xFF] ^ (crc >> 8);
+		}
+		return ~crc;
+	}
+
+	uint32_t adler32(const unsigned char* data, size_t size, uint32_t adler = 1) {
+		uint32_t a = adler & 0xFFFF;
+		uint32_t b = adler >> 16;
+		while (size > 0) {
+			// 5552 是保证 b 不溢出的最大块长
+			size_t n = std::min<size_t>(size, 5552);
+			size -= n;
+			while (n--) {
+				a += *data++;
+				b += a;
+			}
+			a %= adler_base;
+			b %= adler_base;
+		}
+		return a | (b << 16);
+	}
+
+	// 与 zlib 的 adler32_combine 相同
+	uint32_t adler32_combine(uint32_t adler1, uint32_t adler2, uint64_t size2) {
+		uint64_t rem = size2 % adler_base;
+		uint64_t sum1 = adler1 & 0xFFFF;
+		uint64_t sum2 = (rem * sum1) % adler_base;
+		sum1 += (adler2 & 0xFFFF) + adler_base - 1;
+		sum2 += ((adler1 >> 16) & 0xFFFF) + ((adler2 >> 16) & 0xFFFF) + adler_base - rem;
+		if (sum1 >= adler_base) sum1 -= adler_base;
+		if (sum1 >= adler_base) sum1 -= adler_base;
+		if (sum2 >= (uint64_t(adler_base) << 1)) sum2 -= (uint64_t(adler_base) << 1);
+		if (sum2 >= adler_base) sum2 -= adler_base;
+		return uint32_t(sum1 | (sum2 << 16));
+	}
+
+	void append_png_chunk(std::vector<char>& out, const char* type, const char* data, size_t size) {
+		put_u32_be(out, static_cast<uint32_t>(size));
+		size_t type_offset = out.size();
+		out.insert(out.end(), type, type + 4);
+		out.insert(out.end(), data, data + size);
+		put_u32_be(out, crc32(&out[type_offset], size + 4));
+	}
+}
+
+image_format image_format_from_path(const std::string& path) {
+	size_t dot = path.find_last_of('.');
+	if (dot == std::string::npos) return image_format::invalid;
+
+	std::string ext = path.substr(dot);
+	std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return (char)std::tolower(c); });
+	if (ext == ".ppm") return image_format::ppm;
+	if (ext == ".png") return image_format::png;
+	if (ext == ".pfm") return image_format::pfm;
+	return image_format::invalid;
+}
+
+image_encoder::image_encoder(image_format format, int width, int height) : fmt(format), w(width), h(height), adler(1) {}
+
+std::vector<char> image_encoder::header() const {
+	std::vector<char> out;
+	if (fmt == image_format::ppm || fmt == image_format::pfm) {
+		std::string text = fmt == image_format::ppm
+			? "P6\n" + std::to_string(w) + " " + std::to_string(h) + "\n255\n"
+			: "PF\n" + std::to_string(w) + " " + std::to_string(h) + "\n-1.0\n";
+		out.assign(text.begin(), text.end());
+	}
+	else if (fmt == image_format::png) {
+		const unsigned char signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+		out.insert(out.end(), signature, signature + 8);
+
+		std::vector<char> ihdr;
+		put_u32_be(ihdr, static_cast<uint32_t>(w));
+		put_u32_be(ihdr, static_cast<uint32_t>(h));
+		const char info[5] = { 8, 2, 0, 0, 0 };	// 8 位, RGB, deflate, 无滤波方法, 无交错
+		ihdr.insert(ihdr.end(), info, info + 5);
+		append_png_chunk(out, "IHDR", ihdr.data(), ihdr.size());
+
+		// zlib 头: deflate, 32K 窗口, 无预设字典
+		const char zlib_header[2] = { 0x78, 0x01 };
+		append_png_chunk(out, "IDAT", zlib_header, 2);
+	}
+	return out;
+}
+
+void image_encoder::encode_band(int first_row, int row_count, const row_source& rows, bool last_band, image_band& band) const {
+	band.bytes.clear();
+	band.checksum = 1;
+	band.raw_size = 0;
+
+	if (fmt == image_format::pfm) {
+		// PFM 使用小端 float, 本机字节序即为小端时可直接复制
+		band.bytes.resize(size_t(row_count) * w * 3 * sizeof(float));
+		for (int r = 0; r < row_count; r++) {
+			std::memcpy(&band.bytes[size_t(r) * w * 3 * sizeof(float)], rows(first_row + r), size_t(w) * 3 * sizeof(float));
+		}
+		return;
+	}
+
+	const size_t row_bytes = size_t(w) * 3 + (fmt == image_format::png ? 1 : 0);
+	std::vector<unsigned char> raw(row_bytes * row_count);
+	for (int r = 0; r < row_count; r++) {
+		unsigned char* out = &raw[row_bytes * r];
+		if (fmt == image_format::png) *out++ = 0;	// 滤波类型: None
+
+		const float* in = rows(first_row + r);
+		for (int i = 0; i < w * 3; i++) {
+			out[i] = to_byte(in[i]);
+		}
+	}
+
+	if (fmt == image_format::ppm) {
+		band.bytes.assign(raw.begin(), raw.end());
+		return;
+	}
+
+	// PNG: 每段单独成为一个 IDAT 块, 内容是若干 deflate 未压缩块
+	band.checksum = adler32(raw.data(), raw.size());
+	band.raw_size = raw.size();
+
+	std::vector<char> stored;
+	stored.reserve(raw.size() + (raw.size() / max_stored_block + 1) * 5);
+	size_t offset = 0;
+	do {
+		size_t size = std::min(max_stored_block, raw.size() - offset);
+		bool final_block = last_band && offset + size == raw.size();
+		stored.push_back(final_block ? 1 : 0);
+		stored.push_back(char(size & 0xFF));
+		stored.push_back(char((size >> 8) & 0xFF));
+		stored.push_back(char(~size & 0xFF));
+		stored.push_back(char((~size >> 8) & 0xFF));
+		stored.insert(stored.end(), raw.begin() + offset, raw.begin() + offset + size);
+		offset += size;
+	} while (offset < raw.size());
+
+	append_png_chunk(band.bytes, "IDAT", stored.data(), stored.size());
+}
+
+void image_encoder::append(const image_band& band) {
+	if (fmt == image_format::png) {
+		adler = adler32_combine(adler, band.checksum, band.raw_size);
+	}
+}
+
+std::vector<char> image_encoder::footer() const {
+	std::vector<char> out;
+	if (fmt == image_format::png) {
+		std::vector<char> trailer;
+		put_u32_be(trailer, adler);
+		append_png_chunk(out, "IDAT", trailer.data(), trailer.size());
+		append_png_chunk(out, "IEND", nullptr, 0);
+	}
+	return out;
+}
+
+bool write_image(const std::string& path, const framebuffer& fb, int thread_count) {
+	RT_TRACE_ZONE("image write");
+	image_format format = image_format_from_path(path);
+	if (format == image_format::invalid) {
+		std::cout << "Unsupported image format: " << path << std::endl;
+		return false;
+	}
+
+	const int width = fb.width();
+	const int height = fb.height();
+	image_encoder encoder(format, width, height);
+	image_encoder::row_source rows = [&fb, &encoder, height](int file_row) {
+		return fb.row(encoder.bottom_up() ? file_row : height - 1 - file_row);
+	};
+
+	if (thread_count <= 0) {
+		thread_count = std::max(1, (int)std::thread::hardware_concurrency());
+	}
+
+	// 按行带并行编码, 每个线程分到若干段以平衡负载
+	const int rows_per_band = std::max(1, (height + thread_count * 4 - 1) / (thread_count * 4));
+	const int band_count = (height + rows_per_band - 1) / rows_per_band;
+	std::vector<image_band> bands(band_count);
+
+	mt::ThreadPool pool(thread_count);
+	pool.Init();
+	std::vector<std::future<void>> futures;
+	for (int b = 0; b < band_count; b++) {
+		int first_row = b * rows_per_band;
+		int row_count = std::min(rows_per_band, height - first_row);
+		futures.push_back(pool.Commit([&, b, first_row, row_count]() {
+			RT_TRACE_THREAD_NAME("image encoder");
+			RT_TRACE_ZONE_ARG("encode band", first_row);
+			encoder.encode_band(first_row, row_count, rows, first_row + row_count == height, bands[b]);
+		}));
+	}
+	for (auto& future : futures) {
+		future.wait();
+	}
+	pool.Shutdown();
+
+	std::ofstream out(path, std::ios::binary | std::ios::trunc);
+	if (!out) {
+		std::cout << "Failed to open image file: " << path << std::endl;
+		return false;
+	}
+
+	std::vector<char> head = encoder.header();
+	out.write(head.data(), head.size());
+	for (const image_band& band : bands) {
+		encoder.append(band);
+		out.write(band.bytes.data(), band.bytes.size());
+	}
+	std::vector<char> tail = encoder.footer();
+	out.write(tail.data(), tail.size());
+
+	return bool(out);
+}
+
+image_stream_writer::image_stream_writer(const std::string& path, int width, int height, size_t max_pending_bands)
+	: path(path), w(width), h(height), max_pending(std::max<size_t>(1, max_pending_bands)),
+	encoder(image_format_from_path(path), width, height), next_file_row(0), closing(false), failed(false) {}
+
+image_stream_writer::~image_stream_writer() {
+	if (writer.joinable()) {
+		close();
+	}
+}
+
+bool image_stream_writer::open() {
+	if (encoder.format() == image_format::invalid) {
+		std::cout << "Unsupported image format: " << path << std::endl;
+		return false;
+	}
+
+	out.open(path, std::ios::binary | std::ios::trunc);
+	if (!out) {
+		std::cout << "Failed to open image file: " << path << std::endl;
+		return false;
+	}
+
+	std::vector<char> head = encoder.header();
+	out.write(head.data(), head.size());
+	writer = std::thread(&image_stream_writer::writer_loop, this);
+	return true;
+}
+
+int image_stream_writer::file_row(int first_row, int row_count) const {
+	return encoder.bottom_up() ? first_row : h - (first_row + row_count);
+}
+
+void image_stream_writer::submit(int first_row, int row_count, std::vector<float> rgb) {
+	const int key = file_row(first_row, row_count);
+
+	std::unique_lock lock(mutex);
+	// 写线程正在等待的行带永远不阻塞, 否则乱序的行带占满队列会造成死锁
+	band_written.wait(lock, [&]() { return failed || key == next_file_row || pending.size() < max_pending; });
+	if (failed) {
+		return;
+	}
+
+	pending[key] = pending_band{ row_count, std::move(rgb) };
+	band_ready.notify_one();
+}
+
+void image_stream_writer::writer_loop() {
+	RT_TRACE_THREAD_NAME("image writer");
+	while (true) {
+		pending_band band;
+		int first_file_row;
+		{
+			std::unique_lock lock(mutex);
+			band_ready.wait(lock, [&]() { return closing || pending.count(next_file_row) > 0; });
+
+			auto it = pending.find(next_file_row);
+			if (it == pending.end()) {
+				break;
+			}
+
+			first_file_row = it->first;
+			band = std::move(it->second);
+			pending.erase(it);
+		}
+
+		// 编码在锁外进行, 渲染线程可以继续提交
+		const int row_count = band.row_count;
+		const float* rgb = band.rgb.data();
+		const size_t row_floats = size_t(w) * 3;
+		const bool bottom_up = encoder.bottom_up();
+		image_encoder::row_source rows = [&](int row) {
+			int local = row - first_file_row;
+			return rgb + row_floats * (bottom_up ? local : row_count - 1 - local);
+		};
+
+		RT_TRACE_ZONE_ARG("encode band", first_file_row);
+		image_band encoded;
+		encoder.encode_band(first_file_row, row_count, rows, first_file_row + row_count == h, encoded);
+		encoder.append(encoded);
+		out.write(encoded.bytes.data(), encoded.bytes.size());
+
+		std::unique_lock lock(mutex);
+		next_file_row += row_count;
+		failed = failed || !out;
+		band_written.notify_all();
+		if (next_file_row >= h || failed) {
+			break;
+		}
+	}
+}
+
+bool image_stream_writer::close() {
+	{
+		std::unique_lock lock(mutex);
+		closing = true;
+	}
+	band_ready.notify_all();
+
+	if (writer.joinable()) {
+		writer.join();
+	}
+
+	std::unique_lock lock(mutex);
+	bool complete = next_file_row == h && !failed;
+	if (complete) {
+		std::vector<char> tail = encoder.footer();
+		out.write(tail.data(), tail.size());
+	}
+	out.close();
+
+	failed = failed || !complete;
+	band_written.notify_all();
+	if (!complete) {
+		std::cout << "Image stream incomplete: " << path << std::endl;
+	}
+	return complete && !out.fail();
+}
@@ -0,0 +1,32 @@
+#include "instance.h"
+
+instance::instance(shared_ptr<hittable> prototype, const transform& object_to_world)
+	: prototype(prototype), world_to_object(object_to_world.inverse()) {}
+
+bool instance::hit(const ray& r, double t_min, double t_max, hit_record& rec) const {
+	// 方向不归一化, 两个空间中的 t 保持一致
+	ray local(world_to_object.point(r.orig), world_to_object.vector(r.dir), r.tm);
+	if (!prototype->hit(local, t_min, t_max, rec)) {
+		return false;
+	}
+
+	// 法线乘以逆矩阵的转置; 点积符号不变, front_face 依然有效
+	rec.p3 = r.at(rec.t);
+	rec.normal = unit_vector(world_to_object.transposed_vector(rec.normal));
+
+	// 纹理坐标不变, 物体空间中的长度按沿光线方向的缩放换算到世界空间
+	const double scale = r.dir.length() / local.dir.length();
+	rec.dpdu_length *= scale;
+	rec.dpdv_length *= scale;
+	return true;
+}
+
+bool instance::bounding_box(aabb& output_box) const {
+	aabb local_box;
+	if (!prototype->bounding_box(local_box)) {
+		return false;
+	}
+
+	output_box = world_to_object.inverse().box(local_box);
+	return true;
+}
@@ -10,9 +10,18 @@ bool Line::hit(const ray& r, double t_min, double t_max, hit_record& rec) const
 
 	rec.p3 = r.origin() + t*r.direction();
 	rec.front_face = true;
-	rec.mat_ptr = mat_ptr;
+	rec.mat_ptr = mat_ptr.get();
 	rec.normal = l;
 	rec.t = t;
+	rec.u = rec.v = 0.0;
+	rec.dpdu_length = rec.dpdv_length = 1.0;
 
 	return true;
-}
\ No newline at end of file
+}
+
+bool Line::bounding_box(aabb& output_box) const {
+	output_box = aabb();
+	output_box.expand(p1);
+	output_box.expand(p2);
+	return true;
+}
@@ -0,0 +1,99 @@
+#include "material_check.h"
+#include "material.h"
+
+#include <cstdio>
+#include <iostream>
+
+namespace {
+	const double tolerance = 1e-9;
+
+	inline double relative_error(double a, double b) {
+		return std::abs(a - b) / std::max(std::max(std::abs(a), std::abs(b)), 1e-12);
+	}
+
+	inline double relative_error(const color& a, const color& b) {
+		return std::max(relative_error(a.x(), b.x()), std::max(relative_error(a.y(), b.y()), relative_error(a.z(), b.z())));
+	}
+
+	struct material_result {
+		int sampled = 0;		// 成功采样的次数
+		int delta = 0;			// 其中 delta 分布的次数
+		double f_error = 0.0;
+		double pdf_error = 0.0;
+		double weight_error = 0.0;
+		int delta_errors = 0;	// delta 分布的 eval 或 pdf 不为 0
+	};
+
+	// 在随机的法线与观察方向上采样, 正反两面各半
+	material_result run(const material& mat, int count) {
+		material_result result;
+		seed_random(4, 0);
+		for (int i = 0; i < count; i++) {
+			hit_record rec;
+			rec.t = 1.0;
+			rec.u = random_double();
+			rec.v = random_double();
+			rec.dpdu_length = rec.dpdv_length = 0.0;
+			rec.normal = random_unit_vector();
+			rec.front_face = (i & 1) == 0;
+
+			vec3 wo = random_unit_vector();
+			if (dot(wo, rec.normal) < 0.0) wo = -wo;
+			rec.p3 = point3(0, 0, 0);
+			ray r_in(rec.p3 + wo, -wo, 0.0);
+
+			bsdf_sample s;
+			if (!mat.sample(r_in, rec, s)) continue;
+			result.sampled++;
+
+			double footprint = r_in.footprint(rec.t);
+			color f = mat.eval(rec, s.wi, wo, footprint);
+			double pdf = mat.pdf(rec, s.wi, wo);
+			if (s.specular) {
+				result.delta++;
+				if (pdf != 0.0 || f.x() != 0.0 || f.y() != 0.0 || f.z() != 0.0) result.delta_errors++;
+				continue;
+			}
+
+			result.f_error = std::max(result.f_error, relative_error(s.f, f));
+			result.pdf_error = std::max(result.pdf_error, relative_error(s.pdf, pdf));
+			if (s.pdf > 0.0) {
+				result.weight_error = std::max(result.weight_error, relative_error(s.weight, s.f * std::abs(dot(s.wi, rec.normal)) / s.pdf));
+			}
+		}
+		return result;
+	}
+
+	bool passed(const material_result& r) {
+		return r.sampled > 0 && r.delta_errors == 0 && r.f_error < tolerance && r.pdf_error < tolerance && r.weight_error < tolerance;
+	}
+}
+
+bool check_materials(int count) {
+	std::cout << "material                  sampled    delta   f error  pdf error  weight error" << std::endl;
+
+	struct entry {
+		const char* name;
+		material mat;
+	};
+	const entry entries[] = {
+		{ "lambertian", lambertian(color(0.5, 0.6, 0.7)) },
+		{ "metal (smooth)", metal(color(0.9, 0.6, 0.3), 0.0) },
+		{ "metal (roughness 0.2)", metal(color(0.9, 0.6, 0.3), 0.2) },
+		{ "metal (roughness 0.8)", metal(color(0.9, 0.6, 0.3), 0.8) },
+		{ "dielectric (smooth)", dielectric(1.5) },
+		{ "dielectric (roughness 0.3)", dielectric(1.5, 0.3) },
+		{ "dielectric (roughness 0.8)", dielectric(1.5, 0.8) },
+	};
+
+	bool ok = true;
+	for (const entry& e : entries) {
+		material_result r = run(e.mat, count);
+		char line[160];
+		snprintf(line, sizeof(line), "%-26s %7d %8d %9.1e %10.1e %13.1e  %s", e.name, r.sampled, r.delta,
+			r.f_error, r.pdf_error, r.weight_error, passed(r) ? "ok" : "FAILED");
+		std::cout << line << std::endl;
+		ok = ok && passed(r);
+	}
+	return ok;
+}
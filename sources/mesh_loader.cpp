@@ -0,0 +1,336 @@
+#include "mesh_loader.h"
+#include "File.hpp"
+
+#include <cstring>
+#include <cstdlib>
+#include <cmath>
+#include <algorithm>
+#include <cctype>
+#include <iostream>
+
+namespace {
+	// OBJ 索引从 1 开始, 负数表示相对于当前顶点数
+	bool resolve_obj_index(long index, size_t vertex_count, uint32_t& out) {
+		if (index > 0 && size_t(index) <= vertex_count) {
+			out = static_cast<uint32_t>(index - 1);
+			return true;
+		}
+		if (index < 0 && size_t(-index) <= vertex_count) {
+			out = static_cast<uint32_t>(vertex_count + index);
+			return true;
+		}
+		return false;
+	}
+
+	enum class ply_type { int8, uint8, int16, uint16, int32, uint32, float32, float64, invalid };
+
+	struct ply_property {
+		std::string name;
+		ply_type type = ply_type::invalid;
+		bool is_list = false;
+		ply_type count_type = ply_type::invalid;
+	};
+
+	struct ply_element {
+		std::string name;
+		size_t count = 0;
+		std::vector<ply_property> properties;
+	};
+
+	ply_type parse_ply_type(const char* name) {
+		if (!std::strcmp(name, "char") || !std::strcmp(name, "int8")) return ply_type::int8;
+		if (!std::strcmp(name, "uchar") || !std::strcmp(name, "uint8")) return ply_type::uint8;
+		if (!std::strcmp(name, "short") || !std::strcmp(name, "int16")) return ply_type::int16;
+		if (!std::strcmp(name, "ushort") || !std::strcmp(name, "uint16")) return ply_type::uint16;
+		if (!std::strcmp(name, "int") || !std::strcmp(name, "int32")) return ply_type::int32;
+		if (!std::strcmp(name, "uint") || !std::strcmp(name, "uint32")) return ply_type::uint32;
+		if (!std::strcmp(name, "float") || !std::strcmp(name, "float32")) return ply_type::float32;
+		if (!std::strcmp(name, "double") || !std::strcmp(name, "float64")) return ply_type::float64;
+		return ply_type::invalid;
+	}
+
+	size_t ply_type_size(ply_type type) {
+		switch (type) {
+		case ply_type::int8: case ply_type::uint8: return 1;
+		case ply_type::int16: case ply_type::uint16: return 2;
+		case ply_type::int32: case ply_type::uint32: case ply_type::float32: return 4;
+		case ply_type::float64: return 8;
+		default: return 0;
+		}
+	}
+
+	// 列表长度与顶点索引: [0, limit] 内的整数
+	inline bool is_ply_index(double v, double limit) {
+		return v >= 0.0 && v <= limit && v == std::floor(v);
+	}
+
+	// 读取一个标量并转换为 double, swap 表示文件字节序与本机相反
+	double read_ply_value(const unsigned char* p, ply_type type, bool swap) {
+		unsigned char bytes[8];
+		size_t size = ply_type_size(type);
+		std::memcpy(bytes, p, size);
+		if (swap) std::reverse(bytes, bytes + size);
+
+		switch (type) {
+		case ply_type::int8: { int8_t v; std::memcpy(&v, bytes, 1); return v; }
+		case ply_type::uint8: { uint8_t v; std::memcpy(&v, bytes, 1); return v; }
+		case ply_type::int16: { int16_t v; std::memcpy(&v, bytes, 2); return v; }
+		case ply_type::uint16: { uint16_t v; std::memcpy(&v, bytes, 2); return v; }
+		case ply_type::int32: { int32_t v; std::memcpy(&v, bytes, 4); return v; }
+		case ply_type::uint32: { uint32_t v; std::memcpy(&v, bytes, 4); return v; }
+		case ply_type::float32: { float v; std::memcpy(&v, bytes, 4); return v; }
+		case ply_type::float64: { double v; std::memcpy(&v, bytes, 8); return v; }
+		default: return 0.0;
+		}
+	}
+
+	bool is_little_endian() {
+		const uint16_t probe = 1;
+		return *(const unsigned char*)&probe == 1;
+	}
+}
+
+bool load_obj(const std::string& path, std::vector<float>& positions, std::vector<uint32_t>& indices) {
+	positions.clear();
+	indices.clear();
+
+	std::vector<uint32_t> polygon;
+	File file(path);
+	bool ok = file.ReadLines([&](char* line) {
+		while (*line == ' ' || *line == '\t') line++;
+
+		if (line[0] == 'v' && (line[1] == ' ' || line[1] == '\t')) {
+			char* p = line + 2;
+			for (int i = 0; i < 3; i++) {
+				char* end = nullptr;
+				float value = std::strtof(p, &end);
+				if (end == p) {
+					std::cout << "Invalid OBJ vertex: " << line << std::endl;
+					return false;
+				}
+				positions.push_back(value);
+				p = end;
+			}
+		}
+		else if (line[0] == 'f' && (line[1] == ' ' || line[1] == '\t')) {
+			// f v, f v/vt, f v//vn, f v/vt/vn: 只取顶点索引
+			polygon.clear();
+			char* p = line + 2;
+			while (true) {
+				while (*p == ' ' || *p == '\t' || *p == '\r') p++;
+				if (*p == '\0') break;
+
+				char* end = nullptr;
+				long index = std::strtol(p, &end, 10);
+				uint32_t resolved;
+				if (end == p || !resolve_obj_index(index, positions.size() / 3, resolved)) {
+					std::cout << "Invalid OBJ face: " << line << std::endl;
+					return false;
+				}
+				polygon.push_back(resolved);
+
+				p = end;
+				while (*p != '\0' && *p != ' ' && *p != '\t') p++;
+			}
+			if (polygon.size() < 3) {
+				std::cout << "Invalid OBJ face: " << line << std::endl;
+				return false;
+			}
+
+			for (size_t i = 2; i < polygon.size(); i++) {
+				indices.push_back(polygon[0]);
+				indices.push_back(polygon[i - 1]);
+				indices.push_back(polygon[i]);
+			}
+		}
+		return true;
+	});
+
+	if (!ok) {
+		std::cout << "Failed to load OBJ: " << path << std::endl;
+	}
+	return ok;
+}
+
+bool load_ply(const std::string& path, std::vector<float>& positions, std::vector<uint32_t>& indices) {
+	positions.clear();
+	indices.clear();
+
+	MappedFile file(path);
+	if (!file.Map()) {
+		std::cout << "Failed to open PLY: " << path << std::endl;
+		return false;
+	}
+
+	const unsigned char* data = file.GetData();
+	const size_t size = file.GetSize();
+
+	const char* header_end_tag = "end_header";
+	const unsigned char* header_end = std::search(data, data + size, header_end_tag, header_end_tag + std::strlen(header_end_tag));
+	const unsigned char* body = header_end == data + size ? nullptr :
+		(const unsigned char*)std::memchr(header_end, '\n', data + size - header_end);
+	if (size < 4 || std::memcmp(data, "ply", 3) != 0 || body == nullptr) {
+		std::cout << "Invalid PLY header: " << path << std::endl;
+		return false;
+	}
+	body++;
+
+	// 解析文本头
+	std::string header((const char*)data, (const char*)body);
+	std::vector<ply_element> elements;
+	bool swap = false;
+	bool binary = false;
+	size_t line_start = 0;
+	while (line_start < header.size()) {
+		size_t line_end = header.find('\n', line_start);
+		std::string line = header.substr(line_start, line_end - line_start);
+		line_start = line_end + 1;
+
+		char* p = &line[0];
+		char* keyword = std::strtok(p, " \t\r");
+		if (keyword == nullptr) continue;
+
+		if (!std::strcmp(keyword, "format")) {
+			const char* format = std::strtok(nullptr, " \t\r");
+			if (format != nullptr && !std::strcmp(format, "binary_little_endian")) { binary = true; swap = !is_little_endian(); }
+			else if (format != nullptr && !std::strcmp(format, "binary_big_endian")) { binary = true; swap = is_little_endian(); }
+		}
+		else if (!std::strcmp(keyword, "element")) {
+			const char* name = std::strtok(nullptr, " \t\r");
+			const char* count = std::strtok(nullptr, " \t\r");
+			if (name == nullptr || count == nullptr) {
+				std::cout << "Invalid PLY element: " << path << std::endl;
+				return false;
+			}
+			ply_element element;
+			element.name = name;
+			element.count = std::strtoull(count, nullptr, 10);
+			elements.push_back(element);
+		}
+		else if (!std::strcmp(keyword, "property") && !elements.empty()) {
+			ply_property property;
+			const char* type = std::strtok(nullptr, " \t\r");
+			if (type != nullptr && !std::strcmp(type, "list")) {
+				const char* count_type = std::strtok(nullptr, " \t\r");
+				type = std::strtok(nullptr, " \t\r");
+				property.is_list = true;
+				property.count_type = count_type ? parse_ply_type(count_type) : ply_type::invalid;
+			}
+			const char* name = std::strtok(nullptr, " \t\r");
+			if (type == nullptr || name == nullptr) {
+				std::cout << "Invalid PLY property: " << path << std::endl;
+				return false;
+			}
+			property.type = parse_ply_type(type);
+			property.name = name;
+			if (property.type == ply_type::invalid || (property.is_list && property.count_type == ply_type::invalid)) {
+				std::cout << "Unsupported PLY property type: " << path << std::endl;
+				return false;
+			}
+			elements.back().properties.push_back(property);
+		}
+	}
+
+	if (!binary) {
+		std::cout << "Only binary PLY files are supported: " << path << std::endl;
+		return false;
+	}
+
+	// 解析二进制数据, 所有读取都做边界检查
+	auto truncated = [&path]() {
+		std::cout << "Truncated PLY file: " << path << std::endl;
+		return false;
+	};
+	const unsigned char* p = body;
+	const unsigned char* end = data + size;
+	for (const ply_element& element : elements) {
+		const bool is_vertex = element.name == "vertex";
+		const bool is_face = element.name == "face";
+		// 数量来自文件头, 预留空间不超过文件大小, 避免伪造的数量导致巨大的分配
+		if (is_vertex) positions.reserve(std::min(element.count, size) * 3);
+		if (is_face) indices.reserve(std::min(element.count, size) * 3);
+
+		std::vector<uint32_t> polygon;
+		for (size_t e = 0; e < element.count; e++) {
+			float xyz[3] = { 0.0f, 0.0f, 0.0f };
+			for (const ply_property& property : element.properties) {
+				if (!property.is_list) {
+					size_t value_size = ply_type_size(property.type);
+					if (size_t(end - p) < value_size) return truncated();
+					if (is_vertex) {
+						int axis = property.name == "x" ? 0 : property.name == "y" ? 1 : property.name == "z" ? 2 : -1;
+						if (axis >= 0) xyz[axis] = static_cast<float>(read_ply_value(p, property.type, swap));
+					}
+					p += value_size;
+					continue;
+				}
+
+				size_t count_size = ply_type_size(property.count_type);
+				size_t value_size = ply_type_size(property.type);
+				if (size_t(end - p) < count_size) return truncated();
+				// 列表长度与索引可以用有符号或浮点类型存储, 负数与非整数不能转换为无符号数
+				double list_count = read_ply_value(p, property.count_type, swap);
+				if (!is_ply_index(list_count, double(size))) {
+					std::cout << "Invalid PLY list count: " << path << std::endl;
+					return false;
+				}
+				size_t count = static_cast<size_t>(list_count);
+				p += count_size;
+				if (size_t(end - p) / value_size < count) return truncated();
+
+				bool is_indices = is_face && (property.name == "vertex_indices" || property.name == "vertex_index");
+				if (is_indices) {
+					polygon.clear();
+					for (size_t i = 0; i < count; i++) {
+						double index = read_ply_value(p + i * value_size, property.type, swap);
+						if (!is_ply_index(index, 4294967295.0)) {
+							std::cout << "Invalid PLY face index: " << path << std::endl;
+							return false;
+						}
+						polygon.push_back(static_cast<uint32_t>(index));
+					}
+					for (size_t i = 2; i < polygon.size(); i++) {
+						indices.push_back(polygon[0]);
+						indices.push_back(polygon[i - 1]);
+						indices.push_back(polygon[i]);
+					}
+				}
+				p += count * value_size;
+			}
+
+			if (is_vertex) {
+				positions.insert(positions.end(), xyz, xyz + 3);
+			}
+		}
+	}
+
+	const size_t vertex_count = positions.size() / 3;
+	for (uint32_t index : indices) {
+		if (index >= vertex_count) {
+			std::cout << "PLY face index out of range: " << path << std::endl;
+			return false;
+		}
+	}
+
+	return true;
+}
+
+shared_ptr<triangle_mesh> load_mesh(const std::string& path, shared_ptr<material> mat) {
+	std::vector<float> positions;
+	std::vector<uint32_t> indices;
+
+	File file(path);
+	std::string type = file.GetFileType();
+	std::transform(type.begin(), type.end(), type.begin(), [](unsigned char c) { return (char)std::tolower(c); });
+
+	bool ok = false;
+	if (type == ".obj") ok = load_obj(path, positions, indices);
+	else if (type == ".ply") ok = load_ply(path, positions, indices);
+	else std::cout << "Unsupported mesh format: " << path << std::endl;
+
+	if (!ok || indices.empty()) {
+		return nullptr;
+	}
+
+	return make_shared<triangle_mesh>(std::move(positions), std::move(indices), mat);
+}
@@ -0,0 +1,102 @@
+#include "microfacet.h"
+
+namespace {
+	const int schlick_table_size = 256;
+	const int albedo_table_size = 32;
+	const int albedo_table_samples = 16;	// 每项 16 x 16 个分层样本
+
+	struct schlick_table {
+		float values[schlick_table_size + 1];
+
+		schlick_table() {
+			for (int i = 0; i <= schlick_table_size; i++) {
+				double m = 1.0 - double(i) / schlick_table_size;
+				values[i] = static_cast<float>(m * m * m * m * m);
+			}
+		}
+	};
+
+	// E(cos_o, alpha) 在 (cos_o, sqrt(alpha)) 的 [0, 1] 上等距取格点 (含端点), 粗糙度低时分辨率更高
+	struct albedo_table {
+		float values[albedo_table_size][albedo_table_size];
+
+		albedo_table() {
+			const int n = albedo_table_samples;
+			for (int i = 0; i < albedo_table_size; i++) {
+				double cos_o = std::max(double(i) / (albedo_table_size - 1), 1e-3);
+				vec3 wo(std::sqrt(1.0 - cos_o * cos_o), 0.0, cos_o);
+				for (int j = 0; j < albedo_table_size; j++) {
+					double r = double(j) / (albedo_table_size - 1);
+					double alpha = std::max(r * r, 1e-3);
+					double sum = 0.0;
+					for (int a = 0; a < n; a++) {
+						for (int b = 0; b < n; b++) {
+							vec3 m = ggx::sample_visible_normal(wo, alpha, (a + 0.5) / n, (b + 0.5) / n);
+							vec3 wi = 2.0 * dot(wo, m) * m - wo;
+							if (wi.z() > 0.0) {
+								sum += ggx::sampled_weight(wo, wi, alpha);
+							}
+						}
+					}
+					values[i][j] = static_cast<float>(std::max(sum / (n * n), 1e-3));
+				}
+			}
+		}
+	};
+
+	const schlick_table& schlick_values() {
+		static const schlick_table table;
+		return table;
+	}
+
+	const albedo_table& albedo_values() {
+		static const albedo_table table;
+		return table;
+	}
+
+	inline void table_coordinate(double x, int& i0, int& i1, double& t) {
+		double f = clamp(x, 0.0, 1.0) * (albedo_table_size - 1);
+		i0 = int(f);
+		i1 = std::min(i0 + 1, albedo_table_size - 1);
+		t = f - i0;
+	}
+}
+
+double schlick_weight(double cosine) {
+	double f = clamp(cosine, 0.0, 1.0) * schlick_table_size;
+	int i = std::min(int(f), schlick_table_size - 1);
+	double t = f - i;
+	const float* v = schlick_values().values;
+	return v[i] + t * (v[i + 1] - v[i]);
+}
+
+namespace ggx {
+	vec3 sample_visible_normal(const vec3& wo, double alpha, double u1, double u2) {
+		// 拉伸到 alpha = 1 的半球, 在投影圆盘上均匀采样后映射回来
+		vec3 vh = unit_vector(vec3(alpha * wo.x(), alpha * wo.y(), wo.z()));
+		double len2 = vh.x() * vh.x() + vh.y() * vh.y();
+		vec3 t1 = len2 > 0.0 ? vec3(-vh.y(), vh.x(), 0.0) / std::sqrt(len2) : vec3(1.0, 0.0, 0.0);
+		vec3 t2 = cross(vh, t1);
+
+		double r = std::sqrt(u1);
+		double phi = 2.0 * pi * u2;
+		double p1 = r * cos(phi);
+		double p2 = r * sin(phi);
+		double s = 0.5 * (1.0 + vh.z());
+		p2 = (1.0 - s) * std::sqrt(std::max(0.0, 1.0 - p1 * p1)) + s * p2;
+
+		vec3 nh = p1 * t1 + p2 * t2 + std::sqrt(std::max(0.0, 1.0 - p1 * p1 - p2 * p2)) * vh;
+		return unit_vector(vec3(alpha * nh.x(), alpha * nh.y(), std::max(1e-6, nh.z())));
+	}
+
+	double directional_albedo(double cos_o, double alpha) {
+		int i0, i1, j0, j1;
+		double ti, tj;
+		table_coordinate(cos_o, i0, i1, ti);
+		table_coordinate(std::sqrt(alpha), j0, j1, tj);
+		const albedo_table& e = albedo_values();
+		double a = e.values[i0][j0] + tj * (e.values[i0][j1] - e.values[i0][j0]);
+		double b = e.values[i1][j0] + tj * (e.values[i1][j1] - e.values[i1][j0]);
+		return a + ti * (b - a);
+	}
+}
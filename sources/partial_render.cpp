@@ -0,0 +1,172 @@
+#include "partial_render.h"
+#include "File.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+namespace {
+	const char partial_magic[8] = { 'R', 'T', 'P', 'A', 'R', 'T', '\0', '\0' };
+	const uint32_t partial_version = 2;
+	const uint32_t partial_endian_tag = 0x01020304;
+
+	struct partial_header {
+		char magic[8];
+		uint32_t version;
+		uint32_t endian;
+		uint32_t fraction_bits;
+		uint32_t reserved;
+		partial_info info;
+	};
+}
+
+partial_buffer::partial_buffer() : w(0), h(0) {}
+
+partial_buffer::partial_buffer(int width, int height) : w(0), h(0) {
+	resize(width, height);
+}
+
+void partial_buffer::resize(int width, int height) {
+	w = width;
+	h = height;
+	sums.assign(size_t(width) * height * 3, 0);
+	counts.assign(size_t(width) * height, 0u);
+}
+
+bool partial_buffer::merge(const partial_buffer& other) {
+	if (other.w != w || other.h != h) {
+		return false;
+	}
+
+	for (size_t i = 0; i < sums.size(); i++) {
+		sums[i] += other.sums[i];
+	}
+	for (size_t i = 0; i < counts.size(); i++) {
+		counts[i] += other.counts[i];
+	}
+	return true;
+}
+
+void partial_buffer::resolve(framebuffer& fb) const {
+	if (fb.width() != w || fb.height() != h) {
+		fb.resize(w, h);
+	}
+
+	for (int y = 0; y < h; y++) {
+		float* out = fb.row(y);
+		for (int x = 0; x < w; x++) {
+			size_t index = size_t(y) * w + x;
+			double scale = resolve_scale(counts[index]);
+			*out++ = static_cast<float>(sums[3 * index + 0] * scale);
+			*out++ = static_cast<float>(sums[3 * index + 1] * scale);
+			*out++ = static_cast<float>(sums[3 * index + 2] * scale);
+		}
+	}
+}
+
+bool is_partial_path(const std::string& path) {
+	const std::string suffix = ".rtpart";
+	return path.size() >= suffix.size() && path.compare(path.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+bool save_partial(const std::string& path, const partial_info& info, const partial_buffer& partial) {
+	partial_header header = {};
+	std::memcpy(header.magic, partial_magic, sizeof(partial_magic));
+	header.version = partial_version;
+	header.endian = partial_endian_tag;
+	header.fraction_bits = partial_buffer::fraction_bits;
+	header.info = info;
+
+	File file(path);
+	const auto& sums = partial.sum_data();
+	const auto& counts = partial.count_data();
+	if (!file.WriteBytes((const char*)&header, sizeof(header), std::ios::binary | std::ios::trunc) ||
+		!file.WriteBytes((const char*)sums.data(), sums.size() * sizeof(int64_t), std::ios::binary | std::ios::app) ||
+		!file.WriteBytes((const char*)counts.data(), counts.size() * sizeof(uint32_t), std::ios::binary | std::ios::app)) {
+		std::cout << "Failed to write partial render: " << path << std::endl;
+		return false;
+	}
+	return true;
+}
+
+bool load_partial(const std::string& path, partial_info& info, partial_buffer& partial) {
+	MappedFile file(path);
+	if (!file.Map()) {
+		std::cout << "Failed to map partial render: " << path << std::endl;
+		return false;
+	}
+
+	partial_header header;
+	if (file.GetSize() < sizeof(header)) {
+		std::cout << "Partial render is truncated: " << path << std::endl;
+		return false;
+	}
+	std::memcpy(&header, file.GetData(), sizeof(header));
+
+	if (std::memcmp(header.magic, partial_magic, sizeof(partial_magic)) != 0 || header.version != partial_version ||
+		header.endian != partial_endian_tag || header.fraction_bits != partial_buffer::fraction_bits) {
+		std::cout << "Unsupported partial render: " << path << std::endl;
+		return false;
+	}
+
+	const partial_info& stored = header.info;
+	size_t pixel_count = size_t(stored.width) * stored.height;
+	size_t sums_size = pixel_count * 3 * sizeof(int64_t);
+	size_t counts_size = pixel_count * sizeof(uint32_t);
+	if (stored.width <= 0 || stored.height <= 0 || file.GetSize() < sizeof(header) + sums_size + counts_size) {
+		std::cout << "Partial render is truncated: " << path << std::endl;
+		return false;
+	}
+
+	partial.resize(stored.width, stored.height);
+	std::memcpy(partial.sum_data().data(), file.GetData() + sizeof(header), sums_size);
+	std::memcpy(partial.count_data().data(), file.GetData() + sizeof(header) + sums_size, counts_size);
+	info = stored;
+	return true;
+}
+
+bool merge_partials(const std::vector<std::string>& paths, partial_info& info, partial_buffer& merged) {
+	if (paths.empty()) {
+		return false;
+	}
+
+	std::vector<std::pair<int, int>> ranges;
+	for (size_t i = 0; i < paths.size(); i++) {
+		partial_info part_info;
+		partial_buffer part;
+		if (!load_partial(paths[i], part_info, part)) {
+			return false;
+		}
+
+		if (i == 0) {
+			info = part_info;
+			merged = std::move(part);
+		}
+		else {
+			if (part_info.width != info.width || part_info.height != info.height || part_info.max_depth != info.max_depth ||
+				std::memcmp(part_info.camera, info.camera, sizeof(info.camera)) != 0) {
+				std::cout << "Partial render comes from a different frame: " << paths[i] << std::endl;
+				return false;
+			}
+			merged.merge(part);
+		}
+		ranges.push_back({ part_info.first_sample, part_info.end_sample });
+	}
+
+	// 同一个样本被渲染两次会使结果偏向该区间
+	std::sort(ranges.begin(), ranges.end());
+	for (size_t i = 1; i < ranges.size(); i++) {
+		if (ranges[i].first < ranges[i - 1].second) {
+			std::cout << "Sample ranges overlap: [" << ranges[i - 1].first << ", " << ranges[i - 1].second << ") and ["
+				<< ranges[i].first << ", " << ranges[i].second << ")" << std::endl;
+			return false;
+		}
+		if (ranges[i].first > ranges[i - 1].second) {
+			std::cout << "Samples [" << ranges[i - 1].second << ", " << ranges[i].first << ") are missing" << std::endl;
+		}
+	}
+
+	info.first_sample = ranges.front().first;
+	info.end_sample = ranges.back().second;
+	return true;
+}
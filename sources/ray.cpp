@@ -1,7 +1,8 @@
 #include "ray.h"
 
-ray::ray() {}
-ray::ray(point3 origin, vec3 direction) : orig(origin), dir(direction) {}
+ray::ray() : tm(0.0), cone_width(0.0), cone_spread(0.0) {}
+ray::ray(point3 origin, vec3 direction, double time)
+	: orig(origin), dir(direction), tm(time), cone_width(0.0), cone_spread(0.0) {}
 
 point3 ray::origin() const { return orig; }
 vec3 ray::direction() const { return dir; }
@@ -0,0 +1,75 @@
+#include "render_job.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <vector>
+
+render_job::render_job(const render_job_settings& settings)
+	: job_settings(settings), next_sample(0), done(false) {
+	render_region& r = job_settings.region;
+	if (r.empty()) {
+		r = { 0, 0, settings.width, settings.height };
+	}
+	if (!settings.filter.is_box()) {
+		buffer.set_weighted(true);
+		bands.resize((settings.height + settings.band_height - 1) / settings.band_height);
+	}
+	buffer.resize(settings.width, settings.height);
+}
+
+render_job::~render_job() {
+	cancel();
+}
+
+void render_job::start(mt::ThreadPool& pool, band_function band, pass_function on_pass, int first_sample) {
+	next_sample = first_sample;
+	done = false;
+	driver = std::thread(&render_job::drive, this, std::ref(pool), std::move(band), std::move(on_pass));
+}
+
+void render_job::cancel() {
+	cancel_token.cancel();
+	wait();
+}
+
+void render_job::wait() {
+	if (driver.joinable()) {
+		driver.join();
+	}
+}
+
+void render_job::drive(mt::ThreadPool& pool, band_function band, pass_function on_pass) {
+	RT_TRACE_THREAD_NAME("render driver");
+	const render_job_settings& s = job_settings;
+	while (next_sample < s.samples_per_pixel && !cancelled()) {
+		RT_TRACE_ZONE_ARG("pass", next_sample);
+		int first_sample = next_sample;
+		int sample_count = std::min(s.samples_per_pass, s.samples_per_pixel - first_sample);
+
+		std::vector<std::future<void>> futures;
+		for (int first_row = s.region.y0; first_row < s.region.y1; first_row += s.band_height) {
+			int row_count = std::min(s.band_height, s.region.y1 - first_row);
+			futures.push_back(pool.Commit(band, std::ref(*this), first_row, row_count, first_sample, sample_count));
+		}
+
+		// 即使已取消也要等全部任务返回, 之后才能释放 job
+		for (auto& future : futures) {
+			future.wait();
+		}
+		if (cancelled()) {
+			break;
+		}
+
+		// 各行带只写了自己的行, 溢出到相邻行带的部分在此合并
+		for (const film_band& b : bands) {
+			b.merge_borders(buffer);
+		}
+
+		next_sample = first_sample + sample_count;
+		if (on_pass) {
+			on_pass(*this);
+		}
+	}
+
+	done = true;
+}
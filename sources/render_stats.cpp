@@ -0,0 +1,139 @@
+#include "render_stats.h"
+#include "material.h"
+#include "File.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <vector>
+
+static_assert(int(material_type::custom) + 1 == stats_material_types, "scatter counters must cover every material type");
+
+void render_stats::clear() {
+	primary_rays = 0;
+	secondary_rays = 0;
+	intersection_tests = 0;
+	bvh_nodes_visited = 0;
+	grid_cells_visited = 0;
+	std::fill(std::begin(scatter_calls), std::end(scatter_calls), 0);
+	std::fill(std::begin(path_ends), std::end(path_ends), 0);
+	std::fill(std::begin(path_length), std::end(path_length), 0);
+}
+
+void render_stats::merge(const render_stats& other) {
+	primary_rays += other.primary_rays;
+	secondary_rays += other.secondary_rays;
+	intersection_tests += other.intersection_tests;
+	bvh_nodes_visited += other.bvh_nodes_visited;
+	grid_cells_visited += other.grid_cells_visited;
+	for (int i = 0; i < stats_material_types; i++) scatter_calls[i] += other.scatter_calls[i];
+	for (int i = 0; i < path_end_count; i++) path_ends[i] += other.path_ends[i];
+	for (int i = 0; i < stats_path_length_bins; i++) path_length[i] += other.path_length[i];
+}
+
+std::string render_stats::to_json(double seconds) const {
+	static const char* material_names[stats_material_types] = { "lambertian", "metal", "dielectric", "custom" };
+	static const char* path_end_names[path_end_count] = { "escaped", "absorbed", "depth_limit" };
+
+	std::ostringstream out;
+	out << "{\n";
+	out << "  \"seconds\": " << seconds << ",\n";
+	out << "  \"rays\": " << rays() << ",\n";
+	out << "  \"primary_rays\": " << primary_rays << ",\n";
+	out << "  \"secondary_rays\": " << secondary_rays << ",\n";
+	out << "  \"rays_per_second\": " << (seconds > 0.0 ? rays() / seconds : 0.0) << ",\n";
+	out << "  \"intersection_tests\": " << intersection_tests << ",\n";
+	out << "  \"bvh_nodes_visited\": " << bvh_nodes_visited << ",\n";
+	out << "  \"grid_cells_visited\": " << grid_cells_visited << ",\n";
+
+	out << "  \"scatter_calls\": {";
+	for (int i = 0; i < stats_material_types; i++) {
+		out << (i ? ", " : " ") << "\"" << material_names[i] << "\": " << scatter_calls[i];
+	}
+	out << " },\n";
+
+	out << "  \"path_ends\": {";
+	for (int i = 0; i < path_end_count; i++) {
+		out << (i ? ", " : " ") << "\"" << path_end_names[i] << "\": " << path_ends[i];
+	}
+	out << " },\n";
+
+	// 去掉末尾的空格子
+	int bins = stats_path_length_bins;
+	while (bins > 1 && path_length[bins - 1] == 0) bins--;
+	out << "  \"path_length\": [";
+	for (int i = 0; i < bins; i++) {
+		out << (i ? ", " : "") << path_length[i];
+	}
+	out << "]\n";
+	out << "}\n";
+	return out.str();
+}
+
+bool render_stats::write_json(const std::string& path, double seconds) const {
+	std::string json = to_json(seconds);
+	File file(path);
+	if (!file.WriteBytes(json.data(), json.size(), std::ios::binary | std::ios::trunc)) {
+		std::cout << "Failed to write stats: " << path << std::endl;
+		return false;
+	}
+	return true;
+}
+
+#ifdef RENDER_STATS_ENABLED
+
+namespace {
+	struct stats_registry {
+		std::mutex mutex;
+		std::vector<render_stats_slot*> slots;
+		render_stats retired;	// 已退出线程的计数
+	};
+
+	stats_registry& registry() {
+		static stats_registry instance;
+		return instance;
+	}
+}
+
+render_stats_slot::render_stats_slot() {
+	stats_registry& r = registry();
+	std::lock_guard<std::mutex> lock(r.mutex);
+	r.slots.push_back(this);
+}
+
+render_stats_slot::~render_stats_slot() {
+	stats_registry& r = registry();
+	std::lock_guard<std::mutex> lock(r.mutex);
+	r.retired.merge(data);
+	r.slots.erase(std::remove(r.slots.begin(), r.slots.end(), this), r.slots.end());
+}
+
+render_stats collect_render_stats() {
+	stats_registry& r = registry();
+	std::lock_guard<std::mutex> lock(r.mutex);
+	render_stats total = r.retired;
+	for (const render_stats_slot* slot : r.slots) {
+		total.merge(slot->data);
+	}
+	return total;
+}
+
+void reset_render_stats() {
+	stats_registry& r = registry();
+	std::lock_guard<std::mutex> lock(r.mutex);
+	r.retired.clear();
+	for (render_stats_slot* slot : r.slots) {
+		slot->data.clear();
+	}
+}
+
+#else
+
+render_stats collect_render_stats() {
+	return render_stats();
+}
+
+void reset_render_stats() {}
+
+#endif // RENDER_STATS_ENABLED
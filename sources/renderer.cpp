@@ -1,13 +1,21 @@
 ﻿#include "renderer.h"
 #include "sphere.h"
+#include "sphere_set.h"
 #include "material.h"
+#include "image_writer.h"
+#include "accumulator.h"
+#include "render_stats.h"
+#include "trace.h"
+#include "distributed.h"
+#include "partial_render.h"
+#include "hittable_bvh.h"
+#include "texture_cache.h"
 
+#include <atomic>
+#include <cctype>
+#include <cstdio>
 #include <iostream>
 
-static const double aspect_ratio = 16.0 / 9.0;
-static const int WIDTH = 1200;
-static const int HEIGHT = static_cast<int>(WIDTH / aspect_ratio);
-
 const char* vertexShaderSource =
 "#version 460 core\n"
 "layout (location = 0) in vec2 aPos; \n\
@@ -40,8 +48,14 @@ unsigned int indices[] = {
 };
 
 renderer::renderer() {
-	pixels = std::vector<unsigned char>(WIDTH * HEIGHT * 4);
-	Renderering = false;
+	image_width = 1200;
+	image_height = 675;
+	pixels = std::vector<unsigned char>(size_t(image_width) * image_height * 4);
+	hdr.resize(image_width, image_height);
+	textureID = 0;
+	strcpy(outputPath, "output.png");
+	render_start = 0.0;
+	last_render_seconds = 0.0;
 	samples_per_pixel = 100;
 	max_depth = 50;
 	fov = 30.0;
@@ -50,17 +64,25 @@ renderer::renderer() {
 	worldup = vec3(0, 1, 0);
 	aperture = 0.1f;
 	dist_to_focus = (camera_pos - lookat).length() / 2.0f;
-	cam = camera(fov, aspect_ratio, camera_pos, lookat, worldup, aperture, dist_to_focus);
+	shutter_open = shutter_close = 0.0;
+	cam = camera(current_camera(), aspect_ratio());
+	accelerator = sphere_accelerator::bvh;
 	world = init_scene();
 	leftPanelWidth = 220.0f;
 	rightPanelWidth =  0.0f;
 	statusBarHeight = 30.0f;
-	mainWindowSize = ImVec2(WIDTH + leftPanelWidth + rightPanelWidth, HEIGHT + 2 *statusBarHeight);
+	mainWindowSize = ImVec2(image_width + leftPanelWidth + rightPanelWidth, image_height + 2 *statusBarHeight);
 }
 
 renderer::renderer(int object_count) {
-	pixels = std::vector<unsigned char>(WIDTH * HEIGHT * 4);
-	Renderering = false;
+	image_width = 1200;
+	image_height = 675;
+	pixels = std::vector<unsigned char>(size_t(image_width) * image_height * 4);
+	hdr.resize(image_width, image_height);
+	textureID = 0;
+	strcpy(outputPath, "output.png");
+	render_start = 0.0;
+	last_render_seconds = 0.0;
 	samples_per_pixel = 250;
 	max_depth = 30;
 	fov = 30.0;
@@ -69,21 +91,25 @@ renderer::renderer(int object_count) {
 	worldup = vec3(0, 1, 0);
 	dist_to_focus = (camera_pos - lookat).length() / 2.0f;
 	aperture = 0.1f;
-	cam = camera(fov, aspect_ratio, camera_pos, lookat, worldup, aperture, dist_to_focus);
+	shutter_open = shutter_close = 0.0;
+	cam = camera(current_camera(), aspect_ratio());
+	accelerator = sphere_accelerator::bvh;
 	world = init_scene(object_count);
 
 	// UI
 	leftPanelWidth = 220.0f;
 	rightPanelWidth = 0.0f;
 	statusBarHeight = 30.0f;
-	mainWindowSize = ImVec2(WIDTH + leftPanelWidth + rightPanelWidth + 20, HEIGHT + 2 * statusBarHeight);
+	mainWindowSize = ImVec2(image_width + leftPanelWidth + rightPanelWidth + 20, image_height + 2 * statusBarHeight);
 }
 
 hittable_list renderer::init_scene(int size) {
+	RT_TRACE_ZONE("scene build");
 	hittable_list world;
+	spheres = make_shared<sphere_set>();
+	spheres->set_accelerator(accelerator);
 
-	world.add(make_shared<sphere>(
-		vec3(0, -1000, 0), 1000, make_shared<lambertian>(vec3(0.5, 0.5, 0.5))));
+	spheres->add(vec3(0, -1000, 0), 1000, spheres->add_material(lambertian(vec3(0.5, 0.5, 0.5))));
 
 	int i = 1;
 	for (int a = -size; a < size; a++) {
@@ -94,35 +120,183 @@ hittable_list renderer::init_scene(int size) {
 				if (choose_mat < 0.8) {
 					// diffuse
 					auto albedo = vec3::random() * vec3::random();
-					world.add(
-						make_shared<sphere>(center, 0.2, make_shared<lambertian>(albedo)));
+					spheres->add(center, 0.2, spheres->add_material(lambertian(albedo)));
 				}
 				else if (choose_mat < 0.95) {
 					// metal
 					auto albedo = vec3::random(.5, 1);
 					auto fuzz = random_double(0, .5);
-					world.add(
-						make_shared<sphere>(center, 0.2, make_shared<metal>(albedo, fuzz)));
+					spheres->add(center, 0.2, spheres->add_material(metal(albedo, fuzz)));
 				}
 				else {
 					// glass
-					world.add(make_shared<sphere>(center, 0.2, make_shared<dielectric>(1.5)));
+					spheres->add(center, 0.2, spheres->add_material(dielectric(1.5)));
 				}
 			}
 		}
 	}
 
-	world.add(make_shared<sphere>(vec3(0, 1, 0), 1.0, make_shared<dielectric>(1.5)));
+	spheres->add(vec3(0, 1, 0), 1.0, spheres->add_material(dielectric(1.5)));
+
+	spheres->add(vec3(-4, 1, 0), 1.0, spheres->add_material(lambertian(vec3(0.4, 0.2, 0.1))));
 
-	world.add(
-		make_shared<sphere>(vec3(-4, 1, 0), 1.0, make_shared<lambertian>(vec3(0.4, 0.2, 0.1))));
+	spheres->add(vec3(4, 1, 0), 1.0, spheres->add_material(metal(vec3(0.7, 0.6, 0.5), 0.0)));
 
-	world.add(
-		make_shared<sphere>(vec3(4, 1, 0), 1.0, make_shared<metal>(vec3(0.7, 0.6, 0.5), 0.0)));
+	spheres->build();
+	world.add(spheres);
 
 	return world;
 }
 
+bool renderer::load_scene(const std::string& path) {
+	scene loaded;
+	if (!::load_scene(path, loaded)) {
+		return false;
+	}
+
+	fov = (float)loaded.cam.vfov;
+	camera_pos = loaded.cam.lookfrom;
+	lookat = loaded.cam.lookat;
+	worldup = loaded.cam.vup;
+	aperture = (float)loaded.cam.aperture;
+	dist_to_focus = loaded.cam.focus_dist;
+	shutter_open = loaded.cam.shutter_open;
+	shutter_close = loaded.cam.shutter_close;
+	cam = camera(current_camera(), aspect_ratio());
+	samples_per_pixel = loaded.settings.samples_per_pixel;
+	max_depth = loaded.settings.max_depth;
+	animation = loaded.animation;
+
+	spheres = loaded.spheres;
+	world = loaded.world;
+	if (spheres && spheres->get_accelerator() != accelerator) {
+		spheres->set_accelerator(accelerator);
+	}
+	return true;
+}
+
+sphere_update renderer::edit_scene(const std::function<void(sphere_set&)>& edit) {
+	const bool restart = job != nullptr;
+	stop_job();
+
+	edit(*spheres);
+	sphere_update update = spheres->commit();
+
+	// 顶层对象 BVH 缓存了球体集合的包围盒
+	for (const auto& object : world.objects) {
+		if (auto top = std::dynamic_pointer_cast<hittable_bvh>(object)) {
+			top->refit();
+		}
+	}
+
+	if (restart) {
+		render_fbo();
+	}
+	return update;
+}
+
+sphere_update renderer::jitter_spheres(double fraction, double amount) {
+	aabb bounds;
+	if (!spheres || spheres->size() == 0 || !spheres->bounding_box(bounds)) {
+		return sphere_update::none;
+	}
+
+	const double max_radius = 0.01 * (bounds.maximum - bounds.minimum).length();
+	const size_t count = std::max<size_t>(1, size_t(spheres->size() * fraction));
+	size_t moved = 0;
+	double start = IPlatform::GetInstance()->PlatformGetAbsoluteTime();
+	sphere_update update = edit_scene([&](sphere_set& set) {
+		const uint32_t limit = set.id_limit();
+		for (size_t i = 0; i < count; i++) {
+			uint32_t id = random_u32() % limit;
+			point3 center;
+			double r;
+			if (!set.get(id, center, r) || r > max_radius) continue;
+			set.move(id, center + amount * r * random_in_unit_sphere(), r);
+			moved++;
+		}
+	});
+
+	static const char* update_names[] = { "none", "refit", "partial rebuild", "full rebuild" };
+	double elapsed = IPlatform::GetInstance()->PlatformGetAbsoluteTime() - start;
+	std::cout << "Moved " << moved << " spheres, " << update_names[static_cast<int>(update)] << " in " << elapsed * 1000.0 << " ms" << std::endl;
+	return update;
+}
+
+void renderer::set_resolution(int width, int height) {
+	// 像素坐标按 width - 1 与 height - 1 归一化, 至少需要 2 个像素
+	width = std::max(2, width);
+	height = std::max(2, height);
+	if (width == image_width && height == image_height) {
+		return;
+	}
+
+	const bool restart = job != nullptr;
+	stop_job();
+	image_width = width;
+	image_height = height;
+	{
+		std::lock_guard<std::mutex> lock(pixels_mutex);
+		pixels.assign(size_t(width) * height * 4, (unsigned char)0);
+		hdr.resize(width, height);
+	}
+	cam = camera(current_camera(), aspect_ratio());
+
+	// 窗口模式下重新分配预览纹理, 并让窗口适应新的画面尺寸
+	mainWindowSize = ImVec2(image_width + leftPanelWidth + rightPanelWidth + 20, image_height + 2 * statusBarHeight);
+	if (textureID != 0) {
+		glBindTexture(GL_TEXTURE_2D, textureID);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, image_width, image_height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+		((Windows32*)IPlatform::GetInstance())->SetClientSize((int)mainWindowSize.x, (int)mainWindowSize.y);
+	}
+
+	if (restart) {
+		render_fbo();
+	}
+}
+
+void renderer::set_region(int x0, int y0, int x1, int y1) {
+	region = { x0, y0, x1, y1 };
+	if (job) {
+		render_fbo();
+	}
+}
+
+void renderer::set_accelerator(sphere_accelerator type) {
+	accelerator = type;
+	if (spheres) {
+		spheres->set_accelerator(type);
+	}
+}
+
+bool renderer::save_scene(const std::string& path) {
+	scene current;
+	current.cam = current_camera();
+	current.settings.samples_per_pixel = samples_per_pixel;
+	current.settings.max_depth = max_depth;
+	current.spheres = spheres;
+
+	// 去掉已删除的图元, 并把新增的图元放入 BVH
+	spheres->compact();
+	return save_scene_binary(path, current);
+}
+
+bool renderer::save_image(const std::string& path) {
+	double start = IPlatform::GetInstance()->PlatformGetAbsoluteTime();
+	framebuffer image;
+	{
+		std::lock_guard<std::mutex> lock(pixels_mutex);
+		image = hdr;
+	}
+	if (!write_image(path, image)) {
+		return false;
+	}
+
+	double elapsed = IPlatform::GetInstance()->PlatformGetAbsoluteTime() - start;
+	std::cout << "Saved " << path << " in " << elapsed * 1000.0 << " ms" << std::endl;
+	return true;
+}
+
 renderer& renderer::init() {
 	IPlatform* Plat = Windows32::GetInstance();
 	IPlatform::PlatformInfo Info = { "Ray Tracer", 200, 200, (int)mainWindowSize.x, (int)mainWindowSize.y };
@@ -157,7 +331,7 @@ renderer& renderer::init() {
 	// 初始化Texture
 	glGenTextures(1, &textureID);
 	glBindTexture(GL_TEXTURE_2D, textureID);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, WIDTH, HEIGHT, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, image_width, image_height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
 	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, textureID, 0);
@@ -189,40 +363,168 @@ renderer& renderer::init() {
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
 	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
 
-	glViewport(0, 0, WIDTH, HEIGHT);
+	glViewport(0, 0, image_width, image_height);
 	glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
 
 	return *this;
 }
 
 void renderer::render_fbo() {
-	if (Renderering) {
-		return;
-	}
-
 	ThreadPool.Init();
-	Renderering = true;
-	int thread_count = std::thread::hardware_concurrency();
-	int section_count = static_cast<int>(HEIGHT / thread_count);
-	std::cout << "Current thread count: " << thread_count << "\nsection count:" << section_count << std::endl;
-	for (int i = 0; i < thread_count; ++i) {
-		// 最后一个section将剩余所有行都写满
-		int end_height = i == thread_count - 1 ? HEIGHT : (i + 1) * section_count;
-		ThreadPool.Commit(&renderer::subrender, this, 0, i * section_count, WIDTH, end_height);
+	stop_job();
+	// 只渲染区域时保留区域外上一次的画面作为参照
+	if (region.empty()) {
+		clear_preview();
 	}
+	reset_render_stats();
+	render_start = IPlatform::GetInstance()->PlatformGetAbsoluteTime();
+
+	// 交互模式每个 pass 只采 1 个样本, 改动相机后下一帧就能看到新画面
+	job = std::make_unique<render_job>(make_job_settings(cam, image_width, image_height, 1));
+	job->start(ThreadPool,
+		[this](render_job& j, int first_row, int row_count, int first_sample, int sample_count) {
+			accumulate_band(j, first_row, row_count, first_sample, sample_count);
+		},
+		[this](render_job& j) { update_preview(j); });
+	std::cout << "Render started with " << ThreadPool.GetThreadCount() << " threads" << std::endl;
 }
 
 void renderer::clear_fbo() {
-	if (!Renderering) {
-		return;
+	stop_job();
+	clear_preview();
+}
+
+void renderer::stop_job() {
+	if (job) {
+		// cancel 会等待所有已提交的行带返回, 不会留下仍在访问旧 job 的线程
+		job->cancel();
+		job.reset();
 	}
+}
 
-	Renderering = false;
+void renderer::clear_preview() {
+	std::lock_guard<std::mutex> lock(pixels_mutex);
+	std::fill(pixels.begin(), pixels.end(), (unsigned char)0);
+	hdr.clear();
+}
 
-	Sleep(20);
-	for (auto& pixel : pixels) {
-		pixel = 0;
+void renderer::update_preview(render_job& j) {
+	RT_TRACE_ZONE("preview resolve");
+	const accumulation_buffer& accum = j.accum();
+	const render_region& r = j.settings().region;
+	std::lock_guard<std::mutex> lock(pixels_mutex);
+
+	// pass 之间所有任务都已返回, 此时汇总线程计数是安全的
+	last_stats = collect_render_stats();
+	last_render_seconds = IPlatform::GetInstance()->PlatformGetAbsoluteTime() - render_start;
+	accum.resolve(hdr, r.x0, r.y0, r.x1, r.y1);
+	for (int y = r.y0; y < r.y1; y++) {
+		const float* src = hdr.row(y) + 3 * r.x0;
+		unsigned char* dst = &pixels[(size_t(y) * image_width + r.x0) * 4];
+		for (int x = r.x0; x < r.x1; x++) {
+			*dst++ = convert_color(*src++, 1);
+			*dst++ = convert_color(*src++, 1);
+			*dst++ = convert_color(*src++, 1);
+			*dst++ = convert_color(1.0f, 1);
+		}
+	}
+}
+
+camera_settings renderer::current_camera() const {
+	camera_settings settings;
+	settings.vfov = fov;
+	settings.lookfrom = camera_pos;
+	settings.lookat = lookat;
+	settings.vup = worldup;
+	settings.aperture = aperture;
+	settings.focus_dist = dist_to_focus;
+	settings.shutter_open = shutter_open;
+	settings.shutter_close = shutter_close;
+	return settings;
+}
+
+// FNV-1a, 按值的字节累加
+template <typename T>
+static inline uint64_t hash_value(uint64_t h, const T& value) {
+	unsigned char bytes[sizeof(T)];
+	std::memcpy(bytes, &value, sizeof(T));
+	for (unsigned char b : bytes) {
+		h = (h ^ b) * 0x100000001b3ull;
+	}
+	return h;
+}
+
+static inline uint64_t hash_vec3(uint64_t h, const vec3& v) {
+	return hash_value(hash_value(hash_value(h, v.x()), v.y()), v.z());
+}
+
+uint64_t renderer::scene_hash() const {
+	const uint64_t basis = 0xcbf29ce484222325ull;
+	const camera_settings c = current_camera();
+	uint64_t h = hash_value(basis, c.vfov);
+	h = hash_vec3(h, c.lookfrom);
+	h = hash_vec3(h, c.lookat);
+	h = hash_vec3(h, c.vup);
+	h = hash_value(h, c.aperture);
+	h = hash_value(h, c.focus_dist);
+	h = hash_value(h, c.shutter_open);
+	h = hash_value(h, c.shutter_close);
+
+	// 每个球单独求摘要后相加, 结果与槽位顺序无关; 材质按内容而不是编号计入, 已删除的 NaN 槽位跳过
+	if (spheres) {
+		const sphere_set_view& v = spheres->view();
+		uint64_t sphere_sum = 0;
+		for (size_t i = 0; i < v.count; i++) {
+			if (std::isnan(v.radius[i])) continue;
+			const material& m = v.materials[v.material_ids[i]];
+			uint64_t s = hash_vec3(basis, vec3(v.center_x[i], v.center_y[i], v.center_z[i]));
+			s = hash_value(s, v.radius[i]);
+			if (v.motion_x) {
+				s = hash_vec3(s, vec3(v.motion_x[i], v.motion_y[i], v.motion_z[i]));
+			}
+			s = hash_value(s, m.type);
+			s = hash_value(s, m.texture_id);
+			s = hash_vec3(s, m.albedo);
+			s = hash_value(s, m.roughness);
+			s = hash_value(s, m.ref_rdx);
+			sphere_sum += s;
+		}
+		h = hash_value(h, sphere_sum);
+	}
+
+	// 其他物体 (网格、实例等) 按包围盒计入
+	for (const auto& object : world.objects) {
+		aabb box;
+		if (object != spheres && object->bounding_box(box)) {
+			h = hash_vec3(hash_vec3(h, box.min()), box.max());
+		}
 	}
+	return h;
+}
+
+render_job_settings renderer::make_job_settings(const camera& view, int width, int height, int samples_per_pass) const {
+	render_job_settings s;
+	s.view = view;
+	s.width = width;
+	s.height = height;
+	s.samples_per_pixel = samples_per_pixel;
+	s.samples_per_pass = std::max(1, std::min(samples_per_pass, samples_per_pixel));
+	s.max_depth = max_depth;
+	s.filter = filter;
+
+	// 区域以左上角为原点给出, 转换为 framebuffer 的行号并裁剪到图像内; 裁剪后为空时渲染整幅图像
+	s.region = { 0, 0, width, height };
+	if (!region.empty()) {
+		render_region clipped;
+		clipped.x0 = std::max(0, region.x0);
+		clipped.x1 = std::min(width, region.x1);
+		clipped.y0 = std::max(0, height - region.y1);
+		clipped.y1 = std::min(height, height - region.y0);
+		if (!clipped.empty()) {
+			s.region = clipped;
+		}
+	}
+	return s;
 }
 
 void renderer::render() {
@@ -244,12 +546,15 @@ void renderer::render() {
 
 		// Object pass
 		glBindFramebuffer(GL_FRAMEBUFFER, FBO);
-		glViewport(0, 0, WIDTH, HEIGHT);
+		glViewport(0, 0, image_width, image_height);
 		glClear(GL_COLOR_BUFFER_BIT);
 
-		pixels_mutex.lock();
-		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, WIDTH, HEIGHT, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
-		pixels_mutex.unlock();
+		{
+			RT_TRACE_ZONE("framebuffer upload");
+			pixels_mutex.lock();
+			glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, image_width, image_height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+			pixels_mutex.unlock();
+		}
 
 		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
 		glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
@@ -268,6 +573,19 @@ void renderer::render() {
 			ImGuiWindowFlags_NoTitleBar
 		);
 		ImGui::Text("FPS: %.1f", ImGui::GetIO().Framerate);
+#ifdef RENDER_STATS_ENABLED
+		{
+			std::lock_guard<std::mutex> lock(pixels_mutex);
+			double rays = double(last_stats.rays());
+			ImGui::SameLine();
+			ImGui::Text("| Rays: %.2fM (%.2f Mrays/s)  primary %.2fM  secondary %.2fM | BVH nodes/ray: %.1f  tests/ray: %.1f",
+				rays * 1e-6,
+				last_render_seconds > 0.0 ? rays * 1e-6 / last_render_seconds : 0.0,
+				last_stats.primary_rays * 1e-6, last_stats.secondary_rays * 1e-6,
+				rays > 0.0 ? last_stats.bvh_nodes_visited / rays : 0.0,
+				rays > 0.0 ? last_stats.intersection_tests / rays : 0.0);
+		}
+#endif
 		ImGui::End();
 
 		ImGui::SetNextWindowPos(ImVec2(0, statusBarHeight));
@@ -294,7 +612,18 @@ void renderer::render() {
 				if (ImGui::InputFloat("  ", &fov)) { is_modified = true; }
 				ImGui::Text("aperture:");
 				if (ImGui::InputFloat("   ", &aperture)) { is_modified = true; }
-				if (is_modified) { cam = camera(fov, aspect_ratio, camera_pos, lookat, worldup, aperture, dist_to_focus); }
+				float shutter[2] = { (float)shutter_open, (float)shutter_close };
+				ImGui::Text("shutter:");
+				if (ImGui::InputFloat2("##shutter", shutter, "%.2f")) {
+					shutter_open = shutter[0];
+					shutter_close = shutter[1];
+					is_modified = true;
+				}
+				if (is_modified) {
+					cam = camera(current_camera(), aspect_ratio());
+					// 正在渲染时取消旧任务并立即用新相机重新开始
+					if (job) { render_fbo(); }
+				}
 			}
 			ImGui::EndChild();
 
@@ -305,6 +634,23 @@ void renderer::render() {
 				ImGui::InputInt("    ", &samples_per_pixel);
 				ImGui::Text("max depth:");
 				ImGui::InputInt("     ", &max_depth);
+				int resolution[2] = { image_width, image_height };
+				ImGui::Text("resolution:");
+				if (ImGui::InputInt2("##resolution", resolution, ImGuiInputTextFlags_EnterReturnsTrue)) {
+					set_resolution(resolution[0], resolution[1]);
+				}
+				int bounds[4] = { region.x0, region.y0, region.x1, region.y1 };
+				ImGui::Text("region (x0 y0 x1 y1):");
+				if (ImGui::InputInt4("##region", bounds, ImGuiInputTextFlags_EnterReturnsTrue)) {
+					set_region(bounds[0], bounds[1], bounds[2], bounds[3]);
+				}
+				if (!region.empty() && ImGui::Button("Full frame")) { set_region(0, 0, 0, 0); }
+				ImGui::Text("pixel filter:");
+				int filter_index = static_cast<int>(filter.type());
+				if (ImGui::Combo("##filter", &filter_index, "box\0tent\0gaussian\0mitchell\0blackman-harris\0")) {
+					filter = reconstruction_filter(static_cast<filter_type>(filter_index));
+					if (job) { render_fbo(); }
+				}
 			}
 			ImGui::EndChild();
 		}
@@ -317,15 +663,20 @@ void renderer::render() {
 			ImGui::Text("Tools bar");
 			if (ImGui::Button("Tracing FBO")) { render_fbo(); }
 			if (ImGui::Button("Clear FBO")) { clear_fbo(); }
+			if (ImGui::Button("Save Scene")) { save_scene("scene.rtbin"); }
+			if (ImGui::Button("Jitter Spheres")) { jitter_spheres(0.01, 0.5); }
+			ImGui::Text("output (.png/.ppm/.pfm):");
+			ImGui::InputText("##output", outputPath, sizeof(outputPath));
+			if (ImGui::Button("Save Image")) { save_image(outputPath); }
 		}
 		ImGui::End();
 
 		ImGui::SetNextWindowPos(ImVec2(leftPanelWidth, statusBarHeight));
-		ImGui::SetNextWindowSize(ImVec2(WIDTH + 20, HEIGHT + statusBarHeight));
+		ImGui::SetNextWindowSize(ImVec2(image_width + 20, image_height + statusBarHeight));
 		ImGui::Begin("Scene View", nullptr, ImGuiWindowFlags_NoMove | ImGuiWindowFlags_NoResize | ImGuiWindowFlags_NoTitleBar);
 		ImGui::Image(
 			(ImTextureID)textureID,
-			ImVec2(WIDTH, HEIGHT),
+			ImVec2(image_width, image_height),
 			ImVec2(0, 1), ImVec2(1, 0)
 		);
 		ImGui::End();
@@ -342,7 +693,7 @@ void renderer::render() {
 }
 
 void renderer::close() {
-	Renderering = false;
+	stop_job();
 	ThreadPool.Shutdown();
 
 	ImGui_ImplOpenGL3_Shutdown();
@@ -352,10 +703,37 @@ void renderer::close() {
 	IPlatform::GetInstance()->PlatformShutdown();
 }
 
-color renderer::ray_color(ray r, const hittable& world, int depth){
+// 记录路径的结束原因与长度 (反弹次数)
+static inline void record_path_end(path_end reason, int bounce) {
+	RT_STAT_INC(path_ends[reason]);
+	RT_STAT_INC(path_length[std::min(bounce, stats_path_length_bins - 1)]);
+}
+
+// 玻璃与理想镜面不决定可见表面的特征, 降噪特征沿其继续记录
+static bool is_specular(const material& m) {
+	return (m.type == material_type::dielectric || m.type == material_type::metal) && m.roughness == 0.0;
+}
+
+// 散射后光线锥的扩展量: 镜面保持不变, 粗糙金属与玻璃按粗糙度放宽;
+// 漫反射的方向分布很宽, 按固定的大扩展量估计路径覆盖范围, 之后的命中使用较粗的 mip 层级
+static double scattered_spread(const material& m, double spread) {
+	const double diffuse_spread = 0.5;
+	switch (m.type) {
+	case material_type::dielectric:
+	case material_type::metal:		return spread + m.roughness;
+	default:						return std::max(spread, diffuse_spread);
+	}
+}
+
+color renderer::ray_color(ray r, const hittable& world, int depth, int bounce, sample_features* features){
 	hit_record rec;
 	// Max depth
 	if (depth <= 0) {
+		record_path_end(path_depth_limit, bounce);
+		if (features && !features->valid) {
+			*features = sample_features();
+			features->valid = true;
+		}
 		return color(0, 0, 0);
 	}
 
@@ -363,48 +741,825 @@ color renderer::ray_color(ray r, const hittable& world, int depth){
 	if (world.hit(r, 0.001, infinity, rec)) {
 		ray scattered;
 		color attenuation;
-		if (rec.mat_ptr->scatter(r, rec, attenuation, scattered))
-			return  ray_color(scattered, world, depth - 1) * attenuation;
+		bool scatters = rec.mat_ptr->scatter(r, rec, attenuation, scattered);
+		if (features && !features->valid) {
+			features->depth += rec.t * r.direction().length();
+			features->albedo = features->albedo * (scatters ? attenuation : color(0, 0, 0));
+			if (!scatters || !is_specular(*rec.mat_ptr)) {
+				features->normal = rec.normal;
+				features->valid = true;
+			}
+		}
+		if (scatters) {
+			scattered.cone_width = r.footprint(rec.t);
+			scattered.cone_spread = scattered_spread(*rec.mat_ptr, r.cone_spread);
+			RT_STAT_INC(secondary_rays);
+			return  ray_color(scattered, world, depth - 1, bounce + 1, features) * attenuation;
+		}
+		record_path_end(path_absorbed, bounce);
 		return color(0, 0, 0);
 	}
 
 	// Background
+	record_path_end(path_escaped, bounce);
 	vec3 unit_direction = unit_vector(r.direction());
 	auto t = 0.5 * (unit_direction.y() + 1.0);
-	return (1 - t) * color(1.0, 1.0, 1.0) + t * color(0.5, 0.7, 1.0);
+	color background = (1 - t) * color(1.0, 1.0, 1.0) + t * color(0.5, 0.7, 1.0);
+	if (features && !features->valid) {
+		features->albedo = features->albedo * background;
+		features->normal = vec3(0, 0, 0);
+		features->depth = 0.0;
+		features->valid = true;
+	}
+	return background;
 }
 
 
-void renderer::subrender(int start_x, int start_y, int end_x, int end_y) {
-	for (int j = end_y - 1; j >= start_y; j--)
-	{
-		for (int i = start_x; i < end_x; i++)
-		{
-			if (!Renderering) {
+// offset 非空时写入样本在像素内的位置 (x, y), 范围 [0, 1)
+color renderer::trace_sample(const render_job_settings& s, int i, int j, int sample, sample_features* features, double* offset) {
+	// 每个样本使用独立的随机序列, 结果与线程划分、中断恢复和样本区间切分无关
+	seed_random(uint64_t(j) * s.width + i, sample);
+	double dx = random_double();
+	double dy = random_double();
+	if (offset) {
+		offset[0] = dx;
+		offset[1] = dy;
+	}
+	auto u = double(i + dx) / (s.width - 1);
+	auto v = double(j + dy) / (s.height - 1);
+	ray r = s.view.get_ray(u, v);
+	r.cone_spread = s.view.pixel_spread(s.height);
+	if (features) {
+		// 反照率沿镜面链累乘, 从 1 开始
+		*features = sample_features();
+		features->albedo = color(1, 1, 1);
+	}
+	return ray_color(r, world, s.max_depth, 0, features);
+}
+
+color renderer::sample_pixel(const render_job_settings& s, int i, int j, int first_sample, int sample_count) {
+	color pixel_color = color(0, 0, 0);
+	for (int x = first_sample; x < first_sample + sample_count; x++) {
+		pixel_color += trace_sample(s, i, j, x);
+	}
+	RT_STAT_ADD(primary_rays, sample_count);
+	return pixel_color;
+}
+
+void renderer::render_band(const render_job_settings& s, int first_row, int row_count, image_stream_writer& writer) {
+	RT_TRACE_THREAD_NAME("render worker");
+	RT_TRACE_ZONE_ARG("band", first_row);
+	const render_region& r = s.region;
+	std::vector<float> rgb(size_t(r.width()) * row_count * 3);
+	float* out = rgb.data();
+	// 与 partial_buffer 相同的定点累加, 结果与合并各样本区间的部分结果逐位相同
+	const double scale = partial_buffer::resolve_scale(s.samples_per_pixel);
+	for (int j = first_row; j < first_row + row_count; j++) {
+		for (int i = r.x0; i < r.x1; i++) {
+			int64_t sum[3] = { 0, 0, 0 };
+			for (int x = 0; x < s.samples_per_pixel; x++) {
+				color c = trace_sample(s, i, j, x);
+				sum[0] += partial_buffer::quantize(c.e[0]);
+				sum[1] += partial_buffer::quantize(c.e[1]);
+				sum[2] += partial_buffer::quantize(c.e[2]);
+			}
+			RT_STAT_ADD(primary_rays, s.samples_per_pixel);
+			*out++ = static_cast<float>(sum[0] * scale);
+			*out++ = static_cast<float>(sum[1] * scale);
+			*out++ = static_cast<float>(sum[2] * scale);
+		}
+	}
+
+	// 写入器只包含区域内的像素
+	writer.submit(first_row - r.y0, row_count, std::move(rgb));
+}
+
+void renderer::commit_bands(const render_job_settings& s, image_stream_writer& writer, bool bottom_up, std::vector<std::future<void>>& futures) {
+	// 按文件行序提交, 行带大致按写出顺序完成, 写线程只需要很少的重排
+	const render_region& r = s.region;
+	for (int written = 0; written < r.height(); written += s.band_height) {
+		int row_count = std::min(s.band_height, r.height() - written);
+		int first_row = r.y0 + (bottom_up ? written : r.height() - written - row_count);
+		futures.push_back(ThreadPool.Commit(&renderer::render_band, this, std::cref(s), first_row, row_count, std::ref(writer)));
+	}
+}
+
+bool renderer::render_to_file(const std::string& path, int width, int height) {
+	ThreadPool.Init();
+	const int thread_count = ThreadPool.GetThreadCount();
+	render_job_settings settings = make_job_settings(camera(current_camera(), double(width) / height), width, height, samples_per_pixel);
+	const render_region& r = settings.region;
+
+	if (!filter.is_box()) {
+		// 样本会分摊到相邻行带, 行带完成时还不能写出; 整帧累积后一次写出
+		reset_render_stats();
+		double start = IPlatform::GetInstance()->PlatformGetAbsoluteTime();
+		render_job single(settings);
+		single.start(ThreadPool,
+			[this](render_job& j, int first_row, int row_count, int first_sample, int sample_count) {
+				accumulate_band(j, first_row, row_count, first_sample, sample_count);
+			},
+			nullptr);
+		single.wait();
+		ThreadPool.Shutdown();
+
+		framebuffer full(width, height);
+		single.accum().resolve(full, r.x0, r.y0, r.x1, r.y1);
+		framebuffer result(r.width(), r.height());
+		for (int y = 0; y < r.height(); y++) {
+			std::copy(full.row(r.y0 + y) + 3 * r.x0, full.row(r.y0 + y) + 3 * r.x1, result.row(y));
+		}
+		bool ok = write_image(path, result, thread_count);
+		double elapsed = IPlatform::GetInstance()->PlatformGetAbsoluteTime() - start;
+		std::cout << "Rendered " << path << " (" << r.width() << "x" << r.height() << ", " << reconstruction_filter::name(filter.type())
+			<< " filter) in " << elapsed << " s" << std::endl;
+		write_stats(elapsed);
+		return ok;
+	}
+
+	// 每个线程最多领先两个行带, 常驻内存约为 (2 * 线程数 + 2) 个行带
+	image_stream_writer writer(path, r.width(), r.height(), 2 * thread_count + 2);
+	if (!writer.open()) {
+		return false;
+	}
+
+	reset_render_stats();
+	double start = IPlatform::GetInstance()->PlatformGetAbsoluteTime();
+	std::vector<std::future<void>> futures;
+	commit_bands(settings, writer, image_format_from_path(path) == image_format::pfm, futures);
+	for (auto& future : futures) {
+		future.wait();
+	}
+	ThreadPool.Shutdown();
+
+	bool ok = writer.close();
+	double elapsed = IPlatform::GetInstance()->PlatformGetAbsoluteTime() - start;
+	std::cout << "Rendered " << path << " (" << r.width() << "x" << r.height() << ") in " << elapsed << " s" << std::endl;
+	write_stats(elapsed);
+	return ok;
+}
+
+// 在扩展名前插入后缀, 如 out.png -> out_albedo.png
+static std::string path_with_suffix(const std::string& path, const std::string& suffix) {
+	size_t dot = path.find_last_of('.');
+	size_t slash = path.find_last_of("/\\");
+	if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) {
+		dot = path.size();
+	}
+	return path.substr(0, dot) + suffix + path.substr(dot);
+}
+
+// 帧序列的输出路径: 第一个 %d (可带宽度, 如 %04d) 替换为帧号, 没有时在扩展名前插入 _0001
+static std::string sequence_frame_path(const std::string& pattern, int frame) {
+	char number[32];
+	size_t percent = pattern.find('%');
+	if (percent != std::string::npos) {
+		size_t end = percent + 1;
+		int digits = 0;
+		while (end < pattern.size() && isdigit((unsigned char)pattern[end])) {
+			digits = digits * 10 + (pattern[end++] - '0');
+		}
+		if (end < pattern.size() && pattern[end] == 'd') {
+			snprintf(number, sizeof(number), "%0*d", std::min(digits, 16), frame);
+			return pattern.substr(0, percent) + number + pattern.substr(end + 1);
+		}
+	}
+
+	snprintf(number, sizeof(number), "_%04d", frame);
+	return path_with_suffix(pattern, number);
+}
+
+bool renderer::render_sequence(const std::string& pattern, int width, int height, int first_frame, int last_frame) {
+	// 行带边渲染边写出, 只支持盒式滤波
+	if (!filter.is_box()) {
+		std::cout << "Frame sequences support only the box filter" << std::endl;
+		return false;
+	}
+	if (first_frame < 0 || last_frame < first_frame) {
+		std::cout << "Invalid frame range " << first_frame << ":" << last_frame << std::endl;
+		return false;
+	}
+
+	const camera_path path = animation.empty() ? camera_path::orbit(current_camera(), last_frame + 1) : animation;
+
+	ThreadPool.Init();
+	const int thread_count = ThreadPool.GetThreadCount();
+
+	// 一帧在途的状态; 行带任务引用其中的 settings 与 writer, 所有任务完成前不能释放
+	struct frame_state {
+		std::string path;
+		render_job_settings settings;
+		std::unique_ptr<image_stream_writer> writer;
+		std::vector<std::future<void>> futures;
+	};
+
+	auto finish_frame = [](frame_state& f) {
+		for (auto& future : f.futures) {
+			future.wait();
+		}
+		return f.writer->close();
+	};
+
+	reset_render_stats();
+	double start = IPlatform::GetInstance()->PlatformGetAbsoluteTime();
+	double last_finish = start;
+	int finished = 0;
+	bool ok = true;
+
+	// 同时最多两帧在途: 提交完第 k + 1 帧的行带后才等待第 k 帧,
+	// 线程池按提交顺序执行, 第 k 帧最后几个行带渲染与编码期间其余线程已经开始渲染下一帧
+	std::unique_ptr<frame_state> previous;
+	for (int frame = first_frame; frame <= last_frame && ok; frame++) {
+		RT_TRACE_ZONE_ARG("frame", frame);
+		auto current = std::make_unique<frame_state>();
+		current->path = sequence_frame_path(pattern, frame);
+		current->settings = make_job_settings(camera(path.evaluate(frame), double(width) / height), width, height, samples_per_pixel);
+		const render_region& r = current->settings.region;
+		current->writer = std::make_unique<image_stream_writer>(current->path, r.width(), r.height(), 2 * thread_count + 2);
+		if (!current->writer->open()) {
+			ok = false;
+			break;
+		}
+		commit_bands(current->settings, *current->writer, image_format_from_path(current->path) == image_format::pfm, current->futures);
+
+		if (previous) {
+			ok = finish_frame(*previous);
+			double now = IPlatform::GetInstance()->PlatformGetAbsoluteTime();
+			std::cout << "Rendered " << previous->path << " in " << now - last_finish << " s" << std::endl;
+			last_finish = now;
+			finished++;
+		}
+		previous = std::move(current);
+	}
+	if (previous) {
+		ok = finish_frame(*previous) && ok;
+		double now = IPlatform::GetInstance()->PlatformGetAbsoluteTime();
+		std::cout << "Rendered " << previous->path << " in " << now - last_finish << " s" << std::endl;
+		finished++;
+	}
+	ThreadPool.Shutdown();
+
+	double elapsed = IPlatform::GetInstance()->PlatformGetAbsoluteTime() - start;
+	std::cout << "Rendered " << finished << " frames (" << width << "x" << height << ") in " << elapsed << " s, "
+		<< (elapsed > 0.0 ? finished * 3600.0 / elapsed : 0.0) << " frames/hour" << std::endl;
+	write_stats(elapsed);
+	return ok;
+}
+
+void renderer::render_feature_band(const render_job_settings& s, int first_row, int row_count, framebuffer& image, feature_buffers& features) {
+	RT_TRACE_THREAD_NAME("render worker");
+	RT_TRACE_ZONE_ARG("band", first_row);
+	for (int j = first_row; j < first_row + row_count; j++) {
+		for (int i = 0; i < s.width; i++) {
+			color sum(0, 0, 0);
+			sample_features feature_sum;
+			double luminance_sq_sum = 0.0;
+			for (int x = 0; x < s.samples_per_pixel; x++) {
+				sample_features f;
+				color c = trace_sample(s, i, j, x, &f);
+				double l = 0.2126 * c.x() + 0.7152 * c.y() + 0.0722 * c.z();
+				sum += c;
+				luminance_sq_sum += l * l;
+				feature_sum.albedo += f.albedo;
+				feature_sum.normal += f.normal;
+				feature_sum.depth += f.depth;
+			}
+			RT_STAT_ADD(primary_rays, s.samples_per_pixel);
+			image.set(i, j, sum / s.samples_per_pixel);
+			features.set_pixel(i, j, feature_sum, sum, luminance_sq_sum, s.samples_per_pixel);
+		}
+	}
+}
+
+bool renderer::render_denoised(const std::string& path, int width, int height, bool write_aovs) {
+	const int band_height = 16;
+
+	// 降噪需要整帧的特征, 且每像素为各样本的平均值; 区域与重建滤波都不支持
+	if (!region.empty() || !filter.is_box()) {
+		std::cout << "Denoising does not support --region or non-box --filter" << std::endl;
+		return false;
+	}
+
+	framebuffer noisy(width, height);
+	feature_buffers features(width, height);
+
+	ThreadPool.Init();
+	const int thread_count = ThreadPool.GetThreadCount();
+
+	reset_render_stats();
+	double start = IPlatform::GetInstance()->PlatformGetAbsoluteTime();
+	render_job_settings settings = make_job_settings(camera(current_camera(), double(width) / height), width, height, samples_per_pixel);
+
+	// 各行带写入帧缓冲中互不重叠的行, 不需要加锁
+	std::vector<std::future<void>> futures;
+	for (int first_row = 0; first_row < height; first_row += band_height) {
+		int row_count = std::min(band_height, height - first_row);
+		futures.push_back(ThreadPool.Commit(&renderer::render_feature_band, this, std::cref(settings), first_row, row_count, std::ref(noisy), std::ref(features)));
+	}
+	for (auto& future : futures) {
+		future.wait();
+	}
+	ThreadPool.Shutdown();
+
+	double rendered = IPlatform::GetInstance()->PlatformGetAbsoluteTime();
+	framebuffer result;
+	denoise(noisy, features, result, denoise_settings(), thread_count);
+	double denoised = IPlatform::GetInstance()->PlatformGetAbsoluteTime();
+
+	bool ok = write_image(path, result, thread_count);
+	if (write_aovs) {
+		// 法线映射到 [0, 1], 深度按最大值归一化为灰度
+		framebuffer normal(width, height);
+		framebuffer depth(width, height);
+		float max_depth = 0.0f;
+		for (float z : features.depth) {
+			max_depth = std::max(max_depth, z);
+		}
+		for (int y = 0; y < height; y++) {
+			for (int x = 0; x < width; x++) {
+				color n = features.normal.get(x, y);
+				normal.set(x, y, n.near_zero() ? color(0, 0, 0) : 0.5 * (n + color(1, 1, 1)));
+				double z = max_depth > 0.0f ? features.depth[size_t(y) * width + x] / max_depth : 0.0;
+				depth.set(x, y, color(z, z, z));
+			}
+		}
+		ok = write_image(path_with_suffix(path, "_noisy"), noisy, thread_count) && ok;
+		ok = write_image(path_with_suffix(path, "_albedo"), features.albedo, thread_count) && ok;
+		ok = write_image(path_with_suffix(path, "_normal"), normal, thread_count) && ok;
+		ok = write_image(path_with_suffix(path, "_depth"), depth, thread_count) && ok;
+	}
+
+	double elapsed = IPlatform::GetInstance()->PlatformGetAbsoluteTime() - start;
+	std::cout << "Rendered " << path << " (" << width << "x" << height << ", " << samples_per_pixel << " spp) in "
+		<< rendered - start << " s, denoised in " << denoised - rendered << " s" << std::endl;
+	write_stats(elapsed);
+	return ok;
+}
+
+void renderer::accumulate_band(render_job& j, int first_row, int row_count, int first_sample, int sample_count) {
+	RT_TRACE_THREAD_NAME("render worker");
+	RT_TRACE_ZONE_ARG("band", first_row);
+	const render_job_settings& s = j.settings();
+	accumulation_buffer& accum = j.accum();
+	if (s.filter.is_box()) {
+		for (int y = first_row; y < first_row + row_count; y++) {
+			for (int x = s.region.x0; x < s.region.x1; x++) {
+				if (j.cancelled()) {
+					return;
+				}
+				accum.add(x, y, sample_pixel(s, x, y, first_sample, sample_count), sample_count);
+			}
+		}
+		return;
+	}
+
+	// 样本按滤波器分摊到邻近像素, 先累积在行带自己的缓冲中
+	film_band& band = j.band(first_row);
+	band.reset(s.filter, s.width, s.height, first_row, row_count);
+	for (int y = first_row; y < first_row + row_count; y++) {
+		for (int x = s.region.x0; x < s.region.x1; x++) {
+			if (j.cancelled()) {
+				return;
+			}
+			for (int sample = first_sample; sample < first_sample + sample_count; sample++) {
+				double offset[2];
+				color c = trace_sample(s, x, y, sample, nullptr, offset);
+				band.add_sample(x, y, offset[0], offset[1], c);
+			}
+			RT_STAT_ADD(primary_rays, sample_count);
+		}
+	}
+	band.merge_rows(accum);
+}
+
+bool renderer::render_progressive(const std::string& path, int width, int height, const std::string& checkpoint_path, bool resume, double checkpoint_interval) {
+	render_job_settings settings = make_job_settings(camera(current_camera(), double(width) / height), width, height, 8);
+	// 检查点不记录区域, 渐进模式总是渲染整幅图像
+	settings.region = { 0, 0, width, height };
+
+	accumulation_buffer restored;
+	checkpoint_info info;
+	if (resume) {
+		if (!load_checkpoint(checkpoint_path, info, restored)) {
+			return false;
+		}
+		if (info.width != width || info.height != height || info.max_depth != max_depth ||
+			info.filter != static_cast<int32_t>(filter.type()) || info.filter_radius != static_cast<float>(filter.radius())) {
+			std::cout << "Checkpoint does not match the current render settings: " << checkpoint_path << std::endl;
+			return false;
+		}
+		if (info.scene_hash != scene_hash()) {
+			std::cout << "Checkpoint was rendered from a different scene or camera: " << checkpoint_path << std::endl;
+			return false;
+		}
+		std::cout << "Resuming " << checkpoint_path << " at sample " << info.next_sample << "/" << info.samples_per_pixel << std::endl;
+
+		// 沿用检查点中的目标样本数与 pass 大小, 保证累加顺序与不中断时相同
+		settings.samples_per_pixel = info.samples_per_pixel;
+		settings.samples_per_pass = info.samples_per_pass;
+	}
+	else {
+		info.width = width;
+		info.height = height;
+		info.samples_per_pixel = settings.samples_per_pixel;
+		info.samples_per_pass = settings.samples_per_pass;
+		info.max_depth = max_depth;
+		info.filter = static_cast<int32_t>(filter.type());
+		info.filter_radius = static_cast<float>(filter.radius());
+		info.next_sample = 0;
+		info.scene_hash = scene_hash();
+	}
+
+	render_job progressive(settings);
+	if (resume) {
+		progressive.accum() = std::move(restored);
+	}
+
+	ThreadPool.Init();
+	reset_render_stats();
+	double start = IPlatform::GetInstance()->PlatformGetAbsoluteTime();
+	double last_checkpoint = start;
+
+	// 检查点在后台线程写出; 上一次还没写完时跳过本次, 不让渲染等待磁盘
+	std::future<bool> pending_checkpoint;
+	auto on_pass = [&](render_job& j) {
+		info.next_sample = j.completed_samples();
+		double now = IPlatform::GetInstance()->PlatformGetAbsoluteTime();
+		bool writer_idle = !pending_checkpoint.valid() ||
+			pending_checkpoint.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+		if (checkpoint_path.empty() || !writer_idle || now - last_checkpoint < checkpoint_interval ||
+			info.next_sample >= info.samples_per_pixel) {
+			return;
+		}
+		if (pending_checkpoint.valid()) {
+			pending_checkpoint.get();
+		}
+
+		// pass 之间所有像素的样本数一致; 只在此处复制一份快照, 写盘与下一个 pass 并行
+		auto snapshot = std::make_shared<accumulation_buffer>(j.accum());
+		checkpoint_info snapshot_info = info;
+		pending_checkpoint = std::async(std::launch::async, [checkpoint_path, snapshot_info, snapshot]() {
+			return save_checkpoint(checkpoint_path, snapshot_info, *snapshot);
+		});
+		last_checkpoint = now;
+	};
+
+	progressive.start(ThreadPool,
+		[this](render_job& j, int first_row, int row_count, int first_sample, int sample_count) {
+			accumulate_band(j, first_row, row_count, first_sample, sample_count);
+		},
+		on_pass, info.next_sample);
+	progressive.wait();
+
+	if (pending_checkpoint.valid()) {
+		pending_checkpoint.get();
+	}
+	ThreadPool.Shutdown();
+
+	// 保存最终状态; 恢复时沿用检查点中的目标样本数, 已完成的检查点恢复后直接输出图像
+	info.next_sample = progressive.completed_samples();
+	if (!checkpoint_path.empty()) {
+		save_checkpoint(checkpoint_path, info, progressive.accum());
+	}
+
+	framebuffer result(width, height);
+	progressive.accum().resolve(result);
+	bool ok = write_image(path, result);
+	double elapsed = IPlatform::GetInstance()->PlatformGetAbsoluteTime() - start;
+	std::cout << "Rendered " << path << " (" << width << "x" << height << ", " << info.samples_per_pixel << " spp) in " << elapsed << " s" << std::endl;
+	write_stats(elapsed);
+	return ok;
+}
+
+void renderer::write_stats(double seconds) {
+	texture_cache& textures = texture_cache::instance();
+	if (textures.image_count() > 0) {
+		texture_cache_stats t = textures.stats();
+		std::cout << "Texture cache: " << t.hits << " hits, " << t.misses << " misses, " << t.evictions << " evictions, "
+			<< (t.peak_bytes >> 20) << " / " << (textures.get_budget() >> 20) << " MB peak" << std::endl;
+	}
+
+	if (stats_path.empty()) {
+		return;
+	}
+
+#ifdef RENDER_STATS_ENABLED
+	render_stats stats = collect_render_stats();
+	if (stats.write_json(stats_path, seconds)) {
+		std::cout << "Saved stats " << stats_path << std::endl;
+	}
+#else
+	std::cout << "Render statistics are disabled in this build" << std::endl;
+#endif
+}
+
+void renderer::render_tile(const render_job_settings& s, int first_row, int row_count, int first_sample, int sample_count, accumulation_buffer& tile) {
+	RT_TRACE_ZONE_ARG("tile", first_row);
+	tile.resize(s.width, row_count);
+
+	// 每行一个任务, 写入 tile 中从 0 开始的行
+	std::vector<std::future<void>> futures;
+	for (int row = 0; row < row_count; row++) {
+		futures.push_back(ThreadPool.Commit([this, &s, &tile, row, first_row, first_sample, sample_count]() {
+			RT_TRACE_THREAD_NAME("render worker");
+			for (int i = 0; i < s.width; i++) {
+				tile.add(i, row, sample_pixel(s, i, first_row + row, first_sample, sample_count), sample_count);
+			}
+		}));
+	}
+	for (auto& future : futures) {
+		future.wait();
+	}
+}
+
+bool renderer::run_coordinator(uint16_t port, const std::string& path, int width, int height, const std::string& scene_path, double worker_timeout) {
+	const int tile_height = 16;
+
+	// tile 结果按样本数平均后合并, 只支持盒式滤波
+	if (!filter.is_box()) {
+		std::cout << "Distributed rendering supports only the box filter" << std::endl;
+		return false;
+	}
+
+	Socket listener;
+	if (!listener.Listen(port)) {
+		std::cout << "Failed to listen on port " << port << std::endl;
+		return false;
+	}
+
+	// 工作进程按协调者的相机与采样设置渲染, 场景从同一路径加载 (空路径为默认场景)
+	std::vector<char> job_message(sizeof(net_job) + scene_path.size());
+	net_job job = {};
+	job.width = width;
+	job.height = height;
+	job.samples_per_pixel = samples_per_pixel;
+	job.max_depth = max_depth;
+	double camera_values[14] = {
+		fov,
+		camera_pos.x(), camera_pos.y(), camera_pos.z(),
+		lookat.x(), lookat.y(), lookat.z(),
+		worldup.x(), worldup.y(), worldup.z(),
+		aperture, dist_to_focus,
+		shutter_open, shutter_close
+	};
+	std::memcpy(job.camera, camera_values, sizeof(camera_values));
+	job.scene_path_size = (uint32_t)scene_path.size();
+	std::memcpy(job_message.data(), &job, sizeof(job));
+	std::memcpy(job_message.data() + sizeof(job), scene_path.data(), scene_path.size());
+
+	accumulation_buffer accum(width, height);
+	tile_scheduler scheduler(height, tile_height, samples_per_pixel);
+	std::cout << "Coordinator listening on port " << port << ", " << scheduler.total() << " tiles" << std::endl;
+	double start = IPlatform::GetInstance()->PlatformGetAbsoluteTime();
+
+	// 每个工作进程一个服务线程; 连接断开或超时时把手上的 tile 放回队列
+	auto serve = [&](std::shared_ptr<Socket> worker) {
+		net_message type;
+		std::vector<char> payload;
+		worker->SetRecvTimeout(worker_timeout);
+		if (!recv_message(*worker, type, payload) || type != net_message::hello ||
+			!send_message(*worker, net_message::job, job_message.data(), job_message.size())) {
+			scheduler.worker_left();
+			return;
+		}
+
+		net_tile tile;
+		while (scheduler.acquire(tile)) {
+			if (!send_message(*worker, net_message::tile, &tile, sizeof(tile)) ||
+				!recv_message(*worker, type, payload) || type != net_message::result ||
+				!read_tile_result(payload, width, tile, accum)) {
+				std::cout << "Worker lost, re-dispatching tile " << tile.tile_id << std::endl;
+				scheduler.release(tile);
+				scheduler.worker_left();
 				return;
 			}
+			scheduler.complete(tile);
+		}
+		send_message(*worker, net_message::done);
+		scheduler.worker_left();
+	};
 
-			color pixel_color = color(0, 0, 0);
-			for (int x = 0; x < samples_per_pixel; x++) {
-				auto u = double(i + random_double()) / (WIDTH - 1);
-				auto v = double(j + random_double()) / (HEIGHT - 1);
-				ray r = cam.get_ray(u, v);
-				pixel_color += ray_color(r, world, max_depth);
+	std::atomic<bool> stopping(false);
+	std::vector<std::thread> servers;
+	std::thread acceptor([&]() {
+		while (true) {
+			auto worker = std::make_shared<Socket>(listener.Accept());
+			if (!worker->IsValid() || stopping || scheduler.finished()) {
+				break;
 			}
+			std::cout << "Worker connected" << std::endl;
+			// 在启动服务线程之前计入, 主线程不会在连接建立与服务线程启动之间误判为没有工作进程
+			scheduler.worker_joined();
+			servers.emplace_back(serve, worker);
+		}
+	});
+
+	// 所有工作进程断开 (或一直没有工作进程连接) 超过 worker_timeout 秒时放弃, 不再无限等待
+	bool finished = scheduler.wait_finished(worker_timeout);
+	if (!finished) {
+		std::cout << "No workers connected for " << worker_timeout << " s with " << scheduler.total() - scheduler.completed()
+			<< " tiles outstanding, giving up" << std::endl;
+	}
+
+	// 结束后连接一次自己, 唤醒阻塞在 Accept 上的线程
+	stopping = true;
+	Socket wake;
+	wake.Connect("127.0.0.1", port);
+	acceptor.join();
+	wake.Close();
+	for (auto& server : servers) {
+		server.join();
+	}
+
+	if (!finished) {
+		return false;
+	}
+
+	framebuffer result(width, height);
+	accum.resolve(result);
+	bool ok = write_image(path, result);
+	double elapsed = IPlatform::GetInstance()->PlatformGetAbsoluteTime() - start;
+	std::cout << "Rendered " << path << " (" << width << "x" << height << ") across workers in " << elapsed << " s" << std::endl;
+	return ok;
+}
+
+bool renderer::run_worker(const std::string& host, uint16_t port) {
+	if (!filter.is_box()) {
+		std::cout << "Distributed rendering supports only the box filter" << std::endl;
+		return false;
+	}
+
+	Socket coordinator;
+	for (int attempt = 0; !coordinator.Connect(host, port); attempt++) {
+		if (attempt >= 50) {
+			std::cout << "Failed to connect to coordinator " << host << ":" << port << std::endl;
+			return false;
+		}
+		IPlatform::GetInstance()->PlatformSleep(200);
+	}
 
-			int index = (j * WIDTH + i) * 4;
-			// Color
-			for (int t = 0; t < 3; t++) {
-				pixels_mutex.lock();
-				pixels[index] = convert_color(pixel_color[t], samples_per_pixel);
-				pixels_mutex.unlock();
-				index++;
+	net_message type;
+	std::vector<char> payload;
+	if (!send_message(coordinator, net_message::hello) ||
+		!recv_message(coordinator, type, payload) || type != net_message::job || payload.size() < sizeof(net_job)) {
+		std::cout << "Coordinator did not send a job" << std::endl;
+		return false;
+	}
+
+	net_job job;
+	std::memcpy(&job, payload.data(), sizeof(job));
+	if (payload.size() != sizeof(net_job) + job.scene_path_size) {
+		return false;
+	}
+	std::string scene_path(payload.data() + sizeof(net_job), job.scene_path_size);
+	if (!scene_path.empty() && !load_scene(scene_path)) {
+		return false;
+	}
+
+	fov = (float)job.camera[0];
+	camera_pos = vec3(job.camera[1], job.camera[2], job.camera[3]);
+	lookat = vec3(job.camera[4], job.camera[5], job.camera[6]);
+	worldup = vec3(job.camera[7], job.camera[8], job.camera[9]);
+	aperture = (float)job.camera[10];
+	dist_to_focus = job.camera[11];
+	shutter_open = job.camera[12];
+	shutter_close = job.camera[13];
+	samples_per_pixel = job.samples_per_pixel;
+	max_depth = job.max_depth;
+	render_job_settings settings = make_job_settings(
+		camera(current_camera(), double(job.width) / job.height),
+		job.width, job.height, samples_per_pixel);
+
+	ThreadPool.Init();
+	int tiles = 0;
+	accumulation_buffer tile_accum;
+	while (recv_message(coordinator, type, payload) && type == net_message::tile && payload.size() == sizeof(net_tile)) {
+		net_tile tile;
+		std::memcpy(&tile, payload.data(), sizeof(tile));
+		render_tile(settings, tile.first_row, tile.row_count, tile.first_sample, tile.sample_count, tile_accum);
+		if (!send_tile_result(coordinator, tile, tile_accum)) {
+			break;
+		}
+		tiles++;
+	}
+	ThreadPool.Shutdown();
+
+	std::cout << "Worker finished " << tiles << " tiles" << std::endl;
+	return type == net_message::done;
+}
+
+bool renderer::render_sample_range(const std::string& path, int width, int height, int first_sample, int end_sample) {
+	const int band_height = 16;
+	first_sample = std::max(0, first_sample);
+	// 部分结果逐像素累加各自的样本, 只支持盒式滤波
+	if (!filter.is_box()) {
+		std::cout << "Sample-range rendering supports only the box filter" << std::endl;
+		return false;
+	}
+	if (end_sample <= first_sample) {
+		std::cout << "Empty sample range [" << first_sample << ", " << end_sample << ")" << std::endl;
+		return false;
+	}
+
+	render_job_settings settings = make_job_settings(
+		camera(current_camera(), double(width) / height),
+		width, height, samples_per_pixel);
+	partial_buffer partial(width, height);
+
+	ThreadPool.Init();
+	reset_render_stats();
+	double start = IPlatform::GetInstance()->PlatformGetAbsoluteTime();
+
+	// 行带互不重叠, 每个像素的样本都在同一个任务里按序累加
+	std::vector<std::future<void>> futures;
+	for (int first_row = 0; first_row < height; first_row += band_height) {
+		int row_count = std::min(band_height, height - first_row);
+		futures.push_back(ThreadPool.Commit([this, &settings, &partial, first_row, row_count, first_sample, end_sample]() {
+			RT_TRACE_THREAD_NAME("render worker");
+			RT_TRACE_ZONE_ARG("band", first_row);
+			for (int j = first_row; j < first_row + row_count; j++) {
+				for (int i = 0; i < settings.width; i++) {
+					for (int x = first_sample; x < end_sample; x++) {
+						partial.add_sample(i, j, trace_sample(settings, i, j, x));
+					}
+					RT_STAT_ADD(primary_rays, end_sample - first_sample);
+				}
 			}
+		}));
+	}
+	for (auto& future : futures) {
+		future.wait();
+	}
+	ThreadPool.Shutdown();
+
+	partial_info info;
+	info.width = width;
+	info.height = height;
+	info.first_sample = first_sample;
+	info.end_sample = end_sample;
+	info.max_depth = max_depth;
+	double camera_values[14] = {
+		fov,
+		camera_pos.x(), camera_pos.y(), camera_pos.z(),
+		lookat.x(), lookat.y(), lookat.z(),
+		worldup.x(), worldup.y(), worldup.z(),
+		aperture, dist_to_focus,
+		shutter_open, shutter_close
+	};
+	std::memcpy(info.camera, camera_values, sizeof(camera_values));
+
+	// 输出 .rtpart 时保存原始和, 否则直接解析成图像
+	bool ok;
+	if (is_partial_path(path)) {
+		ok = save_partial(path, info, partial);
+	}
+	else {
+		framebuffer result(width, height);
+		partial.resolve(result);
+		ok = write_image(path, result);
+	}
+
+	double elapsed = IPlatform::GetInstance()->PlatformGetAbsoluteTime() - start;
+	std::cout << "Rendered samples [" << first_sample << ", " << end_sample << ") to " << path << " in " << elapsed << " s" << std::endl;
+	write_stats(elapsed);
+	return ok;
+}
+
+void renderer::benchmark_accelerators(const std::vector<int>& sizes, int width, int height, int samples) {
+	const sphere_accelerator types[2] = { sphere_accelerator::bvh, sphere_accelerator::grid };
+	const char* names[2] = { "bvh", "grid" };
+
+	ThreadPool.Init();
+	render_job_settings settings = make_job_settings(
+		camera(current_camera(), double(width) / height), width, height, samples);
+	IPlatform* platform = IPlatform::GetInstance();
+
+	std::cout << "size  spheres  accelerator  build(ms)  trace(s)  mean" << std::endl;
+	for (int size : sizes) {
+		// 两种结构使用同一组球, 只重建加速结构
+		seed_random(size, 0);
+		world = init_scene(size);
 
-			// Alpha 
-			pixels[index] = convert_color(1.0f, 1);
+		for (int k = 0; k < 2; k++) {
+			double start = platform->PlatformGetAbsoluteTime();
+			spheres->set_accelerator(types[k]);
+			double built = platform->PlatformGetAbsoluteTime();
+
+			accumulation_buffer image;
+			render_tile(settings, 0, height, 0, samples, image);
+			double traced = platform->PlatformGetAbsoluteTime();
+
+			// 平均亮度用于确认两种结构的结果一致
+			double mean = 0.0;
+			for (double v : image.sum_data()) mean += v;
+			mean /= double(image.sum_data().size()) * samples;
+
+			std::cout << size << "  " << spheres->size() << "  " << names[k] << "  "
+				<< (built - start) * 1000.0 << "  " << (traced - built) << "  " << mean << std::endl;
 		}
 	}
+	ThreadPool.Shutdown();
 
-	std::cout << "thread: " << std::this_thread::get_id() << " finished.\n";
+	// 恢复之前选择的结构
+	spheres->set_accelerator(accelerator);
 }
@@ -0,0 +1,188 @@
+#include "sampling_benchmark.h"
+#include "rtweekend.h"
+
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+
+namespace {
+	// 每维 8 个等概率区间, 共 64 箱, 自由度 63; p = 1e-4 时的卡方临界值约为 110
+	const int bins = 8;
+	const double chi2_limit = 110.0;
+	const double mean_limit = 0.01;
+
+	// 原先的拒绝采样, 作为对照
+	vec3 rejection_in_unit_sphere() {
+		while (true) {
+			auto p = vec3::random(-1, 1);
+			if (p.length_squared() > 1) continue;
+			return p;
+		}
+	}
+
+	vec3 rejection_unit_vector() {
+		return unit_vector(rejection_in_unit_sphere());
+	}
+
+	vec3 rejection_in_unit_disk() {
+		while (true) {
+			auto p = vec3(random_double(-1, 1), random_double(-1, 1), 0);
+			if (p.length_squared() >= 1) continue;
+			return p;
+		}
+	}
+
+	inline int bin_of(double t) {
+		return std::min(bins - 1, std::max(0, int(t * bins)));
+	}
+
+	// 方位角对应的区间
+	inline int azimuth_bin(const vec3& p) {
+		return bin_of((std::atan2(p.y(), p.x()) + pi) / (2.0 * pi));
+	}
+
+	// 各分布到 64 个等概率箱的映射, 样本不在分布的定义域内时返回 -1
+	int disk_bin(const vec3& p) {
+		double r2 = p.x() * p.x() + p.y() * p.y();
+		if (p.z() != 0.0 || r2 > 1.0 + 1e-9) return -1;
+		return bin_of(r2) * bins + azimuth_bin(p);
+	}
+
+	int sphere_bin(const vec3& p) {
+		if (std::abs(p.length() - 1.0) > 1e-9) return -1;
+		return bin_of(0.5 * (1.0 - p.z())) * bins + azimuth_bin(p);
+	}
+
+	int ball_bin(const vec3& p) {
+		double r = p.length();
+		if (r > 1.0 + 1e-9) return -1;
+		double cos_theta = r > 0.0 ? p.z() / r : 0.0;
+		return bin_of(r * r * r) * bins + bin_of(0.5 * (1.0 - cos_theta));
+	}
+
+	// 余弦加权: 投影到圆盘上的 r^2 = 1 - z^2 均匀分布
+	int cosine_hemisphere_bin(const vec3& p) {
+		if (p.z() < 0.0 || std::abs(p.length() - 1.0) > 1e-9) return -1;
+		return bin_of(1.0 - p.z() * p.z()) * bins + azimuth_bin(p);
+	}
+
+	int uniform_hemisphere_bin(const vec3& p) {
+		if (p.z() < 0.0 || std::abs(p.length() - 1.0) > 1e-9) return -1;
+		return bin_of(p.z()) * bins + azimuth_bin(p);
+	}
+
+	struct sampler_result {
+		double ns_per_call = 0.0;
+		double draws_per_call = 0.0;
+		double chi2 = 0.0;
+		double mean_error = 0.0;
+		bool valid = true;
+		int expected_draws = 0;		// 闭式映射每次调用应消耗的随机数个数, 0 表示不检查
+	};
+
+	bool passed(const sampler_result& r) {
+		bool draws_ok = r.expected_draws == 0 || r.draws_per_call == r.expected_draws;
+		return r.valid && draws_ok && r.chi2 < chi2_limit && r.mean_error < mean_limit;
+	}
+
+	// 消耗的随机数个数由调用前后的生成器状态算出, 不在被测函数里计数
+	template <typename Sampler>
+	double time_calls(Sampler sample, int count, uint64_t& draws) {
+		seed_random(1, 0);
+		const rng_state before = thread_rng();
+		vec3 sink(0, 0, 0);
+		auto start = std::chrono::steady_clock::now();
+		for (int i = 0; i < count; i++) {
+			sink += sample();
+		}
+		auto end = std::chrono::steady_clock::now();
+		draws = random_distance(before, thread_rng());
+		// 防止循环被整体优化掉
+		if (sink.x() == 12345.678) std::cout << sink.x();
+		return std::chrono::duration<double, std::nano>(end - start).count() / count;
+	}
+
+	template <typename Sampler, typename Binner>
+	sampler_result run(Sampler sample, Binner binner, const vec3& expected_mean, int count) {
+		sampler_result result;
+		uint64_t draws = 0;
+		result.ns_per_call = time_calls(sample, count, draws);
+		result.draws_per_call = double(draws) / count;
+
+		// 分布检验使用另一段随机序列
+		seed_random(2, 0);
+		long long histogram[bins * bins] = {};
+		vec3 sum(0, 0, 0);
+		for (int i = 0; i < count; i++) {
+			vec3 p = sample();
+			int b = binner(p);
+			if (b < 0) {
+				result.valid = false;
+				continue;
+			}
+			histogram[b]++;
+			sum += p;
+		}
+
+		const double expected = double(count) / (bins * bins);
+		for (long long n : histogram) {
+			result.chi2 += (n - expected) * (n - expected) / expected;
+		}
+		vec3 error = sum / count - expected_mean;
+		result.mean_error = std::max(std::abs(error.x()), std::max(std::abs(error.y()), std::abs(error.z())));
+		return result;
+	}
+
+	void print_row(const char* name, const sampler_result& r, bool tested) {
+		char line[160];
+		if (tested) {
+			bool ok = passed(r);
+			snprintf(line, sizeof(line), "%-28s %8.2f %9.2f %9.1f %11.5f  %s", name, r.ns_per_call, r.draws_per_call,
+				r.chi2, r.mean_error, ok ? "ok" : "FAILED");
+		}
+		else {
+			snprintf(line, sizeof(line), "%-28s %8.2f %9.2f %9s %11s", name, r.ns_per_call, r.draws_per_call, "-", "-");
+		}
+		std::cout << line << std::endl;
+	}
+}
+
+bool benchmark_sampling(int count) {
+	std::cout << "routine                      ns/call  rng/call  chi2(63)  mean error" << std::endl;
+
+	auto mapped = [](vec3 (*f)(double, double)) {
+		return [=]() {
+			double u1 = random_double();
+			double u2 = random_double();
+			return f(u1, u2);
+		};
+	};
+
+	sampler_result results[5];
+	results[0] = run(random_in_unit_sphere, ball_bin, vec3(0, 0, 0), count);
+	results[1] = run(random_unit_vector, sphere_bin, vec3(0, 0, 0), count);
+	results[2] = run(random_in_unit_disk, disk_bin, vec3(0, 0, 0), count);
+	results[3] = run(mapped(sample_cosine_hemisphere), cosine_hemisphere_bin, vec3(0, 0, 2.0 / 3.0), count);
+	results[4] = run(mapped(sample_uniform_hemisphere), uniform_hemisphere_bin, vec3(0, 0, 0.5), count);
+
+	// 每次调用的随机数个数必须恰好等于映射的维数, 不能有隐藏的拒绝循环
+	const int expected_draws[5] = { 3, 2, 2, 2, 2 };
+	for (int i = 0; i < 5; i++) {
+		results[i].expected_draws = expected_draws[i];
+	}
+
+	print_row("random_in_unit_sphere", results[0], true);
+	print_row("  rejection (previous)", run(rejection_in_unit_sphere, ball_bin, vec3(0, 0, 0), count), false);
+	print_row("random_unit_vector", results[1], true);
+	print_row("  rejection (previous)", run(rejection_unit_vector, sphere_bin, vec3(0, 0, 0), count), false);
+	print_row("random_in_unit_disk", results[2], true);
+	print_row("  rejection (previous)", run(rejection_in_unit_disk, disk_bin, vec3(0, 0, 0), count), false);
+	print_row("sample_cosine_hemisphere", results[3], true);
+	print_row("sample_uniform_hemisphere", results[4], true);
+
+	bool ok = true;
+	for (const sampler_result& r : results) {
+		ok = ok && passed(r);
+	}
+	return ok;
+}
@@ -0,0 +1,252 @@
+#include "scene.h"
+#include "File.hpp"
+#include "trace.h"
+
+#include <cstring>
+#include <type_traits>
+#include <iostream>
+
+namespace {
+	const char scene_magic[8] = { 'R', 'T', 'S', 'C', 'E', 'N', 'E', '\0' };
+	const uint32_t scene_version = 2;
+	const uint32_t scene_endian_tag = 0x01020304;
+	const uint32_t scene_flag_bvh = 0x1;
+	const uint64_t section_alignment = 64;
+
+	enum scene_section {
+		section_center_x = 0,
+		section_center_y,
+		section_center_z,
+		section_radius,
+		section_material_id,
+		section_material,
+		section_bvh,
+		section_count
+	};
+
+	struct scene_header {
+		char magic[8];
+		uint32_t version;
+		uint32_t endian;
+		uint32_t flags;
+		uint32_t material_record_size;
+		uint32_t bvh_node_size;
+		int32_t samples_per_pixel;
+		int32_t max_depth;
+		uint32_t reserved;
+
+		// vfov, lookfrom[3], lookat[3], vup[3], aperture, focus_dist
+		double camera[12];
+
+		uint64_t sphere_count;
+		uint64_t material_count;
+		uint64_t bvh_node_count;
+		uint64_t section_offset[section_count];
+		uint64_t section_size[section_count];
+	};
+
+	static_assert(std::is_trivially_copyable<material>::value, "material records are stored verbatim");
+	static_assert(std::is_trivially_copyable<bvh_node>::value, "bvh nodes are stored verbatim");
+
+	uint64_t align_up(uint64_t value) {
+		return (value + section_alignment - 1) & ~(section_alignment - 1);
+	}
+}
+
+bool save_scene_binary(const std::string& path, const scene& s) {
+	if (!s.spheres) {
+		return false;
+	}
+
+	const sphere_set_view& view = s.spheres->view();
+	if (view.motion_x) {
+		std::cout << "Binary scenes do not store moving spheres, use the text format: " << path << std::endl;
+		return false;
+	}
+	for (uint32_t i = 0; i < view.material_count; i++) {
+		if (view.materials[i].texture_id != no_texture) {
+			std::cout << "Binary scenes do not store textures, use the text format: " << path << std::endl;
+			return false;
+		}
+	}
+	const void* sections[section_count] = {
+		view.center_x, view.center_y, view.center_z, view.radius,
+		view.material_ids, view.materials, view.nodes
+	};
+
+	scene_header header;
+	std::memset(&header, 0, sizeof(header));
+	std::memcpy(header.magic, scene_magic, sizeof(scene_magic));
+	header.version = scene_version;
+	header.endian = scene_endian_tag;
+	header.flags = view.node_count > 0 ? scene_flag_bvh : 0;
+	header.material_record_size = sizeof(material);
+	header.bvh_node_size = sizeof(bvh_node);
+	header.samples_per_pixel = s.settings.samples_per_pixel;
+	header.max_depth = s.settings.max_depth;
+
+	const camera_settings& c = s.cam;
+	double camera[12] = {
+		c.vfov,
+		c.lookfrom.x(), c.lookfrom.y(), c.lookfrom.z(),
+		c.lookat.x(), c.lookat.y(), c.lookat.z(),
+		c.vup.x(), c.vup.y(), c.vup.z(),
+		c.aperture, c.focus_dist
+	};
+	std::memcpy(header.camera, camera, sizeof(camera));
+
+	header.sphere_count = view.count;
+	header.material_count = view.material_count;
+	header.bvh_node_count = view.node_count;
+	header.section_size[section_center_x] = view.count * sizeof(double);
+	header.section_size[section_center_y] = view.count * sizeof(double);
+	header.section_size[section_center_z] = view.count * sizeof(double);
+	header.section_size[section_radius] = view.count * sizeof(double);
+	header.section_size[section_material_id] = view.count * sizeof(uint32_t);
+	header.section_size[section_material] = view.material_count * sizeof(material);
+	header.section_size[section_bvh] = view.node_count * sizeof(bvh_node);
+
+	uint64_t offset = align_up(sizeof(scene_header));
+	for (int i = 0; i < section_count; i++) {
+		header.section_offset[i] = offset;
+		offset = align_up(offset + header.section_size[i]);
+	}
+
+	File file(path);
+	if (!file.WriteBytes((const char*)&header, sizeof(header), std::ios::binary | std::ios::trunc)) {
+		return false;
+	}
+
+	static const char padding[section_alignment] = {};
+	uint64_t written = sizeof(header);
+	for (int i = 0; i < section_count; i++) {
+		uint64_t pad = header.section_offset[i] - written;
+		if (pad > 0 && !file.WriteBytes(padding, pad, std::ios::binary | std::ios::app)) {
+			return false;
+		}
+		if (header.section_size[i] > 0 &&
+			!file.WriteBytes((const char*)sections[i], header.section_size[i], std::ios::binary | std::ios::app)) {
+			return false;
+		}
+		written = header.section_offset[i] + header.section_size[i];
+	}
+
+	return true;
+}
+
+bool load_scene_binary(const std::string& path, scene& s) {
+	auto file = std::make_shared<MappedFile>(path);
+	if (!file->Map()) {
+		std::cout << "Failed to map scene file: " << path << std::endl;
+		return false;
+	}
+
+	if (file->GetSize() < sizeof(scene_header)) {
+		std::cout << "Scene file is truncated: " << path << std::endl;
+		return false;
+	}
+
+	const unsigned char* base = file->GetData();
+	const scene_header* header = (const scene_header*)base;
+	if (std::memcmp(header->magic, scene_magic, sizeof(scene_magic)) != 0 ||
+		header->endian != scene_endian_tag ||
+		header->version != scene_version ||
+		header->material_record_size != sizeof(material) ||
+		header->bvh_node_size != sizeof(bvh_node)) {
+		std::cout << "Unsupported scene file: " << path << std::endl;
+		return false;
+	}
+
+	// 数量来自文件, 先限制在文件大小之内, 避免下面的乘法溢出
+	const uint64_t file_size = file->GetSize();
+	if (header->sphere_count > file_size / sizeof(double) ||
+		header->material_count > file_size / sizeof(material) ||
+		header->bvh_node_count > file_size / sizeof(bvh_node)) {
+		std::cout << "Corrupted scene file: " << path << std::endl;
+		return false;
+	}
+
+	const uint64_t expected_size[section_count] = {
+		header->sphere_count * sizeof(double),
+		header->sphere_count * sizeof(double),
+		header->sphere_count * sizeof(double),
+		header->sphere_count * sizeof(double),
+		header->sphere_count * sizeof(uint32_t),
+		header->material_count * sizeof(material),
+		header->bvh_node_count * sizeof(bvh_node)
+	};
+	for (int i = 0; i < section_count; i++) {
+		if (header->section_size[i] != expected_size[i] ||
+			header->section_offset[i] % section_alignment != 0 ||
+			header->section_offset[i] > file->GetSize() ||
+			header->section_size[i] > file->GetSize() - header->section_offset[i]) {
+			std::cout << "Corrupted scene file: " << path << std::endl;
+			return false;
+		}
+	}
+
+	// 文件中的材质记录会被直接调用, 只允许内置材质类型, 且不引用纹理表
+	const material* materials = (const material*)(base + header->section_offset[section_material]);
+	for (uint64_t i = 0; i < header->material_count; i++) {
+		if (materials[i].type >= material_type::custom || materials[i].texture_id != no_texture) {
+			std::cout << "Scene file contains unsupported material: " << path << std::endl;
+			return false;
+		}
+	}
+
+	// 映射后做一遍 O(n) 校验: 材质下标与 BVH 节点都会被直接用作数组下标, 越界的文件直接拒绝
+	const uint32_t* material_ids = (const uint32_t*)(base + header->section_offset[section_material_id]);
+	for (uint64_t i = 0; i < header->sphere_count; i++) {
+		if (material_ids[i] >= header->material_count) {
+			std::cout << "Corrupted scene file: " << path << std::endl;
+			return false;
+		}
+	}
+	const bvh_node* nodes = (const bvh_node*)(base + header->section_offset[section_bvh]);
+	if ((header->flags & scene_flag_bvh) && !bvh::validate(nodes, header->bvh_node_count, header->sphere_count)) {
+		std::cout << "Corrupted scene file: " << path << std::endl;
+		return false;
+	}
+
+	sphere_set_view view;
+	view.center_x = (const double*)(base + header->section_offset[section_center_x]);
+	view.center_y = (const double*)(base + header->section_offset[section_center_y]);
+	view.center_z = (const double*)(base + header->section_offset[section_center_z]);
+	view.radius = (const double*)(base + header->section_offset[section_radius]);
+	view.material_ids = material_ids;
+	view.count = header->sphere_count;
+	view.materials = materials;
+	view.material_count = header->material_count;
+	if (header->flags & scene_flag_bvh) {
+		view.nodes = nodes;
+		view.node_count = header->bvh_node_count;
+	}
+
+	const double* camera = header->camera;
+	s.cam.vfov = camera[0];
+	s.cam.lookfrom = point3(camera[1], camera[2], camera[3]);
+	s.cam.lookat = point3(camera[4], camera[5], camera[6]);
+	s.cam.vup = vec3(camera[7], camera[8], camera[9]);
+	s.cam.aperture = camera[10];
+	s.cam.focus_dist = camera[11];
+	s.settings.samples_per_pixel = header->samples_per_pixel;
+	s.settings.max_depth = header->max_depth;
+
+	s.spheres = make_shared<sphere_set>();
+	s.spheres->attach(view, file);
+	s.world.clear();
+	s.world.add(s.spheres);
+
+	return true;
+}
+
+bool load_scene(const std::string& path, scene& s) {
+	RT_TRACE_ZONE("scene load");
+	const std::string binary_suffix = ".rtbin";
+	if (path.size() >= binary_suffix.size() &&
+		path.compare(path.size() - binary_suffix.size(), binary_suffix.size(), binary_suffix) == 0) {
+		return load_scene_binary(path, s);
+	}
+
+	return load_scene_text(path, s);
+}
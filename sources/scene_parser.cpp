@@ -0,0 +1,337 @@
+#include "scene_parser.h"
+#include "material.h"
+#include "mesh_loader.h"
+#include "instance.h"
+#include "hittable_bvh.h"
+#include "File.hpp"
+
+#include <cstring>
+#include <iostream>
+
+namespace {
+	inline bool is_space(char c) {
+		return c == ' ' || c == '\t' || c == '\r';
+	}
+
+	// 取出下一个以空白分隔的 token, 原地以 '\0' 结尾
+	char* next_token(char*& p) {
+		while (is_space(*p)) p++;
+		if (*p == '\0') return nullptr;
+
+		char* token = p;
+		while (*p != '\0' && !is_space(*p)) p++;
+		if (*p != '\0') *p++ = '\0';
+		return token;
+	}
+
+	bool next_number(char*& p, double& value) {
+		char* end = nullptr;
+		value = std::strtod(p, &end);
+		if (end == p) return false;
+		p = end;
+		return true;
+	}
+
+	bool next_vec3(char*& p, vec3& value) {
+		return next_number(p, value[0]) && next_number(p, value[1]) && next_number(p, value[2]);
+	}
+}
+
+scene_parser::scene_parser(scene& target) : target(target), has_keyframe(false), line_number(0) {
+	if (!target.spheres) {
+		target.spheres = make_shared<sphere_set>();
+	}
+}
+
+bool scene_parser::parse_file(const std::string& path) {
+	File file(path);
+	if (!file.IsExist()) {
+		std::cout << "Failed to open scene file: " << path << std::endl;
+		return false;
+	}
+
+	// 相对路径 (如 mesh 文件) 相对于场景文件所在目录
+	base_path = file.GetPrePath();
+	if (!file.ReadLines([this](char* line) { return parse_line(line); })) {
+		return false;
+	}
+
+	target.spheres->build();
+	target.world.clear();
+	if (extra_objects.empty()) {
+		target.world.add(target.spheres);
+		return true;
+	}
+
+	// 两级加速结构: 顶层 BVH 管理球集合/网格/实例, 各对象内部使用自己的 BVH
+	hittable_list objects;
+	if (target.spheres->size() > 0) {
+		objects.add(target.spheres);
+	}
+	for (const auto& object : extra_objects) {
+		objects.add(object);
+	}
+	target.world.add(make_shared<hittable_bvh>(objects));
+	return true;
+}
+
+bool scene_parser::parse_line(char* line) {
+	line_number++;
+
+	char* comment = std::strchr(line, '#');
+	if (comment != nullptr) *comment = '\0';
+
+	char* p = line;
+	char* command = next_token(p);
+	if (command == nullptr) return true;
+
+	if (std::strcmp(command, "sphere") == 0) return parse_sphere(p);
+	if (std::strcmp(command, "material") == 0) return parse_material(p);
+	if (std::strcmp(command, "texture") == 0) return parse_texture(p);
+	if (std::strcmp(command, "camera") == 0) return parse_camera(p);
+	if (std::strcmp(command, "settings") == 0) return parse_settings(p);
+	if (std::strcmp(command, "mesh") == 0) return parse_mesh(p);
+	if (std::strcmp(command, "object") == 0) return parse_object(p);
+	if (std::strcmp(command, "instance") == 0) return parse_instance(p);
+	if (std::strcmp(command, "keyframe") == 0) return parse_keyframe(p);
+
+	return fail("unknown command");
+}
+
+bool scene_parser::parse_camera(char* p) {
+	return parse_camera_keys(p, target.cam);
+}
+
+bool scene_parser::parse_camera_keys(char* p, camera_settings& cam) {
+	while (char* key = next_token(p)) {
+		bool ok = false;
+		if (std::strcmp(key, "vfov") == 0) ok = next_number(p, cam.vfov);
+		else if (std::strcmp(key, "lookfrom") == 0) ok = next_vec3(p, cam.lookfrom);
+		else if (std::strcmp(key, "lookat") == 0) ok = next_vec3(p, cam.lookat);
+		else if (std::strcmp(key, "vup") == 0) ok = next_vec3(p, cam.vup);
+		else if (std::strcmp(key, "aperture") == 0) ok = next_number(p, cam.aperture);
+		else if (std::strcmp(key, "focus_dist") == 0) ok = next_number(p, cam.focus_dist);
+		else if (std::strcmp(key, "shutter") == 0) ok = next_number(p, cam.shutter_open) && next_number(p, cam.shutter_close);
+		if (!ok) return fail("invalid camera parameter");
+	}
+	return true;
+}
+
+bool scene_parser::parse_keyframe(char* p) {
+	double frame;
+	if (!next_number(p, frame)) return fail("keyframe requires a frame number");
+
+	// 关键帧按帧号排序保存, keys.back() 是帧号最大的关键帧而不一定是上一行; 从最近解析的关键帧继承
+	camera_settings cam = has_keyframe ? last_keyframe : target.cam;
+	if (!parse_camera_keys(p, cam)) return false;
+
+	target.animation.add(frame, cam);
+	last_keyframe = cam;
+	has_keyframe = true;
+	return true;
+}
+
+bool scene_parser::parse_settings(char* p) {
+	render_settings& settings = target.settings;
+	while (char* key = next_token(p)) {
+		double value;
+		if (!next_number(p, value)) return fail("invalid settings value");
+
+		if (std::strcmp(key, "samples_per_pixel") == 0) settings.samples_per_pixel = static_cast<int>(value);
+		else if (std::strcmp(key, "max_depth") == 0) settings.max_depth = static_cast<int>(value);
+		else return fail("unknown settings key");
+	}
+	return true;
+}
+
+bool scene_parser::parse_material(char* p) {
+	char* name = next_token(p);
+	char* type = next_token(p);
+	if (name == nullptr || type == nullptr) return fail("material requires a name and a type");
+
+	material mat;
+	if (std::strcmp(type, "lambertian") == 0) {
+		color albedo;
+		if (!next_vec3(p, albedo)) return fail("lambertian requires an albedo");
+		mat = lambertian(albedo);
+	}
+	else if (std::strcmp(type, "metal") == 0) {
+		color albedo;
+		double roughness;
+		if (!next_vec3(p, albedo) || !next_number(p, roughness)) return fail("metal requires an albedo and a roughness");
+		mat = metal(albedo, roughness);
+	}
+	else if (std::strcmp(type, "dielectric") == 0) {
+		double ri;
+		if (!next_number(p, ri)) return fail("dielectric requires a refractive index");
+		mat = dielectric(ri);
+	}
+	else {
+		return fail("unknown material type");
+	}
+
+	while (char* key = next_token(p)) {
+		if (std::strcmp(key, "texture") == 0) {
+			char* texture_name = next_token(p);
+			if (texture_name == nullptr) return fail("expected texture <name>");
+			if (mat.type == material_type::dielectric) return fail("dielectric does not take a texture");
+			auto it = texture_ids.find(texture_name);
+			if (it == texture_ids.end()) return fail("undefined texture");
+			mat.texture_id = it->second;
+		}
+		else if (std::strcmp(key, "roughness") == 0 && mat.type == material_type::dielectric) {
+			double roughness;
+			if (!next_number(p, roughness)) return fail("expected roughness <r>");
+			mat = dielectric(mat.ref_rdx, roughness);
+		}
+		else {
+			return fail("unknown material option");
+		}
+	}
+
+	material_ids[name] = target.spheres->add_material(mat);
+	return true;
+}
+
+bool scene_parser::parse_texture(char* p) {
+	char* name = next_token(p);
+	char* type = next_token(p);
+	if (name == nullptr || type == nullptr) return fail("texture requires a name and a type");
+
+	texture tex;
+	char* path = nullptr;
+	if (std::strcmp(type, "image") == 0) {
+		tex.type = texture_type::image;
+		path = next_token(p);
+		if (path == nullptr) return fail("image texture requires a file");
+	}
+	else if (std::strcmp(type, "checker") == 0 || std::strcmp(type, "noise") == 0) {
+		tex.type = std::strcmp(type, "checker") == 0 ? texture_type::checker : texture_type::noise;
+		if (!next_vec3(p, tex.color0) || !next_vec3(p, tex.color1)) return fail("procedural texture requires two colors");
+	}
+	else {
+		return fail("unknown texture type");
+	}
+
+	if (char* key = next_token(p)) {
+		if (std::strcmp(key, "scale") != 0 || !next_number(p, tex.scale)) return fail("expected scale <s>");
+	}
+
+	uint32_t id;
+	if (path != nullptr) {
+		std::string full_path = (path[0] == '/' || std::strchr(path, ':') != nullptr) ? path : base_path + path;
+		id = add_image_texture(full_path, tex.scale);
+		if (id == no_texture) return fail("failed to load texture");
+	}
+	else {
+		id = add_texture(tex);
+	}
+	texture_ids[name] = id;
+	return true;
+}
+
+bool scene_parser::parse_sphere(char* p) {
+	point3 center;
+	double radius;
+	if (!next_vec3(p, center) || !next_number(p, radius)) return fail("sphere requires a center and a radius");
+
+	char* name = next_token(p);
+	if (name == nullptr) return fail("sphere requires a material");
+
+	auto it = material_ids.find(name);
+	if (it == material_ids.end()) return fail("undefined material");
+
+	point3 center1 = center;
+	if (char* key = next_token(p)) {
+		if (std::strcmp(key, "to") != 0 || !next_vec3(p, center1)) return fail("invalid sphere motion");
+	}
+
+	target.spheres->add(center, center1, radius, it->second);
+	return true;
+}
+
+shared_ptr<hittable> scene_parser::load_mesh_object(char* path, char* material_name) {
+	auto it = material_ids.find(material_name);
+	if (it == material_ids.end()) {
+		fail("undefined material");
+		return nullptr;
+	}
+
+	// 网格持有独立的材质对象, 与 sphere_set 的材质表互不影响
+	auto mat = make_shared<material>(target.spheres->view().materials[it->second]);
+	std::string full_path = (path[0] == '/' || std::strchr(path, ':') != nullptr) ? path : base_path + path;
+	auto mesh = load_mesh(full_path, mat);
+	if (!mesh) {
+		fail("failed to load mesh");
+		return nullptr;
+	}
+
+	return mesh;
+}
+
+bool scene_parser::parse_mesh(char* p) {
+	char* path = next_token(p);
+	char* name = next_token(p);
+	if (path == nullptr || name == nullptr) return fail("mesh requires a file and a material");
+
+	auto mesh = load_mesh_object(path, name);
+	if (!mesh) return false;
+
+	extra_objects.push_back(mesh);
+	return true;
+}
+
+bool scene_parser::parse_object(char* p) {
+	char* name = next_token(p);
+	char* path = next_token(p);
+	char* material_name = next_token(p);
+	if (name == nullptr || path == nullptr || material_name == nullptr) return fail("object requires a name, a file and a material");
+
+	auto mesh = load_mesh_object(path, material_name);
+	if (!mesh) return false;
+
+	prototypes[name] = mesh;
+	return true;
+}
+
+bool scene_parser::parse_instance(char* p) {
+	char* name = next_token(p);
+	if (name == nullptr) return fail("instance requires an object name");
+
+	auto it = prototypes.find(name);
+	if (it == prototypes.end()) return fail("undefined object");
+
+	transform object_to_world;
+	while (char* op = next_token(p)) {
+		vec3 v;
+		if (!next_vec3(p, v)) return fail("invalid instance transform");
+
+		if (std::strcmp(op, "translate") == 0) {
+			object_to_world = transform::translate(v) * object_to_world;
+		}
+		else if (std::strcmp(op, "scale") == 0) {
+			object_to_world = transform::scale(v) * object_to_world;
+		}
+		else if (std::strcmp(op, "rotate") == 0) {
+			double degrees;
+			if (!next_number(p, degrees)) return fail("rotate requires an axis and an angle");
+			object_to_world = transform::rotate(v, degrees) * object_to_world;
+		}
+		else {
+			return fail("unknown instance transform");
+		}
+	}
+
+	extra_objects.push_back(make_shared<instance>(it->second, object_to_world));
+	return true;
+}
+
+bool scene_parser::fail(const char* message) {
+	std::cout << "Scene parse error at line " << line_number << ": " << message << std::endl;
+	return false;
+}
+
+bool load_scene_text(const std::string& path, scene& s) {
+	scene_parser parser(s);
+	return parser.parse_file(path);
+}
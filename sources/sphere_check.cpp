@@ -0,0 +1,211 @@
+#include "sphere_check.h"
+#include "sphere.h"
+
+#include <cstdio>
+#include <iostream>
+#include <limits>
+
+namespace {
+	const int batch = 8;
+
+	// 一条测试光线: 已知应有的结果, 不依赖任何求交公式
+	struct kernel_case {
+		point3 center;
+		double radius;
+		point3 origin;
+		vec3 direction;		// 单位长度
+		double d_min;
+		bool expect_hit;
+		double expect_d;
+	};
+
+	// 误差上限: 构造起点与球心时的舍入随坐标的量级增长
+	inline double tolerance(const kernel_case& k) {
+		const double eps = std::numeric_limits<double>::epsilon();
+		double scale = k.origin.length() + k.center.length() + k.radius + k.expect_d;
+		return 64.0 * eps * scale;
+	}
+
+	// 原先的二次公式 (a = |dir|^2, 判别式 b^2 - a*c), 仅作为对照
+	bool textbook_quadratic(const kernel_case& k, double& d) {
+		vec3 oc = k.origin - k.center;
+		double a = k.direction.length_squared();
+		double half_b = dot(oc, k.direction);
+		double c = oc.length_squared() - k.radius * k.radius;
+		double discriminant = half_b * half_b - a * c;
+		if (discriminant < 0) return false;
+		double sqrtd = std::sqrt(discriminant);
+		d = (-half_b - sqrtd) / a;
+		if (d < k.d_min) d = (-half_b + sqrtd) / a;
+		return d >= k.d_min;
+	}
+
+	point3 random_point(double extent) {
+		return point3(random_double(-extent, extent), random_double(-extent, extent), random_double(-extent, extent));
+	}
+
+	// 从球外射入: 在球面上取入射点 p, 方向与该点外法线夹角大于 90 度, 起点在 p 之前 distance 处
+	kernel_case entering(const point3& center, double radius, double distance) {
+		kernel_case k;
+		vec3 n = random_unit_vector();
+		vec3 u = random_unit_vector();
+		if (dot(u, n) > -0.05) u = unit_vector(u - (dot(u, n) + 0.5) * n);
+		k.center = center;
+		k.radius = radius;
+		k.direction = u;
+		k.origin = center + radius * n - distance * u;
+		k.d_min = 1e-9 * radius;
+		k.expect_hit = true;
+		k.expect_d = distance;
+		return k;
+	}
+
+	// 起点在球内: 在球面上取出射点 p, 起点在 p 之前、弦长以内
+	kernel_case inside(const point3& center, double radius) {
+		kernel_case k;
+		vec3 n = random_unit_vector();
+		vec3 u = random_unit_vector();
+		if (dot(u, n) < 0.05) u = unit_vector(u - (dot(u, n) - 0.5) * n);
+		double chord = 2.0 * radius * dot(u, n);
+		double distance = chord * random_double(0.01, 0.99);
+		k.center = center;
+		k.radius = radius;
+		k.direction = u;
+		k.origin = center + radius * n - distance * u;
+		k.d_min = 1e-9 * radius;
+		k.expect_hit = true;
+		k.expect_d = distance;
+		return k;
+	}
+
+	// 未命中: 光线与球心的最近距离大于半径; along 为负时球在起点身后
+	kernel_case missing(const point3& center, double radius) {
+		kernel_case k;
+		vec3 u = random_unit_vector();
+		vec3 side = unit_vector(cross(u, random_unit_vector()));
+		double gap = radius * random_double(1.0 + 1e-6, 2.0);
+		double along = random_double(-100.0, 100.0) * radius;
+		k.center = center;
+		k.radius = radius;
+		k.direction = u;
+		k.origin = center + gap * side - along * u;
+		k.d_min = 1e-9 * radius;
+		k.expect_hit = false;
+		k.expect_d = 0.0;
+		return k;
+	}
+
+	// 起点在球面上且方向与球相切: b 与判别式都为 0, q = 0
+	kernel_case tangent_at_origin(double d_min) {
+		kernel_case k;
+		k.center = point3(0, 0, 0);
+		k.radius = 1.0;
+		k.origin = point3(1, 0, 0);
+		k.direction = vec3(0, 1, 0);
+		k.d_min = d_min;
+		k.expect_hit = d_min <= 0.0;
+		k.expect_d = 0.0;
+		return k;
+	}
+
+	struct kernel_result {
+		int count = 0;
+		int scalar_errors = 0;
+		int batch_errors = 0;
+		double scalar_max = 0.0;		// 相对于容差的最大误差
+		double batch_max = 0.0;
+		int textbook_wrong = 0;			// 原公式命中与否判断错误的次数
+		double textbook_max = 0.0;
+	};
+
+	bool agrees(const kernel_case& k, bool hit, double d, double& error) {
+		if (hit != k.expect_hit) return false;
+		if (!hit) return true;
+		if (!(d == d)) return false;
+		double e = std::abs(d - k.expect_d) / tolerance(k);
+		error = std::max(error, e);
+		return e <= 1.0;
+	}
+
+	void run_case(const kernel_case& k, kernel_result& result) {
+		result.count++;
+		ray r(k.origin, k.direction);
+		sphere_ray sr(r);
+		const double d_max = std::numeric_limits<double>::infinity();
+
+		double d = 0.0;
+		bool hit = hit_sphere_unit(k.center.e[0], k.center.e[1], k.center.e[2], k.radius, sr, k.d_min, d_max, d);
+		if (!agrees(k, hit, d, result.scalar_max)) result.scalar_errors++;
+
+		// 批量内核: 目标球放在一批球中的随机位置, 其余为光线身后或更远处的球
+		double cx[batch], cy[batch], cz[batch], radius[batch];
+		int target = (int)(random_u32() % batch);
+		for (int i = 0; i < batch; i++) {
+			point3 c = k.center;
+			if (i != target) {
+				// 奇数号在目标之后更远处 (只用于应命中的光线), 其余在起点身后
+				double spacing = 4.0 * k.radius * (i + 1);
+				if ((i & 1) && k.expect_hit) c = k.origin + (k.expect_d + spacing) * k.direction;
+				else c = k.origin - ((k.origin - k.center).length() + spacing) * k.direction;
+			}
+			cx[i] = c.e[0];
+			cy[i] = c.e[1];
+			cz[i] = c.e[2];
+			radius[i] = k.radius;
+		}
+		double batch_max = d_max;
+		int index = hit_spheres_unit(cx, cy, cz, radius, batch, sr, k.d_min, batch_max);
+		bool batch_hit = index >= 0;
+		bool batch_ok = agrees(k, batch_hit, batch_max, result.batch_max);
+		if (k.expect_hit && index != target) batch_ok = false;
+		if (!batch_ok) result.batch_errors++;
+
+		double textbook_d = 0.0;
+		bool textbook_hit = textbook_quadratic(k, textbook_d);
+		if (textbook_hit != k.expect_hit) {
+			result.textbook_wrong++;
+		}
+		else if (textbook_hit) {
+			result.textbook_max = std::max(result.textbook_max, std::abs(textbook_d - k.expect_d) / tolerance(k));
+		}
+	}
+
+	void print_row(const char* name, const kernel_result& r, bool ok) {
+		char line[200];
+		snprintf(line, sizeof(line), "%-24s %8d %6d %9.2f %6d %9.2f %8d %12.3g  %s", name, r.count,
+			r.scalar_errors, r.scalar_max, r.batch_errors, r.batch_max, r.textbook_wrong, r.textbook_max, ok ? "ok" : "FAILED");
+		std::cout << line << std::endl;
+	}
+}
+
+bool check_sphere_kernels(int count) {
+	std::cout << "rays (error / tolerance)    count scalar       max  batch       max  old miss      old max" << std::endl;
+	seed_random(5, 0);
+
+	kernel_result results[5];
+	for (int i = 0; i < count; i++) {
+		double radius = std::exp(random_double(std::log(0.01), std::log(100.0)));
+		run_case(entering(random_point(100.0), radius, radius * random_double(0.001, 100.0)), results[0]);
+
+		// 远处的小球: b^2 与 c 都很大而差很小, 原公式的判别式在这里失去精度
+		vec3 dir = random_unit_vector();
+		point3 center = point3(0, 0, 0) + std::exp(random_double(std::log(1e3), std::log(1e6))) * dir;
+		double small = std::exp(random_double(std::log(1e-3), std::log(1e-1)));
+		kernel_case far = entering(center, small, center.length());
+		run_case(far, results[1]);
+
+		run_case(inside(random_point(100.0), radius), results[2]);
+		run_case(missing(random_point(100.0), radius), results[3]);
+	}
+	run_case(tangent_at_origin(0.0), results[4]);
+	run_case(tangent_at_origin(1e-9), results[4]);
+
+	const char* names[5] = { "entering", "far small sphere", "origin inside", "miss", "tangent at origin (q=0)" };
+	bool ok = true;
+	for (int i = 0; i < 5; i++) {
+		bool row_ok = results[i].scalar_errors == 0 && results[i].batch_errors == 0;
+		print_row(names[i], results[i], row_ok);
+		ok = ok && row_ok;
+	}
+	return ok;
+}
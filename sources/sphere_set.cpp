@@ -0,0 +1,833 @@
+#include "sphere_set.h"
+#include "sphere.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <limits>
+#include <numeric>
+
+namespace {
+	const uint32_t invalid_id = UINT32_MAX;
+
+	// refit 后节点表面积平均增长超过该倍数才考虑重建
+	const double max_degradation = 1.3;
+	// 局部重建的子树最多包含的图元比例, 超过时改为完整重建
+	const double max_subtree_fraction = 0.5;
+	// 尚未进入 BVH 的新图元超过该数量, 或已删除的槽位超过该比例时完整重建
+	const size_t max_overflow = 64;
+	const double max_removed_fraction = 0.25;
+
+	// 运动图元取整个快门区间扫过的范围
+	std::vector<aabb> sphere_boxes(const sphere_set_view& view) {
+		std::vector<aabb> boxes(view.count);
+		for (size_t i = 0; i < boxes.size(); i++) {
+			vec3 extent(view.radius[i], view.radius[i], view.radius[i]);
+			point3 center(view.center_x[i], view.center_y[i], view.center_z[i]);
+			boxes[i] = aabb(center - extent, center + extent);
+			if (view.motion_x) {
+				boxes[i].expand(boxes[i].minimum + vec3(view.motion_x[i], view.motion_y[i], view.motion_z[i]));
+				boxes[i].expand(boxes[i].maximum + vec3(view.motion_x[i], view.motion_y[i], view.motion_z[i]));
+			}
+		}
+		return boxes;
+	}
+
+	// 空包围盒视为被任何包围盒包含
+	bool contains_box(const aabb& outer, const aabb& inner) {
+		for (int a = 0; a < 3; a++) {
+			if (inner.minimum.e[a] < outer.minimum.e[a] || inner.maximum.e[a] > outer.maximum.e[a]) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// values[first + i] = old values[slots[i]]
+	template <typename T>
+	void gather(std::vector<T>& values, const std::vector<uint32_t>& slots, size_t first) {
+		std::vector<T> sorted(slots.size());
+		for (size_t i = 0; i < slots.size(); i++) {
+			sorted[i] = values[slots[i]];
+		}
+		std::copy(sorted.begin(), sorted.end(), values.begin() + first);
+	}
+}
+
+sphere_set::sphere_set()
+	: accelerator(sphere_accelerator::bvh), removed_count(0), indexed(false), changed(false),
+	edit_epoch(0), background_epoch(0) {}
+
+uint32_t sphere_set::add_material(const material& mat) {
+	make_local();
+	materials.push_back(mat);
+	refresh_view();
+	return static_cast<uint32_t>(materials.size() - 1);
+}
+
+uint32_t sphere_set::add(point3 center, double r, uint32_t material_id) {
+	make_local();
+	const uint32_t slot = static_cast<uint32_t>(center_x.size());
+
+	// 已经构建过加速结构: 新图元在下次重建之前逐个测试
+	if (!nodes.empty() || !grid.empty()) {
+		overflow.push_back(slot);
+		changed = true;
+		edit_epoch++;
+	}
+
+	const uint32_t id = static_cast<uint32_t>(id_slots.size());
+	id_slots.push_back(slot);
+	slot_ids.push_back(id);
+	center_x.push_back(center.x());
+	center_y.push_back(center.y());
+	center_z.push_back(center.z());
+	radius.push_back(r);
+	material_ids.push_back(material_id);
+	if (!motion_x.empty()) {
+		motion_x.push_back(0.0);
+		motion_y.push_back(0.0);
+		motion_z.push_back(0.0);
+	}
+	refresh_view();
+	return id;
+}
+
+uint32_t sphere_set::add(point3 center0, point3 center1, double r, uint32_t material_id) {
+	const uint32_t id = add(center0, r, material_id);
+	vec3 motion = center1 - center0;
+	if (motion.near_zero()) {
+		return id;
+	}
+
+	// 第一个运动图元出现时才分配位移数组, 静止场景不需要额外的存储与插值
+	if (motion_x.empty()) {
+		motion_x.assign(center_x.size(), 0.0);
+		motion_y.assign(center_x.size(), 0.0);
+		motion_z.assign(center_x.size(), 0.0);
+	}
+	const uint32_t slot = id_slots[id];
+	motion_x[slot] = motion.x();
+	motion_y[slot] = motion.y();
+	motion_z[slot] = motion.z();
+	refresh_view();
+	return id;
+}
+
+bool sphere_set::contains(uint32_t id) const {
+	// 映射的外部数据还没有修改过, 没有 id 表, id 即槽位
+	if (backing) {
+		return id < data.count;
+	}
+	return id < id_slots.size() && id_slots[id] != invalid_id;
+}
+
+bool sphere_set::get(uint32_t id, point3& center, double& r) const {
+	if (!contains(id)) {
+		return false;
+	}
+
+	const uint32_t slot = backing ? id : id_slots[id];
+	center = point3(data.center_x[slot], data.center_y[slot], data.center_z[slot]);
+	r = data.radius[slot];
+	return true;
+}
+
+uint32_t sphere_set::id_limit() const {
+	return backing ? static_cast<uint32_t>(data.count) : static_cast<uint32_t>(id_slots.size());
+}
+
+bool sphere_set::move(uint32_t id, point3 center, double r) {
+	if (!contains(id)) {
+		return false;
+	}
+
+	make_local();
+	const uint32_t slot = id_slots[id];
+	center_x[slot] = center.x();
+	center_y[slot] = center.y();
+	center_z[slot] = center.z();
+	radius[slot] = r;
+	mark_dirty(slot);
+	changed = true;
+	return true;
+}
+
+bool sphere_set::remove(uint32_t id) {
+	if (!contains(id)) {
+		return false;
+	}
+
+	make_local();
+	const uint32_t slot = id_slots[id];
+	mark_dirty(slot);
+
+	// 槽位保留到下次重建, 球心设为 NaN 使所有求交比较都不成立
+	const double nan = std::numeric_limits<double>::quiet_NaN();
+	center_x[slot] = nan;
+	center_y[slot] = nan;
+	center_z[slot] = nan;
+	radius[slot] = 0.0;
+	slot_ids[slot] = invalid_id;
+	id_slots[id] = invalid_id;
+	removed_count++;
+
+	overflow.erase(std::remove(overflow.begin(), overflow.end(), slot), overflow.end());
+	changed = true;
+	edit_epoch++;
+	return true;
+}
+
+void sphere_set::build() {
+	make_local();
+	remove_dead_slots();
+	overflow.clear();
+	nodes.clear();
+	end_boxes.clear();
+	grid.clear();
+	indexed = false;
+	changed = false;
+	edit_epoch++;	// 作废进行中的后台重建
+	refresh_view();
+
+	if (accelerator == sphere_accelerator::grid) {
+		build_grid();
+		return;
+	}
+
+	std::vector<aabb> boxes = sphere_boxes(data);
+	std::vector<uint32_t> order;
+	bvh::build(boxes, nodes, order);
+
+	// 按叶子顺序重排, 叶子直接引用连续区间而不需要间接索引
+	gather_columns(order, 0);
+	for (size_t slot = 0; slot < slot_ids.size(); slot++) {
+		id_slots[slot_ids[slot]] = static_cast<uint32_t>(slot);
+	}
+
+	refresh_view();
+
+	// 划分按扫过的范围进行, 节点包围盒再按快门开启和关闭时刻分别重算
+	if (has_motion()) {
+		refit_nodes(nullptr);
+	}
+}
+
+sphere_update sphere_set::commit(bool allow_background) {
+	RT_TRACE_ZONE("sphere commit");
+	if (accelerator == sphere_accelerator::grid) {
+		if (!changed) {
+			return sphere_update::none;
+		}
+		build();
+		return sphere_update::full_rebuild;
+	}
+
+	sphere_update result = finish_background_build() ? sphere_update::full_rebuild : sphere_update::none;
+	if (!changed) {
+		return result;
+	}
+	changed = false;
+
+	if (nodes.empty()) {
+		build();
+		return sphere_update::full_rebuild;
+	}
+
+	if (!indexed) index_tree();
+	refit_dirty();
+	if (result == sphere_update::none) {
+		result = sphere_update::refit;
+	}
+
+	std::sort(touched_leaves.begin(), touched_leaves.end());
+	touched_leaves.erase(std::unique(touched_leaves.begin(), touched_leaves.end()), touched_leaves.end());
+
+	// 变化集中在某棵子树内时只重建该子树; 子树即整棵树时按整棵树的退化程度决定是否完整重建
+	bool full = overflow.size() > max_overflow || removed_count > max_removed_fraction * data.count;
+	uint32_t target = full ? invalid_id : rebuild_target();
+	if (target != invalid_id && tree_degradation(target) > max_degradation) {
+		if (target != 0 && rebuild_subtree(target)) {
+			result = sphere_update::partial_rebuild;
+		}
+		else {
+			full = true;
+		}
+	}
+
+	touched_leaves.clear();
+
+	if (full) {
+		if (allow_background) {
+			start_background_build();
+		}
+		else {
+			build();
+			result = sphere_update::full_rebuild;
+		}
+	}
+
+	return result;
+}
+
+void sphere_set::compact() {
+	if (background.valid()) {
+		background.wait();
+		finish_background_build();
+	}
+	if (removed_count > 0 || !overflow.empty()) {
+		build();
+	}
+}
+
+void sphere_set::attach(const sphere_set_view& view, std::shared_ptr<void> backing_data) {
+	center_x.clear();
+	center_y.clear();
+	center_z.clear();
+	radius.clear();
+	material_ids.clear();
+	materials.clear();
+	nodes.clear();
+	motion_x.clear();
+	motion_y.clear();
+	motion_z.clear();
+	end_boxes.clear();
+	grid.clear();
+
+	data = view;
+	backing = backing_data;
+
+	// id 表在第一次修改时由 make_local 建立, 只读加载不需要额外的内存与初始化
+	slot_ids.clear();
+	id_slots.clear();
+	overflow.clear();
+	removed_count = 0;
+	indexed = false;
+	changed = false;
+	edit_epoch++;
+
+	// 网格不改变图元顺序, 可以直接建立在只读的外部数据上
+	if (accelerator == sphere_accelerator::grid) {
+		build_grid();
+	}
+	else if (data.node_count == 0 && data.count > 0) {
+		build_nodes();
+	}
+}
+
+void sphere_set::set_accelerator(sphere_accelerator type) {
+	accelerator = type;
+	if (data.count == 0) {
+		return;
+	}
+
+	if (backing) {
+		sphere_set_view view = data;
+		attach(view, backing);
+	}
+	else {
+		build();
+	}
+}
+
+void sphere_set::build_nodes() {
+	// 外部数据是只读的, 无法按叶子顺序重排, 先复制到本地再构建
+	make_local();
+	build();
+}
+
+void sphere_set::build_grid() {
+	grid.build(sphere_boxes(data));
+}
+
+void sphere_set::make_local() {
+	if (!backing) {
+		return;
+	}
+
+	center_x.assign(data.center_x, data.center_x + data.count);
+	center_y.assign(data.center_y, data.center_y + data.count);
+	center_z.assign(data.center_z, data.center_z + data.count);
+	radius.assign(data.radius, data.radius + data.count);
+	material_ids.assign(data.material_ids, data.material_ids + data.count);
+	if (data.motion_x) {
+		motion_x.assign(data.motion_x, data.motion_x + data.count);
+		motion_y.assign(data.motion_y, data.motion_y + data.count);
+		motion_z.assign(data.motion_z, data.motion_z + data.count);
+	}
+	materials.assign(data.materials, data.materials + data.material_count);
+	nodes.assign(data.nodes, data.nodes + data.node_count);
+	slot_ids.resize(data.count);
+	std::iota(slot_ids.begin(), slot_ids.end(), 0u);
+	id_slots = slot_ids;
+	backing.reset();
+	refresh_view();
+}
+
+void sphere_set::refresh_view() {
+	data.center_x = center_x.data();
+	data.center_y = center_y.data();
+	data.center_z = center_z.data();
+	data.radius = radius.data();
+	data.material_ids = material_ids.data();
+	data.count = center_x.size();
+	data.motion_x = motion_x.empty() ? nullptr : motion_x.data();
+	data.motion_y = motion_y.empty() ? nullptr : motion_y.data();
+	data.motion_z = motion_z.empty() ? nullptr : motion_z.data();
+	data.materials = materials.data();
+	data.material_count = materials.size();
+	data.nodes = nodes.data();
+	data.node_count = nodes.size();
+}
+
+void sphere_set::gather_columns(const std::vector<uint32_t>& slots, size_t first) {
+	gather(center_x, slots, first);
+	gather(center_y, slots, first);
+	gather(center_z, slots, first);
+	gather(radius, slots, first);
+	gather(material_ids, slots, first);
+	gather(slot_ids, slots, first);
+	if (!motion_x.empty()) {
+		gather(motion_x, slots, first);
+		gather(motion_y, slots, first);
+		gather(motion_z, slots, first);
+	}
+}
+
+void sphere_set::resize_columns(size_t count) {
+	center_x.resize(count);
+	center_y.resize(count);
+	center_z.resize(count);
+	radius.resize(count);
+	material_ids.resize(count);
+	slot_ids.resize(count);
+	if (!motion_x.empty()) {
+		motion_x.resize(count);
+		motion_y.resize(count);
+		motion_z.resize(count);
+	}
+}
+
+point3 sphere_set::center_at(uint32_t slot, double time) const {
+	point3 center(data.center_x[slot], data.center_y[slot], data.center_z[slot]);
+	if (data.motion_x) {
+		center += time * vec3(data.motion_x[slot], data.motion_y[slot], data.motion_z[slot]);
+	}
+	return center;
+}
+
+void sphere_set::remove_dead_slots() {
+	if (removed_count == 0) {
+		return;
+	}
+
+	std::vector<uint32_t> live;
+	live.reserve(slot_ids.size() - removed_count);
+	for (uint32_t slot = 0; slot < slot_ids.size(); slot++) {
+		if (slot_ids[slot] != invalid_id) live.push_back(slot);
+	}
+
+	gather_columns(live, 0);
+	resize_columns(live.size());
+	for (size_t slot = 0; slot < slot_ids.size(); slot++) {
+		id_slots[slot_ids[slot]] = static_cast<uint32_t>(slot);
+	}
+
+	removed_count = 0;
+	refresh_view();
+}
+
+aabb sphere_set::slot_box(uint32_t slot, double time) const {
+	vec3 extent(radius[slot], radius[slot], radius[slot]);
+	point3 center = center_at(slot, time);
+	return aabb(center - extent, center + extent);
+}
+
+aabb sphere_set::swept_box(uint32_t slot) const {
+	aabb box = slot_box(slot, 0.0);
+	if (has_motion()) {
+		box.expand(slot_box(slot, 1.0));
+	}
+	return box;
+}
+
+aabb sphere_set::leaf_box(uint32_t offset, uint32_t count, double time) const {
+	aabb box;
+	for (uint32_t slot = offset; slot < offset + count; slot++) {
+		if (slot_ids[slot] != invalid_id) box.expand(slot_box(slot, time));
+	}
+	return box;
+}
+
+void sphere_set::refit_nodes(const uint8_t* dirty) {
+	bvh::refit(nodes.data(), nodes.size(), dirty,
+		[this](uint32_t offset, uint32_t count) { return leaf_box(offset, count, 0.0); });
+
+	if (!has_motion()) {
+		end_boxes.clear();
+		return;
+	}
+	// 树结构变化后, 或第一个运动图元在构建之后才加入时, 关闭时刻的包围盒需要全部重算
+	if (end_boxes.size() != nodes.size()) {
+		end_boxes.resize(nodes.size());
+		dirty = nullptr;
+	}
+	bvh::refit_boxes(nodes.data(), end_boxes.data(), nodes.size(), dirty,
+		[this](uint32_t offset, uint32_t count) { return leaf_box(offset, count, 1.0); });
+}
+
+void sphere_set::index_tree() {
+	parents.assign(nodes.size(), invalid_id);
+	slot_leaf.assign(data.count, invalid_id);
+	built_boxes.resize(nodes.size());
+	dirty_nodes.assign(nodes.size(), 0);
+	touched_leaves.clear();
+	if (!nodes.empty()) {
+		index_subtree(0);
+	}
+	indexed = true;
+}
+
+void sphere_set::index_subtree(uint32_t root) {
+	std::vector<uint32_t> stack(1, root);
+	while (!stack.empty()) {
+		uint32_t index = stack.back();
+		stack.pop_back();
+
+		const bvh_node& node = nodes[index];
+		built_boxes[index] = node.box;
+		dirty_nodes[index] = 0;
+		if (node.count > 0) {
+			for (uint32_t slot = node.offset; slot < node.offset + node.count; slot++) {
+				slot_leaf[slot] = index;
+			}
+		}
+		else {
+			parents[index + 1] = index;
+			parents[node.offset] = index;
+			stack.push_back(index + 1);
+			stack.push_back(node.offset);
+		}
+	}
+}
+
+void sphere_set::mark_dirty(uint32_t slot) {
+	if (nodes.empty()) {
+		return;
+	}
+	if (!indexed) index_tree();
+	if (slot >= slot_leaf.size() || slot_leaf[slot] == invalid_id) {
+		return;
+	}
+
+	uint32_t index = slot_leaf[slot];
+	touched_leaves.push_back(index);
+	while (index != invalid_id && !dirty_nodes[index]) {
+		dirty_nodes[index] = 1;
+		index = parents[index];
+	}
+}
+
+void sphere_set::refit_dirty() {
+	RT_TRACE_ZONE("bvh refit");
+	refit_nodes(dirty_nodes.data());
+	std::fill(dirty_nodes.begin(), dirty_nodes.end(), (uint8_t)0);
+}
+
+double sphere_set::tree_degradation(uint32_t root) const {
+	// 子树各节点当前表面积与构建时之比的平均值. 不用 SAH 的绝对代价:
+	// 地面大球这样的巨大节点会主导总和, 小球移动造成的退化几乎看不出来
+	double ratio_sum = 0.0;
+	size_t node_count = 0;
+	std::vector<uint32_t> stack(1, root);
+	while (!stack.empty()) {
+		uint32_t index = stack.back();
+		stack.pop_back();
+
+		const bvh_node& node = nodes[index];
+		double built_area = built_boxes[index].surface_area();
+		if (built_area > 0.0) {
+			ratio_sum += node.box.surface_area() / built_area;
+			node_count++;
+		}
+		if (node.count == 0) {
+			stack.push_back(node.offset);
+			stack.push_back(index + 1);
+		}
+	}
+	return node_count > 0 ? ratio_sum / node_count : 1.0;
+}
+
+uint32_t sphere_set::rebuild_target() const {
+	// 从每个变化过的叶子向上, 找到构建时包围盒仍能容纳其当前包围盒的祖先;
+	// 在这些祖先的公共祖先处重建, 重建后其上方的节点不受影响
+	uint32_t target = invalid_id;
+	for (uint32_t index : touched_leaves) {
+		while (parents[index] != invalid_id && !contains_box(built_boxes[index], nodes[index].box)) {
+			index = parents[index];
+		}
+
+		if (target == invalid_id) {
+			target = index;
+			continue;
+		}
+		// 父节点的下标总是小于子节点, 下标较大的一方一定不是公共祖先
+		while (target != index) {
+			if (target > index) target = parents[target];
+			else index = parents[index];
+		}
+	}
+	return target;
+}
+
+bool sphere_set::rebuild_subtree(uint32_t root) {
+	RT_TRACE_ZONE_ARG("bvh partial rebuild", root);
+
+	// 深度优先存储: 子树占据连续的节点区间, 叶子引用连续的槽位区间
+	uint32_t first_leaf = root;
+	while (nodes[first_leaf].count == 0) first_leaf++;
+	uint32_t last_leaf = root;
+	while (nodes[last_leaf].count == 0) last_leaf = nodes[last_leaf].offset;
+	const uint32_t begin = nodes[first_leaf].offset;
+	const uint32_t end = nodes[last_leaf].offset + nodes[last_leaf].count;
+	const size_t capacity = last_leaf + 1 - root;
+
+	if (end - begin > max_subtree_fraction * data.count) {
+		return false;
+	}
+
+	std::vector<uint32_t> live;
+	std::vector<aabb> boxes;
+	for (uint32_t slot = begin; slot < end; slot++) {
+		if (slot_ids[slot] != invalid_id) {
+			live.push_back(slot);
+			boxes.push_back(swept_box(slot));
+		}
+	}
+	if (live.empty()) {
+		return false;
+	}
+
+	std::vector<bvh_node> subtree;
+	std::vector<uint32_t> order;
+	bvh::build(boxes, subtree, order);
+	if (subtree.size() > capacity) {
+		return false;
+	}
+
+	// 存活的图元按新的叶子顺序排在区间前部, 已删除的槽位放到末尾
+	std::vector<uint32_t> slots;
+	slots.reserve(end - begin);
+	for (uint32_t i : order) slots.push_back(live[i]);
+	for (uint32_t slot = begin; slot < end; slot++) {
+		if (slot_ids[slot] == invalid_id) slots.push_back(slot);
+	}
+	gather_columns(slots, begin);
+	for (uint32_t slot = begin; slot < end; slot++) {
+		if (slot_ids[slot] != invalid_id) id_slots[slot_ids[slot]] = slot;
+		slot_leaf[slot] = invalid_id;
+	}
+	edit_epoch++;	// 槽位已重排, 进行中的后台重建所用的快照失效
+
+	for (size_t i = 0; i < subtree.size(); i++) {
+		bvh_node node = subtree[i];
+		node.offset += node.count > 0 ? begin : root;
+		nodes[root + i] = node;
+	}
+	// 新子树的节点较少时, 剩余的节点不可达, 写成合法的空叶子
+	for (size_t i = root + subtree.size(); i < root + capacity; i++) {
+		nodes[i].box = aabb();
+		nodes[i].offset = begin;
+		nodes[i].count = 1;
+		nodes[i].axis = 0;
+	}
+
+	// 新子树的节点包围盒是扫过的范围, 改为快门开启和关闭时刻的包围盒
+	if (has_motion()) {
+		std::fill(dirty_nodes.begin() + root, dirty_nodes.begin() + root + subtree.size(), (uint8_t)1);
+		refit_nodes(dirty_nodes.data());
+		std::fill(dirty_nodes.begin() + root, dirty_nodes.begin() + root + subtree.size(), (uint8_t)0);
+	}
+
+	index_subtree(root);
+	touched_leaves.erase(std::remove_if(touched_leaves.begin(), touched_leaves.end(),
+		[=](uint32_t index) { return index >= root && index < root + capacity; }), touched_leaves.end());
+	return true;
+}
+
+void sphere_set::start_background_build() {
+	if (background.valid()) {
+		return;
+	}
+
+	// 后台线程只读取快照, 渲染与后续的修改照常进行
+	std::vector<uint32_t> slots;
+	std::vector<aabb> boxes;
+	slots.reserve(data.count - removed_count);
+	boxes.reserve(data.count - removed_count);
+	for (uint32_t slot = 0; slot < data.count; slot++) {
+		if (slot_ids[slot] != invalid_id) {
+			slots.push_back(slot);
+			boxes.push_back(swept_box(slot));
+		}
+	}
+
+	background_epoch = edit_epoch;
+	background = std::async(std::launch::async, [slots = std::move(slots), boxes = std::move(boxes)]() mutable {
+		RT_TRACE_THREAD_NAME("bvh rebuild");
+		background_build result;
+		bvh::build(boxes, result.nodes, result.order);
+		result.slots = std::move(slots);
+		return result;
+	});
+}
+
+bool sphere_set::finish_background_build() {
+	if (!background.valid() || background.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+		return false;
+	}
+
+	background_build result = background.get();
+	if (background_epoch != edit_epoch) {
+		return false;
+	}
+
+	// 图元集合与快照相同, 只有位置可能变了: 按新的叶子顺序排列, 再用当前位置 refit
+	std::vector<uint32_t> slots(result.order.size());
+	for (size_t i = 0; i < slots.size(); i++) {
+		slots[i] = result.slots[result.order[i]];
+	}
+	gather_columns(slots, 0);
+	resize_columns(slots.size());
+	for (size_t slot = 0; slot < slot_ids.size(); slot++) {
+		id_slots[slot_ids[slot]] = static_cast<uint32_t>(slot);
+	}
+
+	nodes = std::move(result.nodes);
+	overflow.clear();
+	removed_count = 0;
+	refresh_view();
+
+	refit_nodes(nullptr);
+	index_tree();
+	return true;
+}
+
+bool sphere_set::hit(const ray& r, double t_min, double t_max, hit_record& rec) const {
+	if (data.node_count == 0 && grid.empty()) {
+		return false;
+	}
+
+	// 距离与参数 t 之间按方向长度换算
+	const sphere_ray sr(r);
+	uint32_t hit_index = 0;
+	double closest = t_max;
+	bool hit_anything;
+	if (!grid.empty()) {
+		// 网格按扫过的范围登记运动图元, 逐个插值到光线时刻再求交
+		hit_anything = grid.traverse(r, t_min, closest,
+			[&](uint32_t index, double t0, double& t1) {
+				double d;
+				point3 center = center_at(index, r.tm);
+				if (!hit_sphere_unit(center.e[0], center.e[1], center.e[2], data.radius[index],
+					sr, t0 * sr.length, t1 * sr.length, d)) {
+					return false;
+				}
+				t1 = d * sr.inv_length;
+				hit_index = index;
+				return true;
+			});
+	}
+	else if (data.motion_x) {
+		// 叶子内的球心按光线时刻插值到栈上的小数组, 再批量求交
+		const aabb* end = end_boxes.size() == data.node_count ? end_boxes.data() : nullptr;
+		hit_anything = bvh::traverse_leaves(data.nodes, end, r, t_min, closest,
+			[&](uint32_t offset, uint32_t count, double t0, double& t1) {
+				const uint32_t chunk = 8;
+				double cx[chunk], cy[chunk], cz[chunk];
+				double d_max = t1 * sr.length;
+				int hit = -1;
+				for (uint32_t first = offset; first < offset + count; first += chunk) {
+					uint32_t n = std::min(chunk, offset + count - first);
+					for (uint32_t k = 0; k < n; k++) {
+						cx[k] = data.center_x[first + k] + r.tm * data.motion_x[first + k];
+						cy[k] = data.center_y[first + k] + r.tm * data.motion_y[first + k];
+						cz[k] = data.center_z[first + k] + r.tm * data.motion_z[first + k];
+					}
+					int i = hit_spheres_unit(cx, cy, cz, data.radius + first, (int)n, sr, t0 * sr.length, d_max);
+					if (i >= 0) {
+						hit = (int)(first - offset) + i;
+					}
+				}
+				if (hit < 0) {
+					return false;
+				}
+				t1 = d_max * sr.inv_length;
+				hit_index = offset + hit;
+				return true;
+			});
+	}
+	else {
+		// 叶子内的球在 SoA 数组中连续存放, 整个叶子一次批量求交
+		hit_anything = bvh::traverse_leaves(data.nodes, r, t_min, closest,
+			[&](uint32_t offset, uint32_t count, double t0, double& t1) {
+				double d_max = t1 * sr.length;
+				int i = hit_spheres_unit(data.center_x + offset, data.center_y + offset, data.center_z + offset, data.radius + offset,
+					(int)count, sr, t0 * sr.length, d_max);
+				if (i < 0) {
+					return false;
+				}
+				t1 = d_max * sr.inv_length;
+				hit_index = offset + i;
+				return true;
+			});
+	}
+
+	// 上次重建之后新增的图元
+	for (uint32_t slot : overflow) {
+		double d;
+		point3 center = center_at(slot, r.tm);
+		if (hit_sphere_unit(center.e[0], center.e[1], center.e[2], data.radius[slot],
+			sr, t_min * sr.length, closest * sr.length, d)) {
+			closest = d * sr.inv_length;
+			hit_index = slot;
+			hit_anything = true;
+		}
+	}
+
+	if (!hit_anything) {
+		return false;
+	}
+
+	point3 center = center_at(hit_index, r.tm);
+	rec.t = closest;
+	rec.p3 = r.at(closest);
+	vec3 outward_normal = (rec.p3 - center) / data.radius[hit_index];
+	rec.set_face_normal(r, outward_normal);
+	rec.set_sphere_uv(outward_normal, data.radius[hit_index]);
+	rec.mat_ptr = &data.materials[data.material_ids[hit_index]];
+
+	return true;
+}
+
+bool sphere_set::bounding_box(aabb& output_box) const {
+	aabb box;
+	if (!grid.empty()) {
+		box = grid.bounds();
+	}
+	else if (data.node_count > 0) {
+		box = data.nodes[0].box;
+		if (end_boxes.size() == data.node_count) {
+			box.expand(end_boxes[0]);
+		}
+	}
+	else {
+		return false;
+	}
+
+	for (uint32_t slot : overflow) {
+		box.expand(swept_box(slot));
+	}
+	output_box = box;
+	return true;
+}
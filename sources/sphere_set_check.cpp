@@ -0,0 +1,156 @@
+#include "sphere_set_check.h"
+#include "sphere_set.h"
+
+#include <iostream>
+
+namespace {
+	const int sphere_count = 200000;
+	const double extent = 99.0;
+	const double sphere_radius = 0.3;
+	const int random_rays = 500;
+
+	struct edit_scene {
+		sphere_set set;
+		std::vector<uint32_t> ids;
+		std::vector<point3> centers;
+		std::vector<bool> live;
+	};
+
+	inline bool in_corner(const point3& p, double bound) {
+		return p.x() < bound && p.y() < bound && p.z() < bound;
+	}
+
+	void move_sphere(edit_scene& scene, int i, const point3& center) {
+		scene.centers[i] = center;
+		scene.set.move(scene.ids[i], center, sphere_radius);
+	}
+
+	// 暴力求交, 作为 BVH 结果的参照
+	bool brute_force_hit(const edit_scene& scene, const ray& r, double t_min, double t_max, double& t_hit) {
+		bool hit_anything = false;
+		double a = r.direction().length_squared();
+		for (size_t i = 0; i < scene.centers.size(); i++) {
+			if (!scene.live[i]) continue;
+			vec3 oc = r.origin() - scene.centers[i];
+			double half_b = dot(oc, r.direction());
+			double c = oc.length_squared() - sphere_radius * sphere_radius;
+			double discriminant = half_b * half_b - a * c;
+			if (discriminant < 0) continue;
+
+			double sqrtd = std::sqrt(discriminant);
+			double t = (-half_b - sqrtd) / a;
+			if (t < t_min) t = (-half_b + sqrtd) / a;
+			if (t < t_min || t > t_max) continue;
+			t_max = t;
+			hit_anything = true;
+		}
+		t_hit = t_max;
+		return hit_anything;
+	}
+
+	// 编辑之后逐个检查: 存活的球都能找到且仍在加速结构里, 已删除的球不再存在, 随机光线的结果与暴力求交一致
+	bool verify(const edit_scene& scene) {
+		size_t live_count = 0;
+		int errors = 0;
+		for (size_t i = 0; i < scene.ids.size(); i++) {
+			if (scene.set.contains(scene.ids[i]) != scene.live[i]) {
+				errors++;
+				continue;
+			}
+			if (!scene.live[i]) continue;
+			live_count++;
+
+			// 从球心出发的光线一定在半径之内射出该球; 球被丢出加速结构时找不到这次命中
+			hit_record rec;
+			ray r(scene.centers[i], vec3(1, 0, 0));
+			if (!scene.set.hit(r, 1e-9, infinity, rec) || rec.t > sphere_radius * (1.0 + 1e-9)) {
+				errors++;
+			}
+		}
+		if (live_count != scene.set.size()) {
+			std::cout << "Live sphere count " << scene.set.size() << ", expected " << live_count << std::endl;
+			return false;
+		}
+
+		for (int k = 0; k < random_rays; k++) {
+			ray r(point3(random_double(-extent, extent), random_double(-extent, extent), random_double(-extent, extent)), random_unit_vector());
+			hit_record rec;
+			double t_expected;
+			bool expected = brute_force_hit(scene, r, 1e-9, infinity, t_expected);
+			bool found = scene.set.hit(r, 1e-9, infinity, rec);
+			if (found != expected || (found && std::abs(rec.t - t_expected) > 1e-6 * (1.0 + t_expected))) {
+				errors++;
+			}
+		}
+
+		if (errors > 0) {
+			std::cout << errors << " spheres or rays disagree with the reference" << std::endl;
+			return false;
+		}
+		return true;
+	}
+}
+
+bool check_sphere_set_edits() {
+	seed_random(3, 0);
+	edit_scene scene;
+	uint32_t mat = scene.set.add_material(lambertian(color(0.5, 0.5, 0.5)));
+	for (int i = 0; i < sphere_count; i++) {
+		point3 center(random_double(-extent, extent), random_double(-extent, extent), random_double(-extent, extent));
+		scene.ids.push_back(scene.set.add(center, sphere_radius, mat));
+		scene.centers.push_back(center);
+		scene.live.push_back(true);
+	}
+	scene.set.build();
+
+	// 1. 删除 10% 的球, 留下 NaN 槽位
+	for (int i = 0; i < sphere_count; i += 10) {
+		scene.set.remove(scene.ids[i]);
+		scene.live[i] = false;
+	}
+	scene.set.commit();
+
+	// 2. 除一个角落外的球全部抖动, 整棵树退化, commit 启动后台重建
+	for (int i = 0; i < sphere_count; i++) {
+		if (!scene.live[i] || in_corner(scene.centers[i], -50.0)) continue;
+		point3 center = scene.centers[i] + vec3(random_double(-3, 3), random_double(-3, 3), random_double(-3, 3));
+		for (int a = 0; a < 3; a++) center.e[a] = clamp(center.e[a], -extent, extent);
+		move_sphere(scene, i, center);
+	}
+	scene.set.commit();
+
+	// 3. 在后台重建完成前打乱角落里的球, 变化局限在一棵子树内, commit 局部重建并重排槽位
+	std::vector<int> corner;
+	for (int i = 0; i < sphere_count; i++) {
+		if (scene.live[i] && in_corner(scene.centers[i], -85.0)) corner.push_back(i);
+	}
+	std::vector<point3> shuffled;
+	for (int i : corner) shuffled.push_back(scene.centers[i]);
+	for (size_t k = shuffled.size(); k > 1; k--) {
+		std::swap(shuffled[k - 1], shuffled[random_u32() % k]);
+	}
+	for (size_t k = 0; k < corner.size(); k++) {
+		move_sphere(scene, corner[k], shuffled[k]);
+	}
+	sphere_update partial = scene.set.commit();
+	if (partial != sphere_update::partial_rebuild || !scene.set.background_pending()) {
+		std::cout << "Edit sequence did not reach a partial rebuild during a background rebuild" << std::endl;
+		return false;
+	}
+
+	// 4. 等待后台重建完成后 commit: 快照已过期, 结果必须被丢弃而不是替换进来
+	scene.set.wait_background();
+	if (scene.set.commit() != sphere_update::none) {
+		std::cout << "Stale background rebuild was swapped in" << std::endl;
+		return false;
+	}
+
+	bool ok = verify(scene);
+
+	// 5. 完整重建并去掉 NaN 槽位后再检查一次
+	scene.set.compact();
+	ok = verify(scene) && ok;
+
+	std::cout << "sphere_set edits: " << (ok ? "ok" : "FAILED") << std::endl;
+	return ok;
+}
@@ -0,0 +1,159 @@
+#include "texture.h"
+#include "texture_cache.h"
+
+#include <algorithm>
+#include <vector>
+
+namespace {
+	const int max_octaves = 7;
+
+	std::vector<texture>& texture_table() {
+		static std::vector<texture> table;
+		return table;
+	}
+
+	// 周期为 2 的方波 (+1, -1) 的积分, 用于盒式滤波后的棋盘格
+	inline double square_wave_integral(double x) {
+		double t = x - 2.0 * std::floor(0.5 * x);
+		return t < 1.0 ? t : 2.0 - t;
+	}
+
+	// 宽度为 w 的盒式滤波后的方波; w 为 0 时直接取值
+	inline double filtered_square_wave(double x, double w) {
+		if (w <= 1e-6) {
+			return (int64_t(std::floor(x)) & 1) == 0 ? 1.0 : -1.0;
+		}
+		return (square_wave_integral(x + 0.5 * w) - square_wave_integral(x - 0.5 * w)) / w;
+	}
+
+	// 改进的 Perlin 噪声 (Perlin 2002), 排列表用固定种子生成, 结果与运行无关
+	class perlin {
+	public:
+		perlin() {
+			for (int i = 0; i < 256; i++) perm[i] = i;
+			uint32_t state = 0x2545F491u;
+			for (int i = 255; i > 0; i--) {
+				state = state * 1664525u + 1013904223u;
+				std::swap(perm[i], perm[(state >> 8) % uint32_t(i + 1)]);
+			}
+			for (int i = 0; i < 256; i++) perm[256 + i] = perm[i];
+		}
+
+		double noise(const point3& p) const {
+			double fx = std::floor(p.x());
+			double fy = std::floor(p.y());
+			double fz = std::floor(p.z());
+			int X = int(int64_t(fx) & 255);
+			int Y = int(int64_t(fy) & 255);
+			int Z = int(int64_t(fz) & 255);
+			double x = p.x() - fx;
+			double y = p.y() - fy;
+			double z = p.z() - fz;
+			double u = fade(x);
+			double v = fade(y);
+			double w = fade(z);
+
+			int A = perm[X] + Y, AA = perm[A] + Z, AB = perm[A + 1] + Z;
+			int B = perm[X + 1] + Y, BA = perm[B] + Z, BB = perm[B + 1] + Z;
+			return lerp(w,
+				lerp(v, lerp(u, grad(perm[AA], x, y, z), grad(perm[BA], x - 1, y, z)),
+					lerp(u, grad(perm[AB], x, y - 1, z), grad(perm[BB], x - 1, y - 1, z))),
+				lerp(v, lerp(u, grad(perm[AA + 1], x, y, z - 1), grad(perm[BA + 1], x - 1, y, z - 1)),
+					lerp(u, grad(perm[AB + 1], x, y - 1, z - 1), grad(perm[BB + 1], x - 1, y - 1, z - 1))));
+		}
+
+		// octaves 可为小数, 最后一个倍频程按小数部分淡入
+		double turbulence(point3 p, double octaves) const {
+			double sum = 0.0;
+			double weight = 1.0;
+			for (int i = 0; i < max_octaves && octaves > 0.0; i++) {
+				sum += weight * std::min(octaves, 1.0) * std::abs(noise(p));
+				weight *= 0.5;
+				p *= 2.0;
+				octaves -= 1.0;
+			}
+			return sum;
+		}
+
+	private:
+		static double fade(double t) { return t * t * t * (t * (t * 6 - 15) + 10); }
+		static double lerp(double t, double a, double b) { return a + t * (b - a); }
+		static double grad(int hash, double x, double y, double z) {
+			int h = hash & 15;
+			double u = h < 8 ? x : y;
+			double v = h < 4 ? y : (h == 12 || h == 14 ? x : z);
+			return ((h & 1) == 0 ? u : -u) + ((h & 2) == 0 ? v : -v);
+		}
+
+	private:
+		int perm[512];
+	};
+
+	const perlin& noise_source() {
+		static const perlin source;
+		return source;
+	}
+
+	color sample_image(const texture& tex, const hit_record& rec, double footprint) {
+		texture_cache& cache = texture_cache::instance();
+		double lod = 0.0;
+		if (footprint > 0.0) {
+			// 光线锥覆盖的纹素数, 取 u / v 中较大者, 宁可略微模糊也不产生走样
+			double texels_u = footprint * tex.scale * cache.width(tex.image) / std::max(rec.dpdu_length, 1e-12);
+			double texels_v = footprint * tex.scale * cache.height(tex.image) / std::max(rec.dpdv_length, 1e-12);
+			lod = std::log2(std::max(std::max(texels_u, texels_v), 1e-12));
+		}
+		return cache.sample(tex.image, rec.u * tex.scale, rec.v * tex.scale, lod);
+	}
+
+	color sample_checker(const texture& tex, const hit_record& rec, double footprint) {
+		// 三维棋盘格是三个方波的乘积, 盒式滤波可分离, 对每一维分别滤波即为精确结果
+		const double w = footprint * tex.scale;
+		const point3 p = tex.scale * rec.p3;
+		double c = filtered_square_wave(p.x(), w) * filtered_square_wave(p.y(), w) * filtered_square_wave(p.z(), w);
+		double t = 0.5 * (1.0 + c);
+		return t * tex.color0 + (1.0 - t) * tex.color1;
+	}
+
+	color sample_noise(const texture& tex, const hit_record& rec, double footprint) {
+		// 只保留波长大于覆盖范围的倍频程
+		double octaves = double(max_octaves);
+		if (footprint > 0.0) {
+			octaves = clamp(-std::log2(std::max(footprint * tex.scale, 1e-12)), 1.0, double(max_octaves));
+		}
+		const point3 p = tex.scale * rec.p3;
+		double t = 0.5 * (1.0 + sin(p.z() + 10.0 * noise_source().turbulence(p, octaves)));
+		return (1.0 - t) * tex.color0 + t * tex.color1;
+	}
+}
+
+uint32_t add_texture(const texture& tex) {
+	texture_table().push_back(tex);
+	return static_cast<uint32_t>(texture_table().size() - 1);
+}
+
+size_t texture_count() {
+	return texture_table().size();
+}
+
+uint32_t add_image_texture(const std::string& path, double scale) {
+	uint32_t image = texture_cache::instance().open(path);
+	if (image == texture_cache::invalid_image) {
+		return no_texture;
+	}
+	texture tex;
+	tex.type = texture_type::image;
+	tex.image = image;
+	tex.scale = scale;
+	return add_texture(tex);
+}
+
+color sample_texture(uint32_t id, const hit_record& rec, double footprint) {
+	const texture& tex = texture_table()[id];
+	switch (tex.type) {
+	case texture_type::image:	return sample_image(tex, rec, footprint);
+	case texture_type::checker:	return sample_checker(tex, rec, footprint);
+	case texture_type::noise:	return sample_noise(tex, rec, footprint);
+	}
+	return color(1.0, 1.0, 1.0);
+}
@@ -0,0 +1,429 @@
+#include "texture_cache.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+namespace {
+	const char texture_magic[8] = { 'R', 'T', 'T', 'E', 'X', 0, 0, 0 };
+	const uint32_t texture_version = 1;
+	const uint32_t texture_endian = 0x01020304;
+	const int memo_size = 4;
+
+	static_assert(sizeof(texture_file_header) == 32, "texture_file_header must stay 32 bytes");
+
+	inline unsigned char to_byte(float value) {
+		// 与 convert_color 一致: gamma 2
+		return static_cast<unsigned char>(256 * clamp(std::sqrt(static_cast<double>(value)), 0.0, 0.999));
+	}
+
+	inline int level_size(int size, int level) {
+		return std::max(1, size >> level);
+	}
+
+	int level_count(int width, int height) {
+		int levels = 1;
+		while (level_size(width, levels - 1) > 1 || level_size(height, levels - 1) > 1) {
+			levels++;
+		}
+		return levels;
+	}
+
+	inline int tiles_along(int size, int tile_size) {
+		return (size + tile_size - 1) / tile_size;
+	}
+
+	// 图块编号: image 20 位 | level 6 位 | tile_y 19 位 | tile_x 19 位
+	inline uint64_t tile_key(uint32_t image, int level, int tile_x, int tile_y) {
+		return (uint64_t(image) << 44) | (uint64_t(level) << 38) | (uint64_t(tile_y) << 19) | uint64_t(tile_x);
+	}
+
+	// 读取 PNM 头部的一个字段, 跳过空白与注释
+	std::string read_token(std::istream& in) {
+		std::string token;
+		int c = in.get();
+		while (c != EOF && (isspace(c) || c == '#')) {
+			if (c == '#') {
+				while (c != EOF && c != '\n') c = in.get();
+			}
+			c = in.get();
+		}
+		while (c != EOF && !isspace(c)) {
+			token.push_back(char(c));
+			c = in.get();
+		}
+		return token;
+	}
+
+	// 读取 8 位 P6 或 RGB PFM, 输出线性 RGB, 行从图像顶部开始
+	bool read_source_image(const std::string& path, int& width, int& height, std::vector<float>& rgb) {
+		std::ifstream in(path, std::ios::binary);
+		if (!in) {
+			std::cout << "Failed to open texture source " << path << std::endl;
+			return false;
+		}
+
+		std::string magic = read_token(in);
+		width = atoi(read_token(in).c_str());
+		height = atoi(read_token(in).c_str());
+		std::string range = read_token(in);
+		if ((magic != "P6" && magic != "PF") || width <= 0 || height <= 0) {
+			std::cout << "Unsupported texture source " << path << " (expected binary P6 or RGB PFM)" << std::endl;
+			return false;
+		}
+
+		const size_t count = size_t(width) * height * 3;
+		rgb.resize(count);
+		if (magic == "P6") {
+			if (atoi(range.c_str()) != 255) {
+				std::cout << "Unsupported PPM max value in " << path << std::endl;
+				return false;
+			}
+			std::vector<unsigned char> bytes(count);
+			if (!in.read(reinterpret_cast<char*>(bytes.data()), count)) {
+				std::cout << "Truncated texture source " << path << std::endl;
+				return false;
+			}
+			for (size_t i = 0; i < count; i++) {
+				double v = (bytes[i] + 0.5) / 256.0;
+				rgb[i] = static_cast<float>(v * v);
+			}
+			return true;
+		}
+
+		// PFM: 比例为负表示小端, 行从图像底部开始
+		if (atof(range.c_str()) >= 0.0) {
+			std::cout << "Big-endian PFM is not supported: " << path << std::endl;
+			return false;
+		}
+		const size_t row_floats = size_t(width) * 3;
+		for (int y = height - 1; y >= 0; y--) {
+			if (!in.read(reinterpret_cast<char*>(&rgb[size_t(y) * row_floats]), row_floats * sizeof(float))) {
+				std::cout << "Truncated texture source " << path << std::endl;
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// 盒式缩小: 每个目标纹素覆盖源图像中 w / new_w 个纹素 (可为小数), 按覆盖面积加权,
+	// 非 2 的幂尺寸的各层平均值也保持不变; 先横向后纵向
+	std::vector<float> resample_axis(const std::vector<float>& src, int width, int height, int new_width, bool horizontal) {
+		const int src_size = horizontal ? width : height;
+		const int lines = horizontal ? height : width;
+		const int new_size = new_width;
+		const double ratio = double(src_size) / new_size;
+		const size_t stride = horizontal ? 3 : size_t(width) * 3;
+		const size_t line_stride = horizontal ? size_t(width) * 3 : 3;
+		const size_t out_stride = horizontal ? 3 : size_t(width) * 3;
+		const size_t out_line_stride = horizontal ? size_t(new_size) * 3 : 3;
+
+		std::vector<float> dst(size_t(lines) * new_size * 3);
+		for (int i = 0; i < new_size; i++) {
+			const double begin = i * ratio;
+			const double end = (i + 1) * ratio;
+			for (int line = 0; line < lines; line++) {
+				double sum[3] = { 0.0, 0.0, 0.0 };
+				for (int k = int(begin); k < src_size && k < end; k++) {
+					const double w = std::min(end, k + 1.0) - std::max(begin, double(k));
+					const float* p = &src[line * line_stride + k * stride];
+					sum[0] += w * p[0];
+					sum[1] += w * p[1];
+					sum[2] += w * p[2];
+				}
+				float* out = &dst[line * out_line_stride + i * out_stride];
+				out[0] = static_cast<float>(sum[0] / ratio);
+				out[1] = static_cast<float>(sum[1] / ratio);
+				out[2] = static_cast<float>(sum[2] / ratio);
+			}
+		}
+		return dst;
+	}
+
+	std::vector<float> downsample(const std::vector<float>& src, int width, int height, int new_width, int new_height) {
+		std::vector<float> rows = resample_axis(src, width, height, new_width, true);
+		return resample_axis(rows, new_width, height, new_height, false);
+	}
+
+	struct tile_memo {
+		uint64_t key[memo_size];
+		std::shared_ptr<const void> data[memo_size];
+		int next = 0;
+	};
+}
+
+texture_cache& texture_cache::instance() {
+	static texture_cache cache;
+	return cache;
+}
+
+texture_cache::texture_cache() : budget(size_t(256) << 20), misses(0), evictions(0), resident(0), peak(0) {
+	for (int i = 0; i < 256; i++) {
+		double v = (i + 0.5) / 256.0;
+		decode[i] = static_cast<float>(v * v);
+	}
+}
+
+bool texture_cache::make_texture(const std::string& source, const std::string& path, int tile_size) {
+	int width = 0;
+	int height = 0;
+	std::vector<float> level;
+	if (!read_source_image(source, width, height, level)) {
+		return false;
+	}
+
+	std::ofstream out(path, std::ios::binary);
+	if (!out) {
+		std::cout << "Failed to create texture " << path << std::endl;
+		return false;
+	}
+
+	texture_file_header header;
+	memcpy(header.magic, texture_magic, sizeof(header.magic));
+	header.version = texture_version;
+	header.endian = texture_endian;
+	header.width = width;
+	header.height = height;
+	header.levels = level_count(width, height);
+	header.tile_size = tile_size;
+	out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+	std::vector<unsigned char> texels(size_t(3) * tile_size * tile_size);
+	int w = width;
+	int h = height;
+	for (int l = 0; l < header.levels; l++) {
+		for (int ty = 0; ty < tiles_along(h, tile_size); ty++) {
+			for (int tx = 0; tx < tiles_along(w, tile_size); tx++) {
+				// 超出图像的部分复制边缘纹素, 采样时不会读到
+				for (int y = 0; y < tile_size; y++) {
+					int sy = std::min(ty * tile_size + y, h - 1);
+					for (int x = 0; x < tile_size; x++) {
+						int sx = std::min(tx * tile_size + x, w - 1);
+						const float* p = &level[3 * (size_t(sy) * w + sx)];
+						unsigned char* t = &texels[3 * (size_t(y) * tile_size + x)];
+						t[0] = to_byte(p[0]);
+						t[1] = to_byte(p[1]);
+						t[2] = to_byte(p[2]);
+					}
+				}
+				out.write(reinterpret_cast<const char*>(texels.data()), texels.size());
+			}
+		}
+		if (l + 1 < header.levels) {
+			int next_w = level_size(width, l + 1);
+			int next_h = level_size(height, l + 1);
+			level = downsample(level, w, h, next_w, next_h);
+			w = next_w;
+			h = next_h;
+		}
+	}
+
+	if (!out) {
+		std::cout << "Failed to write texture " << path << std::endl;
+		return false;
+	}
+	return true;
+}
+
+uint32_t texture_cache::open(const std::string& path) {
+	auto found = image_ids.find(path);
+	if (found != image_ids.end()) {
+		return found->second;
+	}
+
+	// 源图像转换一次, 之后直接使用生成的 .rttex
+	std::string tiled = path;
+	if (path.size() < 6 || path.compare(path.size() - 6, 6, ".rttex") != 0) {
+		tiled = path + ".rttex";
+		if (!std::ifstream(tiled, std::ios::binary)) {
+			std::cout << "Converting texture " << path << " to " << tiled << std::endl;
+			if (!make_texture(path, tiled)) {
+				return invalid_image;
+			}
+		}
+	}
+
+	std::unique_ptr<image_file> img(new image_file());
+	img->path = tiled;
+	img->file.open(tiled, std::ios::binary);
+	texture_file_header& h = img->header;
+	if (!img->file || !img->file.read(reinterpret_cast<char*>(&h), sizeof(h))) {
+		std::cout << "Failed to open texture " << tiled << std::endl;
+		return invalid_image;
+	}
+	if (memcmp(h.magic, texture_magic, sizeof(h.magic)) != 0 || h.version != texture_version || h.endian != texture_endian
+		|| h.width <= 0 || h.height <= 0 || h.tile_size <= 0 || h.levels != level_count(h.width, h.height)) {
+		std::cout << "Invalid texture file " << tiled << std::endl;
+		return invalid_image;
+	}
+	if (images.size() >= (size_t(1) << 20)) {
+		std::cout << "Too many textures" << std::endl;
+		return invalid_image;
+	}
+
+	uint64_t first = 0;
+	for (int l = 0; l < h.levels; l++) {
+		img->level_first_tile.push_back(first);
+		first += uint64_t(tiles_along(level_size(h.width, l), h.tile_size)) * tiles_along(level_size(h.height, l), h.tile_size);
+	}
+
+	uint32_t id = static_cast<uint32_t>(images.size());
+	images.push_back(std::move(img));
+	image_ids[path] = id;
+	return id;
+}
+
+void texture_cache::set_budget(size_t bytes) {
+	budget = bytes;
+}
+
+int texture_cache::width(uint32_t image, int level) const {
+	return level_size(images[image]->header.width, level);
+}
+
+int texture_cache::height(uint32_t image, int level) const {
+	return level_size(images[image]->header.height, level);
+}
+
+texture_cache_stats texture_cache::stats() const {
+	texture_cache_stats s;
+	for (const shard& sh : shards) {
+		std::lock_guard<std::mutex> lock(sh.mutex);
+		s.hits += sh.hits;
+	}
+	s.misses = misses;
+	s.evictions = evictions;
+	s.resident_bytes = resident;
+	s.peak_bytes = peak;
+	return s;
+}
+
+color texture_cache::sample(uint32_t image, double u, double v, double lod) {
+	const int last = levels(image) - 1;
+	lod = clamp(lod, 0.0, double(last));
+	const int level = int(lod);
+	const double t = lod - level;
+
+	color c = bilinear(image, level, u, v);
+	if (t > 0.0 && level < last) {
+		c = (1.0 - t) * c + t * bilinear(image, level + 1, u, v);
+	}
+	return c;
+}
+
+color texture_cache::bilinear(uint32_t image, int level, double u, double v) {
+	const int w = width(image, level);
+	const int h = height(image, level);
+
+	// 重复寻址, 纹素中心位于 +0.5 处
+	u -= std::floor(u);
+	v -= std::floor(v);
+	const double x = u * w - 0.5;
+	const double y = (1.0 - v) * h - 0.5;
+	const double fx0 = std::floor(x);
+	const double fy0 = std::floor(y);
+	const double fx = x - fx0;
+	const double fy = y - fy0;
+
+	int x0 = int(fx0);
+	int y0 = int(fy0);
+	if (x0 < 0) x0 += w;
+	if (y0 < 0) y0 += h;
+	const int x1 = x0 + 1 < w ? x0 + 1 : 0;
+	const int y1 = y0 + 1 < h ? y0 + 1 : 0;
+
+	return (1.0 - fy) * ((1.0 - fx) * texel(image, level, x0, y0) + fx * texel(image, level, x1, y0))
+		+ fy * ((1.0 - fx) * texel(image, level, x0, y1) + fx * texel(image, level, x1, y1));
+}
+
+color texture_cache::texel(uint32_t image, int level, int x, int y) {
+	const int size = images[image]->header.tile_size;
+	const tile* t = fetch(image, level, x / size, y / size);
+	const unsigned char* p = &t->texels[3 * (size_t(y % size) * size + x % size)];
+	return color(decode[p[0]], decode[p[1]], decode[p[2]]);
+}
+
+const texture_cache::tile* texture_cache::fetch(uint32_t image, int level, int tile_x, int tile_y) {
+	// 线程本地的最近图块: 相邻样本大多落在同一图块, 不需要加锁
+	// 返回的指针由 memo 持有, 在本线程之后 memo_size 次未命中之前有效
+	thread_local tile_memo memo;
+	const uint64_t key = tile_key(image, level, tile_x, tile_y);
+	for (int i = 0; i < memo_size; i++) {
+		if (memo.key[i] == key && memo.data[i]) {
+			return static_cast<const tile*>(memo.data[i].get());
+		}
+	}
+
+	auto remember = [&](const std::shared_ptr<const tile>& data) {
+		memo.key[memo.next] = key;
+		memo.data[memo.next] = data;
+		memo.next = (memo.next + 1) % memo_size;
+		return data.get();
+	};
+
+	shard& s = shards[(key * 0x9E3779B97F4A7C15ull) >> 60];
+	{
+		std::lock_guard<std::mutex> lock(s.mutex);
+		auto it = s.tiles.find(key);
+		if (it != s.tiles.end()) {
+			s.hits++;
+			s.lru.splice(s.lru.begin(), s.lru, it->second.second);
+			return remember(it->second.first);
+		}
+	}
+
+	// 在锁外读取磁盘; 其他线程可能同时读取同一图块, 先插入的保留
+	std::shared_ptr<const tile> data = load(*images[image], level, tile_x, tile_y);
+	misses++;
+	{
+		std::lock_guard<std::mutex> lock(s.mutex);
+		auto it = s.tiles.find(key);
+		if (it != s.tiles.end()) {
+			data = it->second.first;
+		}
+		else {
+			const size_t bytes = data->texels.size();
+			s.lru.push_front(key);
+			s.tiles.emplace(key, std::make_pair(data, s.lru.begin()));
+			s.bytes += bytes;
+			size_t now = resident += bytes;
+			size_t seen = peak;
+			while (now > seen && !peak.compare_exchange_weak(seen, now)) {}
+
+			// 每个分片至少保留一个图块
+			const size_t shard_budget = budget / shard_count;
+			while (s.bytes > shard_budget && s.lru.size() > 1) {
+				auto victim = s.tiles.find(s.lru.back());
+				const size_t victim_bytes = victim->second.first->texels.size();
+				s.tiles.erase(victim);
+				s.lru.pop_back();
+				s.bytes -= victim_bytes;
+				resident -= victim_bytes;
+				evictions++;
+			}
+		}
+	}
+	return remember(data);
+}
+
+std::shared_ptr<const texture_cache::tile> texture_cache::load(image_file& img, int level, int tile_x, int tile_y) {
+	const texture_file_header& h = img.header;
+	std::shared_ptr<tile> t = std::make_shared<tile>();
+	t->texels.resize(size_t(3) * h.tile_size * h.tile_size);
+
+	const uint64_t index = img.level_first_tile[level] + uint64_t(tile_y) * tiles_along(level_size(h.width, level), h.tile_size) + tile_x;
+	const uint64_t offset = sizeof(texture_file_header) + index * t->texels.size();
+
+	std::lock_guard<std::mutex> lock(img.file_mutex);
+	img.file.clear();
+	img.file.seekg(std::streamoff(offset));
+	if (!img.file.read(reinterpret_cast<char*>(t->texels.data()), t->texels.size())) {
+		// 文件被截断: 该图块按黑色处理, 只提示一次
+		static std::once_flag reported;
+		std::call_once(reported, [&]() { std::cout << "Failed to read texture tile from " << img.path << std::endl; });
+		std::fill(t->texels.begin(), t->texels.end(), 0);
+	}
+	return t;
+}
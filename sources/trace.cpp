@@ -0,0 +1,169 @@
+#include "trace.h"
+#include "File.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <vector>
+
+namespace {
+	// 单写者环形缓冲: 只有所属线程写入, head 用 release 发布, 导出时 acquire 读取
+	struct trace_buffer {
+		std::vector<trace_event> events;
+		std::atomic<uint64_t> head;
+		std::string thread_name;
+		int thread_id;
+
+		trace_buffer(size_t capacity, int id) : events(capacity), head(0), thread_id(id) {}
+
+		void push(const trace_event& e) {
+			uint64_t index = head.load(std::memory_order_relaxed);
+			events[index % events.size()] = e;
+			head.store(index + 1, std::memory_order_release);
+		}
+	};
+
+	struct trace_registry {
+		std::mutex mutex;
+		// 缓冲由全局持有, 线程池关闭后事件仍然可以导出
+		std::vector<std::unique_ptr<trace_buffer>> buffers;
+		std::atomic<bool> enabled{ false };
+		std::atomic<uint64_t> generation{ 0 };
+		size_t capacity = 1 << 16;
+		std::chrono::steady_clock::time_point origin = std::chrono::steady_clock::now();
+	};
+
+	trace_registry& registry() {
+		static trace_registry instance;
+		return instance;
+	}
+
+	// 每次 trace_begin 都会清空缓冲, 线程据 generation 判断自己的缓冲是否仍然有效
+	struct thread_trace {
+		trace_buffer* buffer = nullptr;
+		uint64_t generation = ~0ull;
+		const char* name = nullptr;
+	};
+
+	thread_trace& local_trace() {
+		static thread_local thread_trace local;
+		return local;
+	}
+
+	trace_buffer* local_buffer() {
+		trace_registry& r = registry();
+		thread_trace& local = local_trace();
+		uint64_t generation = r.generation.load(std::memory_order_acquire);
+		if (local.buffer && local.generation == generation) {
+			return local.buffer;
+		}
+
+		std::lock_guard<std::mutex> lock(r.mutex);
+		r.buffers.push_back(std::make_unique<trace_buffer>(r.capacity, (int)r.buffers.size() + 1));
+		local.buffer = r.buffers.back().get();
+		local.generation = generation;
+		if (local.name) {
+			local.buffer->thread_name = local.name;
+		}
+		return local.buffer;
+	}
+
+	void write_json_string(std::ostream& out, const std::string& s) {
+		out << '"';
+		for (char c : s) {
+			if (c == '"' || c == '\\') out << '\\';
+			out << c;
+		}
+		out << '"';
+	}
+}
+
+void trace_begin(size_t events_per_thread) {
+	trace_registry& r = registry();
+	std::lock_guard<std::mutex> lock(r.mutex);
+	r.buffers.clear();
+	r.capacity = events_per_thread > 0 ? events_per_thread : 1;
+	r.origin = std::chrono::steady_clock::now();
+	r.generation.fetch_add(1, std::memory_order_release);
+	r.enabled.store(true, std::memory_order_release);
+}
+
+void trace_end() {
+	registry().enabled.store(false, std::memory_order_release);
+}
+
+bool trace_enabled() {
+	return registry().enabled.load(std::memory_order_relaxed);
+}
+
+void trace_thread_name(const char* name) {
+	thread_trace& local = local_trace();
+	bool renamed = local.name != name;
+	local.name = name;
+	if (trace_enabled() && (renamed || local.generation != registry().generation.load(std::memory_order_acquire))) {
+		local_buffer()->thread_name = name;
+	}
+}
+
+int64_t trace_now() {
+	auto elapsed = std::chrono::steady_clock::now() - registry().origin;
+	return std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+}
+
+void trace_record(const char* name, int64_t start, int64_t duration, int64_t arg) {
+	if (!trace_enabled()) {
+		return;
+	}
+	local_buffer()->push(trace_event{ name, start, duration, arg });
+}
+
+bool write_chrome_trace(const std::string& path) {
+	trace_registry& r = registry();
+	std::ostringstream out;
+	out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+
+	bool first = true;
+	{
+		std::lock_guard<std::mutex> lock(r.mutex);
+		for (const auto& buffer : r.buffers) {
+			if (!buffer->thread_name.empty()) {
+				out << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->thread_id
+					<< ",\"args\":{\"name\":";
+				write_json_string(out, buffer->thread_name);
+				out << "}}";
+				first = false;
+			}
+
+			// 缓冲写满时只保留最近的 capacity 个事件
+			uint64_t head = buffer->head.load(std::memory_order_acquire);
+			uint64_t capacity = buffer->events.size();
+			uint64_t begin = head > capacity ? head - capacity : 0;
+			for (uint64_t i = begin; i < head; i++) {
+				const trace_event& e = buffer->events[i % capacity];
+				out << (first ? "" : ",\n") << "{\"name\":";
+				write_json_string(out, e.name);
+				out << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->thread_id
+					<< ",\"ts\":" << e.start << ",\"dur\":" << e.duration;
+				if (e.arg >= 0) {
+					out << ",\"args\":{\"value\":" << e.arg << "}";
+				}
+				out << "}";
+				first = false;
+			}
+		}
+	}
+	out << "\n]}\n";
+
+	std::string json = out.str();
+	File file(path);
+	if (!file.WriteBytes(json.data(), json.size(), std::ios::binary | std::ios::trunc)) {
+		std::cout << "Failed to write trace: " << path << std::endl;
+		return false;
+	}
+
+	std::cout << "Saved trace " << path << std::endl;
+	return true;
+}
@@ -0,0 +1,93 @@
+#include "transform.h"
+
+transform::transform() {
+	for (int i = 0; i < 3; i++) {
+		for (int j = 0; j < 4; j++) {
+			m[i][j] = i == j ? 1.0 : 0.0;
+		}
+	}
+}
+
+transform transform::translate(const vec3& offset) {
+	transform t;
+	t.m[0][3] = offset.e[0];
+	t.m[1][3] = offset.e[1];
+	t.m[2][3] = offset.e[2];
+	return t;
+}
+
+transform transform::scale(const vec3& factor) {
+	transform t;
+	t.m[0][0] = factor.e[0];
+	t.m[1][1] = factor.e[1];
+	t.m[2][2] = factor.e[2];
+	return t;
+}
+
+transform transform::rotate(const vec3& axis, double degrees) {
+	vec3 a = unit_vector(axis);
+	double theta = degress_to_radians(degrees);
+	double s = std::sin(theta);
+	double c = std::cos(theta);
+
+	// Rodrigues 旋转公式
+	transform t;
+	t.m[0][0] = a.e[0] * a.e[0] + (1 - a.e[0] * a.e[0]) * c;
+	t.m[0][1] = a.e[0] * a.e[1] * (1 - c) - a.e[2] * s;
+	t.m[0][2] = a.e[0] * a.e[2] * (1 - c) + a.e[1] * s;
+	t.m[1][0] = a.e[0] * a.e[1] * (1 - c) + a.e[2] * s;
+	t.m[1][1] = a.e[1] * a.e[1] + (1 - a.e[1] * a.e[1]) * c;
+	t.m[1][2] = a.e[1] * a.e[2] * (1 - c) - a.e[0] * s;
+	t.m[2][0] = a.e[0] * a.e[2] * (1 - c) - a.e[1] * s;
+	t.m[2][1] = a.e[1] * a.e[2] * (1 - c) + a.e[0] * s;
+	t.m[2][2] = a.e[2] * a.e[2] + (1 - a.e[2] * a.e[2]) * c;
+	return t;
+}
+
+transform transform::operator*(const transform& other) const {
+	transform t;
+	for (int i = 0; i < 3; i++) {
+		for (int j = 0; j < 4; j++) {
+			t.m[i][j] = m[i][0] * other.m[0][j] + m[i][1] * other.m[1][j] + m[i][2] * other.m[2][j];
+		}
+		t.m[i][3] += m[i][3];
+	}
+	return t;
+}
+
+transform transform::inverse() const {
+	// 线性部分用伴随矩阵求逆, 平移为 -A^-1 * b
+	const double det =
+		m[0][0] * (m[1][1] * m[2][2] - m[1][2] * m[2][1]) -
+		m[0][1] * (m[1][0] * m[2][2] - m[1][2] * m[2][0]) +
+		m[0][2] * (m[1][0] * m[2][1] - m[1][1] * m[2][0]);
+	const double inv_det = 1.0 / det;
+
+	transform t;
+	t.m[0][0] = (m[1][1] * m[2][2] - m[1][2] * m[2][1]) * inv_det;
+	t.m[0][1] = (m[0][2] * m[2][1] - m[0][1] * m[2][2]) * inv_det;
+	t.m[0][2] = (m[0][1] * m[1][2] - m[0][2] * m[1][1]) * inv_det;
+	t.m[1][0] = (m[1][2] * m[2][0] - m[1][0] * m[2][2]) * inv_det;
+	t.m[1][1] = (m[0][0] * m[2][2] - m[0][2] * m[2][0]) * inv_det;
+	t.m[1][2] = (m[0][2] * m[1][0] - m[0][0] * m[1][2]) * inv_det;
+	t.m[2][0] = (m[1][0] * m[2][1] - m[1][1] * m[2][0]) * inv_det;
+	t.m[2][1] = (m[0][1] * m[2][0] - m[0][0] * m[2][1]) * inv_det;
+	t.m[2][2] = (m[0][0] * m[1][1] - m[0][1] * m[1][0]) * inv_det;
+
+	for (int i = 0; i < 3; i++) {
+		t.m[i][3] = -(t.m[i][0] * m[0][3] + t.m[i][1] * m[1][3] + t.m[i][2] * m[2][3]);
+	}
+	return t;
+}
+
+aabb transform::box(const aabb& b) const {
+	aabb result;
+	for (int i = 0; i < 8; i++) {
+		point3 corner(
+			(i & 1) ? b.maximum.e[0] : b.minimum.e[0],
+			(i & 2) ? b.maximum.e[1] : b.minimum.e[1],
+			(i & 4) ? b.maximum.e[2] : b.minimum.e[2]);
+		result.expand(point(corner));
+	}
+	return result;
+}
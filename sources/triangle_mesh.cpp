@@ -0,0 +1,130 @@
+#include "triangle_mesh.h"
+
+namespace {
+	// Woop, Benthin, Wald. "Watertight Ray/Triangle Intersection", JCGT 2013
+	// 每条光线只需计算一次的剪切变换
+	struct watertight_ray {
+		int kx, ky, kz;
+		double sx, sy, sz;
+
+		watertight_ray(const vec3& dir) {
+			double ax = std::fabs(dir.e[0]), ay = std::fabs(dir.e[1]), az = std::fabs(dir.e[2]);
+			kz = (ax > ay) ? (ax > az ? 0 : 2) : (ay > az ? 1 : 2);
+			kx = (kz + 1) % 3;
+			ky = (kx + 1) % 3;
+			if (dir.e[kz] < 0.0) std::swap(kx, ky);
+
+			sx = dir.e[kx] / dir.e[kz];
+			sy = dir.e[ky] / dir.e[kz];
+			sz = 1.0 / dir.e[kz];
+		}
+	};
+
+	inline bool hit_triangle(const watertight_ray& wr, const point3& org,
+		const point3& p0, const point3& p1, const point3& p2, double t_min, double t_max, double& t) {
+		const vec3 a = p0 - org;
+		const vec3 b = p1 - org;
+		const vec3 c = p2 - org;
+
+		const double ax = a.e[wr.kx] - wr.sx * a.e[wr.kz];
+		const double ay = a.e[wr.ky] - wr.sy * a.e[wr.kz];
+		const double bx = b.e[wr.kx] - wr.sx * b.e[wr.kz];
+		const double by = b.e[wr.ky] - wr.sy * b.e[wr.kz];
+		const double cx = c.e[wr.kx] - wr.sx * c.e[wr.kz];
+		const double cy = c.e[wr.ky] - wr.sy * c.e[wr.kz];
+
+		const double u = cx * by - cy * bx;
+		const double v = ax * cy - ay * cx;
+		const double w = bx * ay - by * ax;
+
+		// 边函数符号不一致则在三角形外; 恰好为 0 的边同时属于相邻两个三角形, 不会漏光
+		if ((u < 0.0 || v < 0.0 || w < 0.0) && (u > 0.0 || v > 0.0 || w > 0.0)) return false;
+
+		const double det = u + v + w;
+		if (det == 0.0) return false;
+
+		const double az = wr.sz * a.e[wr.kz];
+		const double bz = wr.sz * b.e[wr.kz];
+		const double cz = wr.sz * c.e[wr.kz];
+		t = (u * az + v * bz + w * cz) / det;
+
+		return t >= t_min && t <= t_max;
+	}
+}
+
+triangle_mesh::triangle_mesh(std::vector<float> vertex_positions, std::vector<uint32_t> triangle_indices, shared_ptr<material> mat)
+	: positions(std::move(vertex_positions)), indices(std::move(triangle_indices)), mat_ptr(mat) {
+	const size_t count = indices.size() / 3;
+	indices.resize(count * 3);
+
+	std::vector<aabb> boxes(count);
+	for (size_t i = 0; i < count; i++) {
+		boxes[i].expand(vertex(indices[3 * i]));
+		boxes[i].expand(vertex(indices[3 * i + 1]));
+		boxes[i].expand(vertex(indices[3 * i + 2]));
+	}
+
+	std::vector<uint32_t> order;
+	bvh::build(boxes, nodes, order);
+
+	std::vector<uint32_t> sorted(indices.size());
+	for (size_t i = 0; i < order.size(); i++) {
+		sorted[3 * i] = indices[3 * size_t(order[i])];
+		sorted[3 * i + 1] = indices[3 * size_t(order[i]) + 1];
+		sorted[3 * i + 2] = indices[3 * size_t(order[i]) + 2];
+	}
+	indices.swap(sorted);
+}
+
+bool triangle_mesh::hit(const ray& r, double t_min, double t_max, hit_record& rec) const {
+	if (nodes.empty()) {
+		return false;
+	}
+
+	const watertight_ray wr(r.dir);
+	uint32_t hit_index = 0;
+	double closest = t_max;
+	bool hit_anything = bvh::traverse(nodes.data(), r, t_min, closest,
+		[&](uint32_t i, double t0, double& t1) {
+			double t;
+			if (!hit_triangle(wr, r.orig, vertex(indices[3 * i]), vertex(indices[3 * i + 1]), vertex(indices[3 * i + 2]), t0, t1, t)) {
+				return false;
+			}
+			t1 = t;
+			hit_index = i;
+			return true;
+		});
+
+	if (!hit_anything) {
+		return false;
+	}
+
+	const point3 p0 = vertex(indices[3 * hit_index]);
+	const point3 p1 = vertex(indices[3 * hit_index + 1]);
+	const point3 p2 = vertex(indices[3 * hit_index + 2]);
+
+	rec.t = closest;
+	rec.p3 = r.at(closest);
+	rec.set_face_normal(r, unit_vector(cross(p1 - p0, p2 - p0)));
+	rec.mat_ptr = mat_ptr.get();
+
+	// 网格没有纹理坐标, 使用重心坐标 (每个三角形覆盖 [0, 1] 的一半)
+	const vec3 e1 = p1 - p0;
+	const vec3 e2 = p2 - p0;
+	const vec3 n = cross(e1, e2);
+	const vec3 d = rec.p3 - p0;
+	const double inv_area = 1.0 / dot(n, n);
+	rec.u = dot(cross(d, e2), n) * inv_area;
+	rec.v = dot(cross(e1, d), n) * inv_area;
+	rec.dpdu_length = e1.length();
+	rec.dpdv_length = e2.length();
+
+	return true;
+}
+
+bool triangle_mesh::bounding_box(aabb& output_box) const {
+	if (nodes.empty()) return false;
+
+	output_box = nodes[0].box;
+	return true;
+}